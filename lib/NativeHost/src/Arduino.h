@@ -0,0 +1,96 @@
+/*
+
+ Minimal Arduino core shim for [env:native].  Only what the Luma firmware uses.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+#include "NativeHost.h"
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define PROGMEM
+#define PGM_P const char *
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)   (*(void * const *)(addr))
+#define memcpy_P memcpy
+
+#define F_CPU 16000000UL
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+inline void yield() {}
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+#define digitalPinToInterrupt(p) (p)
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+template <class A, class B> inline typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+template <class A, class B> inline typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+template <class T, class L, class H> inline T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+// --- Serial (writes to stdout, reads nothing) ---
+
+#define F(s) (s)
+#define DEC 10
+#define HEX 16
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  void end() {}
+  int available();
+  int read();
+  void flush();
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buf, size_t len);
+  size_t print(const char* s);
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t print(int n, int base = DEC) { return print((long)n, base); }
+  size_t print(unsigned char n, int base = DEC) { return print((unsigned long)n, base); }
+  size_t println() { return write('\n'); }
+  template <class T> size_t println(T v) { return print(v) + println(); }
+  template <class T> size_t println(T v, int base) { return print(v, base) + println(); }
+};
+
+extern thread_local HardwareSerial Serial;
+
+void setup();
+void loop();
@@ -0,0 +1,21 @@
+/*
+
+ EEPROM shim for [env:native]: 256 bytes like the ATtiny1616, blank (0xFF) at start.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define EEPROM_SIZE 256
+
+class EEPROMClass {
+public:
+  uint8_t read(int idx);
+  void write(int idx, uint8_t val);
+  void update(int idx, uint8_t val);
+  uint16_t length() { return EEPROM_SIZE; }
+};
+
+extern thread_local EEPROMClass EEPROM;
@@ -0,0 +1,343 @@
+/*
+
+ FastLED shim for [env:native].
+
+ Reimplements the parts of FastLED 3.10 the Luma firmware uses, with the same
+ integer math as the AVR build (FASTLED_SCALE8_FIXED, the C versions of sin8 /
+ sin16, hsv2rgb_rainbow, gradient palette decoding) so that frames rendered on
+ the desktop match what the pendant shows.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+typedef uint16_t fract16;
+typedef uint16_t accum88;
+typedef int16_t saccum87;
+
+// --- lib8tion ---
+
+inline uint8_t scale8(uint8_t i, fract8 scale) {
+  return (((uint16_t)i) * (1 + (uint16_t)scale)) >> 8;
+}
+
+inline uint8_t scale8_video(uint8_t i, fract8 scale) {
+  return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0);
+}
+
+inline uint16_t scale16(uint16_t i, fract16 scale) {
+  return ((uint32_t)i * (1 + (uint32_t)scale)) >> 16;
+}
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) {
+  unsigned int t = i + j;
+  return t > 255 ? 255 : t;
+}
+
+inline uint8_t qsub8(uint8_t i, uint8_t j) {
+  int t = i - j;
+  return t < 0 ? 0 : t;
+}
+
+inline uint8_t map8(uint8_t in, uint8_t rangeStart, uint8_t rangeEnd) {
+  return rangeStart + scale8(in, rangeEnd - rangeStart);
+}
+
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac) {
+  if (b > a) return a + scale8(b - a, frac);
+  return a - scale8(a - b, frac);
+}
+
+inline uint8_t blend8(uint8_t a, uint8_t b, uint8_t amountOfB) {
+  uint16_t partial = (a << 8) | b;
+  partial += (b * amountOfB);
+  partial -= (a * amountOfB);
+  return partial >> 8;
+}
+
+inline uint8_t triwave8(uint8_t in) {
+  if (in & 0x80) in = 255 - in;
+  return in << 1;
+}
+
+inline uint8_t ease8InOutCubic(fract8 i) {
+  uint8_t ii = scale8(i, i);
+  uint8_t iii = scale8(ii, i);
+  uint16_t r1 = (3 * (uint16_t)(ii)) - (2 * (uint16_t)(iii));
+  uint8_t result = r1;
+  if (r1 & 0x100) result = 255;
+  return result;
+}
+
+inline uint8_t sin8(uint8_t theta) {
+  static const uint8_t b_m16_interleave[] = {0, 49, 49, 41, 90, 27, 117, 10};
+  uint8_t offset = theta;
+  if (theta & 0x40) offset = (uint8_t)255 - offset;
+  offset &= 0x3F;
+  uint8_t secoffset = offset & 0x0F;
+  if (theta & 0x40) ++secoffset;
+  uint8_t section = offset >> 4;
+  uint8_t b = b_m16_interleave[section * 2];
+  uint8_t m16 = b_m16_interleave[section * 2 + 1];
+  uint8_t mx = (m16 * secoffset) >> 4;
+  int8_t y = mx + b;
+  if (theta & 0x80) y = -y;
+  y += 128;
+  return y;
+}
+
+inline uint8_t cos8(uint8_t theta) { return sin8(theta + 64); }
+
+inline int16_t sin16(uint16_t theta) {
+  static const uint16_t base[] = {0, 6393, 12539, 18204, 23170, 27245, 30273, 32137};
+  static const uint8_t slope[] = {49, 48, 44, 38, 31, 23, 14, 4};
+  uint16_t offset = (theta & 0x3FFF) >> 3;
+  if (theta & 0x4000) offset = 2047 - offset;
+  uint8_t section = offset / 256;
+  uint16_t b = base[section];
+  uint8_t m = slope[section];
+  uint8_t secoffset8 = (uint8_t)(offset) / 2;
+  uint16_t mx = m * secoffset8;
+  int16_t y = mx + b;
+  if (theta & 0x8000) y = -y;
+  return y;
+}
+
+inline int16_t cos16(uint16_t theta) { return sin16(theta + 16384); }
+
+// --- random ---
+
+extern thread_local uint16_t rand16seed;
+
+inline uint8_t random8() {
+  rand16seed = (rand16seed * 2053) + 13849;
+  return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8)));
+}
+inline uint8_t random8(uint8_t lim) { return (random8() * lim) >> 8; }
+inline uint8_t random8(uint8_t min, uint8_t lim) { return random8(lim - min) + min; }
+inline uint16_t random16() {
+  rand16seed = (rand16seed * 2053) + 13849;
+  return rand16seed;
+}
+inline void random16_set_seed(uint16_t seed) { rand16seed = seed; }
+inline void random16_add_entropy(uint16_t entropy) { rand16seed += entropy; }
+
+// --- beat generators (driven by the virtual millis()) ---
+
+inline uint16_t beat88(accum88 beats_per_minute_88, uint32_t timebase = 0) {
+  return (((uint32_t)millis() - timebase) * beats_per_minute_88 * 280) >> 16;
+}
+
+inline uint16_t beat16(accum88 beats_per_minute, uint32_t timebase = 0) {
+  if (beats_per_minute < 256) beats_per_minute <<= 8;
+  return beat88(beats_per_minute, timebase);
+}
+
+inline uint8_t beat8(accum88 beats_per_minute, uint32_t timebase = 0) {
+  return beat16(beats_per_minute, timebase) >> 8;
+}
+
+inline uint16_t beatsin16(accum88 beats_per_minute, uint16_t lowest = 0, uint16_t highest = 65535,
+                          uint32_t timebase = 0, uint16_t phase_offset = 0) {
+  uint16_t beat = beat16(beats_per_minute, timebase);
+  uint16_t beatsin = (sin16(beat + phase_offset) + 32768);
+  uint16_t rangewidth = highest - lowest;
+  return lowest + scale16(beatsin, rangewidth);
+}
+
+inline uint8_t beatsin8(accum88 beats_per_minute, uint8_t lowest = 0, uint8_t highest = 255,
+                        uint32_t timebase = 0, uint8_t phase_offset = 0) {
+  uint8_t beat = beat8(beats_per_minute, timebase);
+  uint8_t beatsin = sin8(beat + phase_offset);
+  uint8_t rangewidth = highest - lowest;
+  return lowest + scale8(beatsin, rangewidth);
+}
+
+// --- colors ---
+
+struct CHSV {
+  union {
+    struct {
+      union { uint8_t hue; uint8_t h; };
+      union { uint8_t saturation; uint8_t sat; uint8_t s; };
+      union { uint8_t value; uint8_t val; uint8_t v; };
+    };
+    uint8_t raw[3];
+  };
+  CHSV() = default;
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb);
+
+struct CRGB {
+  union {
+    struct {
+      union { uint8_t r; uint8_t red; };
+      union { uint8_t g; uint8_t green; };
+      union { uint8_t b; uint8_t blue; };
+    };
+    uint8_t raw[3];
+  };
+
+  typedef enum {
+    Black = 0x000000,
+    Blue = 0x0000FF,
+    Cyan = 0x00FFFF,
+    Gold = 0xFFD700,
+    Green = 0x008000,
+    Magenta = 0xFF00FF,
+    Orange = 0xFFA500,
+    Purple = 0x800080,
+    Red = 0xFF0000,
+    Turquoise = 0x40E0D0,
+    White = 0xFFFFFF,
+    Yellow = 0xFFFF00,
+  } HTMLColorCode;
+
+  CRGB() = default;
+  constexpr CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  constexpr CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+  constexpr CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+  CRGB(const CHSV& rhs) { hsv2rgb_rainbow(rhs, *this); }
+
+  CRGB& operator=(const CHSV& rhs) { hsv2rgb_rainbow(rhs, *this); return *this; }
+  CRGB& operator=(uint32_t colorcode) { r = (colorcode >> 16) & 0xFF; g = (colorcode >> 8) & 0xFF; b = colorcode & 0xFF; return *this; }
+
+  uint8_t& operator[](uint8_t x) { return raw[x]; }
+  const uint8_t& operator[](uint8_t x) const { return raw[x]; }
+
+  CRGB& setRGB(uint8_t nr, uint8_t ng, uint8_t nb) { r = nr; g = ng; b = nb; return *this; }
+  CRGB& setHSV(uint8_t hue, uint8_t sat, uint8_t val) { hsv2rgb_rainbow(CHSV(hue, sat, val), *this); return *this; }
+  CRGB& setHue(uint8_t hue) { return setHSV(hue, 255, 255); }
+
+  CRGB& operator+=(const CRGB& rhs) { r = qadd8(r, rhs.r); g = qadd8(g, rhs.g); b = qadd8(b, rhs.b); return *this; }
+  CRGB& operator-=(const CRGB& rhs) { r = qsub8(r, rhs.r); g = qsub8(g, rhs.g); b = qsub8(b, rhs.b); return *this; }
+
+  CRGB& nscale8(uint8_t scaledown) {
+    r = scale8(r, scaledown); g = scale8(g, scaledown); b = scale8(b, scaledown);
+    return *this;
+  }
+  CRGB& nscale8_video(uint8_t scaledown) {
+    uint8_t nonzeroscale = (scaledown != 0) ? 1 : 0;
+    r = (r == 0) ? 0 : (((int)r * (int)(scaledown)) >> 8) + nonzeroscale;
+    g = (g == 0) ? 0 : (((int)g * (int)(scaledown)) >> 8) + nonzeroscale;
+    b = (b == 0) ? 0 : (((int)b * (int)(scaledown)) >> 8) + nonzeroscale;
+    return *this;
+  }
+  CRGB& fadeToBlackBy(uint8_t fadefactor) { return nscale8(255 - fadefactor); }
+
+  explicit operator bool() const { return r || g || b; }
+};
+
+inline bool operator==(const CRGB& lhs, const CRGB& rhs) { return lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b; }
+inline bool operator!=(const CRGB& lhs, const CRGB& rhs) { return !(lhs == rhs); }
+
+CRGB blend(const CRGB& p1, const CRGB& p2, fract8 amountOfP2);
+
+// --- pixel sets ---
+
+template <class PIXEL_TYPE>
+class CPixelView {
+public:
+  const int8_t dir;
+  const int len;
+  PIXEL_TYPE* const leds;
+  PIXEL_TYPE* const end_pos;
+
+  CPixelView(const CPixelView& other) : dir(other.dir), len(other.len), leds(other.leds), end_pos(other.end_pos) {}
+  CPixelView(PIXEL_TYPE* _leds, int _len) : dir(_len < 0 ? -1 : 1), len(_len), leds(_leds), end_pos(_leds + _len) {}
+  CPixelView(PIXEL_TYPE* _leds, int _start, int _end)
+    : dir(((_end - _start) < 0) ? -1 : 1), len((_end - _start) + dir), leds(_leds + _start), end_pos(_leds + _start + len) {}
+
+  PIXEL_TYPE& operator[](int x) const { return (dir & 0x80) ? leds[-x] : leds[x]; }
+  CPixelView operator()(int start, int end) { return CPixelView(leds, start, end); }
+  operator PIXEL_TYPE*() const { return leds; }
+  int size() const { return len; }
+};
+
+typedef CPixelView<CRGB> CRGBSet;
+
+void fill_solid(CRGB* leds, int numToFill, const CRGB& color);
+void fill_gradient_RGB(CRGB* leds, uint16_t startpos, CRGB startcolor, uint16_t endpos, CRGB endcolor);
+void nscale8(CRGB* leds, uint16_t num_leds, uint8_t scale);
+void fadeToBlackBy(CRGB* leds, uint16_t num_leds, uint8_t fadeBy);
+
+// --- palettes ---
+
+typedef const uint8_t TProgmemRGBGradientPalette_byte;
+typedef const TProgmemRGBGradientPalette_byte* TProgmemRGBGradientPalette_bytes;
+typedef TProgmemRGBGradientPalette_bytes TProgmemRGBGradientPaletteRef;
+
+#define DEFINE_GRADIENT_PALETTE(X) extern const TProgmemRGBGradientPalette_byte X[] PROGMEM; \
+  const TProgmemRGBGradientPalette_byte X[] PROGMEM =
+
+typedef enum { NOBLEND = 0, LINEARBLEND = 1, LINEARBLEND_NOWRAP = 2 } TBlendType;
+
+class CRGBPalette16 {
+public:
+  CRGB entries[16];
+
+  CRGBPalette16() = default;
+  CRGBPalette16(TProgmemRGBGradientPalette_bytes progpal) { *this = progpal; }
+  CRGBPalette16& operator=(TProgmemRGBGradientPalette_bytes progpal);
+
+  CRGB& operator[](uint8_t x) { return entries[x]; }
+  const CRGB& operator[](uint8_t x) const { return entries[x]; }
+  bool operator==(const CRGBPalette16& rhs) const { return memcmp(entries, rhs.entries, sizeof(entries)) == 0; }
+  bool operator!=(const CRGBPalette16& rhs) const { return !(*this == rhs); }
+};
+
+CRGB ColorFromPalette(const CRGBPalette16& pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND);
+
+// --- timers ---
+
+class CEveryNMillis {
+public:
+  uint32_t mPrevTrigger;
+  uint32_t mPeriod;
+  CEveryNMillis(uint32_t period) : mPrevTrigger(millis()), mPeriod(period) {}
+  bool ready() {
+    bool isReady = (uint32_t)(millis() - mPrevTrigger) >= mPeriod;
+    if (isReady) mPrevTrigger = millis();
+    return isReady;
+  }
+  operator bool() { return ready(); }
+};
+
+#define FL_CONCAT_INNER(a, b) a##b
+#define FL_CONCAT(a, b) FL_CONCAT_INNER(a, b)
+#define EVERY_N_MILLISECONDS(N) EVERY_N_MILLISECONDS_I(FL_CONCAT(PER, __COUNTER__), N)
+#define EVERY_N_MILLISECONDS_I(NAME, N) static CEveryNMillis NAME(N); if (NAME)
+#define EVERY_N_MILLIS(N) EVERY_N_MILLISECONDS(N)
+
+// --- controller ---
+
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+template <uint8_t DATA_PIN, EOrder RGB_ORDER = GRB> class WS2812 {};
+
+class CFastLED {
+public:
+  template <template <uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+  CFastLED& addLeds(CRGB* data, int nLedsOrOffset, int nLedsIfOffset = 0) {
+    registerLeds(data + (nLedsIfOffset > 0 ? nLedsOrOffset : 0), nLedsIfOffset > 0 ? nLedsIfOffset : nLedsOrOffset);
+    return *this;
+  }
+
+  void show();
+  void clear(bool writeData = false);
+  void delay(unsigned long ms);
+  void setBrightness(uint8_t scale) { brightness_ = scale; }
+  uint8_t getBrightness() const { return brightness_; }
+
+private:
+  void registerLeds(CRGB* data, int count);
+  uint8_t brightness_ = 255;
+};
+
+extern thread_local CFastLED FastLED;
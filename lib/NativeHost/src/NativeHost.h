@@ -0,0 +1,74 @@
+/*
+
+ Native host support for running the Luma firmware headlessly on a desktop.
+
+ The shims in this library (Arduino.h, FastLED.h, EEPROM.h) stand in
+ for the real cores and libraries when building [env:native].  Time is virtual:
+ it only moves when the harness (or the firmware, via delay()) advances it, so
+ every run is repeatable frame for frame.
+
+ All of the shims' state is thread_local, as the firmware's is (state.h):
+ each thread is a pendant with its own clock, pins, EEPROM and LEDs, and a
+ new thread is one just out of reset.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+struct CRGB;
+
+// --- Virtual clock ---
+uint32_t nativeMicros();
+void nativeSetMicros(uint32_t us);
+void nativeAdvanceMicros(uint32_t us);
+
+// --- Pins ---
+// Drive an input pin as if a button was pressed (LOW) or released (HIGH)
+void nativeSetPin(uint8_t pin, uint8_t level);
+// Same, but when the virtual clock reaches atMicros (so it also lands while the firmware sleeps)
+void nativeSchedulePin(uint32_t atMicros, uint8_t pin, uint8_t level);
+
+// --- Periodic timer ---
+// Stand-in for the RTC periodic interrupt: calls handler every periodUs of
+// virtual time from now on.  A null handler or zero period stops it.
+void nativeSetTimer(void (*handler)(), uint32_t periodUs);
+
+// --- Sleep ---
+// Stand-in for sleep_cpu(): jumps the virtual clock to the next scheduled pin
+// event or timer tick (which fires any attached interrupt).  Returns false if
+// there is none, i.e. nothing would ever wake the part.
+bool nativeSleep();
+
+// --- Real time and the serial port ---
+// From now on the virtual clock keeps up with the wall clock: moving it on
+// really waits, and bytes that arrive on fd meanwhile go to rx, one call per
+// byte, with the clock at their arrival, as the receive interrupt would take
+// them.  Like the part's interrupts, they only land while the firmware waits
+// (the frame scheduler, delay()).  nativeSerialWrite() sends to the same fd.
+void nativeRealTime(int fd, void (*rx)(uint8_t byte));
+void nativeSerialWrite(uint8_t byte);
+
+// --- Serial ---
+// Serial (the Arduino one, as telemetry.h uses it) reads what nativeSerialInput()
+// queued, and with a hook set its writes go to the hook instead of stdout
+void nativeSerialInput(uint8_t byte);
+void nativeSetSerialHook(void (*hook)(uint8_t byte));
+
+// --- Supply ---
+// What the part's VDD measures (battery.h), in mV; 4500 (3 x AAA) until set
+void nativeSetSupplyMv(uint16_t mv);
+uint16_t nativeSupplyMv();
+
+// --- EEPROM ---
+void nativeEepromErase();               // back to a blank (0xFF) part
+uint32_t nativeEepromWrites();          // total physical byte writes since start
+uint32_t nativeEepromMaxCellWrites();   // writes to the most-written byte, for wear
+
+// --- LED output ---
+typedef void (*NativeShowHook)(const CRGB* leds, int count);
+void nativeSetShowHook(NativeShowHook hook);
+CRGB* nativeLeds();                     // buffer registered with FastLED.addLeds()
+int nativeLedCount();
+uint32_t nativeShowCount();
@@ -0,0 +1,514 @@
+/*
+
+ Native host shim implementations: virtual clock, pins, EEPROM and the FastLED
+ pieces that are too big to live in the header.
+
+*/
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <EEPROM.h>
+#include <stdio.h>
+
+#include "NativeHost.h"
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include <poll.h>
+#include <unistd.h>
+
+// --- Virtual clock ---
+
+static thread_local uint32_t virtualMicros = 0;
+
+static bool nextEvent(uint32_t& at);
+static void fireEvent();
+static thread_local bool realTime = false;
+static uint32_t waitWall(uint32_t us);
+
+uint32_t nativeMicros() { return virtualMicros; }
+
+// Pin events and timer ticks on the way to us fire in time order, each with
+// the clock at its own time, as the interrupts would on the part
+static void stepTo(uint32_t us) {
+  uint32_t at;
+  while (nextEvent(at) && at <= us) {
+    if (at > virtualMicros) virtualMicros = at;
+    fireEvent();
+  }
+  virtualMicros = us;
+}
+
+void nativeSetMicros(uint32_t us) {
+  stepTo(realTime ? waitWall(us) : us);
+}
+void nativeAdvanceMicros(uint32_t us) { nativeSetMicros(virtualMicros + us); }
+
+unsigned long millis() { return virtualMicros / 1000; }
+unsigned long micros() { return virtualMicros; }
+void delay(unsigned long ms) { nativeAdvanceMicros(ms * 1000); }
+void delayMicroseconds(unsigned int us) { nativeAdvanceMicros(us); }
+
+// --- Pins ---
+
+#define NATIVE_PIN_COUNT 32
+
+static thread_local uint8_t pinLevel[NATIVE_PIN_COUNT];
+static thread_local bool pinLevelInit = false;
+
+static void initPins() {
+  if (pinLevelInit) return;
+  memset(pinLevel, HIGH, sizeof(pinLevel)); // buttons idle high on their pull-ups
+  pinLevelInit = true;
+}
+
+void pinMode(uint8_t, uint8_t) { initPins(); }
+
+int digitalRead(uint8_t pin) {
+  initPins();
+  return pin < NATIVE_PIN_COUNT ? pinLevel[pin] : LOW;
+}
+
+struct PinInterrupt {
+  void (*handler)();
+  int mode;
+};
+
+static thread_local PinInterrupt pinInterrupts[NATIVE_PIN_COUNT];
+
+void attachInterrupt(uint8_t pin, void (*userFunc)(void), int mode) {
+  if (pin < NATIVE_PIN_COUNT) pinInterrupts[pin] = {userFunc, mode};
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < NATIVE_PIN_COUNT) pinInterrupts[pin] = {nullptr, 0};
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  initPins();
+  if (pin >= NATIVE_PIN_COUNT) return;
+  uint8_t level = val ? HIGH : LOW;
+  bool changed = pinLevel[pin] != level;
+  pinLevel[pin] = level;
+
+  const PinInterrupt& irq = pinInterrupts[pin];
+  if (changed && irq.handler &&
+      (irq.mode == CHANGE || (irq.mode == FALLING && level == LOW) || (irq.mode == RISING && level == HIGH))) {
+    irq.handler();
+  }
+}
+
+void nativeSetPin(uint8_t pin, uint8_t level) { digitalWrite(pin, level); }
+
+// Pending pin changes keyed by virtual time (multimap keeps same-time events in order)
+static thread_local std::multimap<uint32_t, std::pair<uint8_t, uint8_t>> pinEvents;
+
+void nativeSchedulePin(uint32_t atMicros, uint8_t pin, uint8_t level) {
+  pinEvents.insert({atMicros, {pin, level}});
+  nativeSetMicros(virtualMicros); // fire it now if it is already due
+}
+
+// --- Periodic timer ---
+
+static thread_local void (*timerHandler)() = nullptr;
+static thread_local uint32_t timerPeriod = 0;
+static thread_local uint32_t timerNext = 0;
+
+void nativeSetTimer(void (*handler)(), uint32_t periodUs) {
+  timerHandler = periodUs ? handler : nullptr;
+  timerPeriod = periodUs;
+  timerNext = virtualMicros + periodUs;
+}
+
+// Earliest pending pin event or timer tick
+static bool nextEvent(uint32_t& at) {
+  bool pin = !pinEvents.empty();
+  if (pin) at = pinEvents.begin()->first;
+  if (timerHandler && (!pin || timerNext < at)) {
+    at = timerNext;
+    return true;
+  }
+  return pin;
+}
+
+static void fireEvent() {
+  if (timerHandler && (pinEvents.empty() || timerNext < pinEvents.begin()->first)) {
+    timerNext += timerPeriod;
+    timerHandler();
+    return;
+  }
+  auto event = pinEvents.begin()->second;
+  pinEvents.erase(pinEvents.begin());
+  nativeSetPin(event.first, event.second);
+}
+
+bool nativeSleep() {
+  uint32_t at;
+  if (!nextEvent(at)) return false;
+  nativeSetMicros(at > virtualMicros ? at : virtualMicros);
+  return true;
+}
+
+// --- Real time and the serial port ---
+
+static thread_local int serialFd = -1;
+static thread_local void (*serialRx)(uint8_t) = nullptr;
+static thread_local std::chrono::steady_clock::time_point wallStart;
+static thread_local uint32_t wallStartMicros;
+
+static uint32_t wallMicros() {
+  auto since = std::chrono::steady_clock::now() - wallStart;
+  return wallStartMicros + std::chrono::duration_cast<std::chrono::microseconds>(since).count();
+}
+
+// Waits until the wall clock reaches us, delivering serial bytes on the way.
+// Returns where the clock ends up: us, or later if the firmware was already behind.
+static uint32_t waitWall(uint32_t us) {
+  for (;;) {
+    int32_t left = (int32_t)(us - wallMicros());
+    timespec timeout = {left > 0 ? left / 1000000 : 0, left > 0 ? (left % 1000000) * 1000L : 0};
+    pollfd port = {serialFd, POLLIN, 0};
+    if (ppoll(&port, serialFd >= 0 ? 1 : 0, &timeout, nullptr) > 0) {
+      uint8_t bytes[256];
+      ssize_t n = read(serialFd, bytes, sizeof(bytes));
+      if (n <= 0) {
+        serialFd = -1; // the other end is gone; keep the time
+        continue;
+      }
+      uint32_t at = wallMicros();
+      if ((int32_t)(at - us) > 0) at = us;
+      if ((int32_t)(at - virtualMicros) > 0) stepTo(at);
+      for (ssize_t i = 0; i < n; i++) serialRx(bytes[i]);
+      continue;
+    }
+    if (left <= 0) return us - left;
+  }
+}
+
+void nativeRealTime(int fd, void (*rx)(uint8_t byte)) {
+  serialFd = fd;
+  serialRx = rx;
+  wallStart = std::chrono::steady_clock::now();
+  wallStartMicros = virtualMicros;
+  realTime = true;
+}
+
+void nativeSerialWrite(uint8_t byte) {
+  if (serialFd >= 0 && write(serialFd, &byte, 1) != 1) serialFd = -1;
+}
+
+// --- Serial ---
+
+thread_local HardwareSerial Serial;
+
+static thread_local std::deque<uint8_t> serialInput;
+static thread_local void (*serialHook)(uint8_t) = nullptr;
+
+void nativeSerialInput(uint8_t byte) { serialInput.push_back(byte); }
+void nativeSetSerialHook(void (*hook)(uint8_t byte)) { serialHook = hook; }
+
+int HardwareSerial::available() { return serialInput.size(); }
+
+int HardwareSerial::read() {
+  if (serialInput.empty()) return -1;
+  uint8_t byte = serialInput.front();
+  serialInput.pop_front();
+  return byte;
+}
+
+void HardwareSerial::flush() { fflush(stdout); }
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serialHook) {
+    serialHook(c);
+    return 1;
+  }
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+  for (size_t i = 0; i < len; i++) write(buf[i]);
+  return len;
+}
+size_t HardwareSerial::print(const char* s) { return fputs(s, stdout) == EOF ? 0 : strlen(s); }
+size_t HardwareSerial::print(unsigned long n, int base) { return printf(base == HEX ? "%lX" : "%lu", n); }
+size_t HardwareSerial::print(long n, int base) { return printf(base == HEX ? "%lX" : "%ld", n); }
+
+// --- Supply ---
+
+static thread_local uint16_t supplyMv = 4500;
+
+void nativeSetSupplyMv(uint16_t mv) { supplyMv = mv; }
+uint16_t nativeSupplyMv() { return supplyMv; }
+
+// --- EEPROM ---
+
+thread_local EEPROMClass EEPROM;
+
+static thread_local uint8_t eepromData[EEPROM_SIZE];
+static thread_local bool eepromInit = false;
+static thread_local uint32_t eepromWrites = 0;
+static thread_local uint32_t eepromCellWrites[EEPROM_SIZE];
+
+static void initEeprom() {
+  if (eepromInit) return;
+  memset(eepromData, 0xFF, sizeof(eepromData));
+  eepromInit = true;
+}
+
+uint8_t EEPROMClass::read(int idx) {
+  initEeprom();
+  return eepromData[idx % EEPROM_SIZE];
+}
+
+void EEPROMClass::write(int idx, uint8_t val) {
+  initEeprom();
+  eepromData[idx % EEPROM_SIZE] = val;
+  eepromWrites++;
+  eepromCellWrites[idx % EEPROM_SIZE]++;
+}
+
+void EEPROMClass::update(int idx, uint8_t val) {
+  if (read(idx) != val) write(idx, val);
+}
+
+void nativeEepromErase() {
+  eepromInit = false;
+  initEeprom();
+}
+
+uint32_t nativeEepromWrites() { return eepromWrites; }
+
+uint32_t nativeEepromMaxCellWrites() {
+  uint32_t most = 0;
+  for (uint32_t writes : eepromCellWrites) most = writes > most ? writes : most;
+  return most;
+}
+
+// --- FastLED ---
+
+thread_local CFastLED FastLED;
+thread_local uint16_t rand16seed = 1337;
+
+static thread_local CRGB* registeredLeds = nullptr;
+static thread_local int registeredCount = 0;
+static thread_local uint32_t showCount = 0;
+static thread_local NativeShowHook showHook = nullptr;
+
+void CFastLED::registerLeds(CRGB* data, int count) {
+  registeredLeds = data;
+  registeredCount = count;
+}
+
+void CFastLED::show() {
+  showCount++;
+  if (showHook) showHook(registeredLeds, registeredCount);
+}
+
+void CFastLED::clear(bool writeData) {
+  if (registeredLeds) memset(registeredLeds, 0, sizeof(CRGB) * registeredCount);
+  if (writeData) show();
+}
+
+// Same as FastLED: keeps refreshing the strip (for dithering) until the time is up
+void CFastLED::delay(unsigned long ms) {
+  unsigned long start = millis();
+  do {
+    ::delay(1);
+    show();
+  } while ((millis() - start) < ms);
+}
+
+void nativeSetShowHook(NativeShowHook hook) { showHook = hook; }
+CRGB* nativeLeds() { return registeredLeds; }
+int nativeLedCount() { return registeredCount; }
+uint32_t nativeShowCount() { return showCount; }
+
+void fill_solid(CRGB* leds, int numToFill, const CRGB& color) {
+  for (int i = 0; i < numToFill; ++i) leds[i] = color;
+}
+
+void nscale8(CRGB* leds, uint16_t num_leds, uint8_t scale) {
+  for (uint16_t i = 0; i < num_leds; ++i) leds[i].nscale8(scale);
+}
+
+void fadeToBlackBy(CRGB* leds, uint16_t num_leds, uint8_t fadeBy) {
+  nscale8(leds, num_leds, 255 - fadeBy);
+}
+
+CRGB blend(const CRGB& p1, const CRGB& p2, fract8 amountOfP2) {
+  return CRGB(blend8(p1.r, p2.r, amountOfP2), blend8(p1.g, p2.g, amountOfP2), blend8(p1.b, p2.b, amountOfP2));
+}
+
+void fill_gradient_RGB(CRGB* leds, uint16_t startpos, CRGB startcolor, uint16_t endpos, CRGB endcolor) {
+  if (endpos < startpos) {
+    uint16_t t = endpos;
+    CRGB tc = endcolor;
+    endcolor = startcolor;
+    endpos = startpos;
+    startpos = t;
+    startcolor = tc;
+  }
+
+  saccum87 rdistance87 = (endcolor.r - startcolor.r) << 7;
+  saccum87 gdistance87 = (endcolor.g - startcolor.g) << 7;
+  saccum87 bdistance87 = (endcolor.b - startcolor.b) << 7;
+
+  uint16_t pixeldistance = endpos - startpos;
+  int16_t divisor = pixeldistance ? pixeldistance : 1;
+
+  saccum87 rdelta87 = (rdistance87 / divisor) * 2;
+  saccum87 gdelta87 = (gdistance87 / divisor) * 2;
+  saccum87 bdelta87 = (bdistance87 / divisor) * 2;
+
+  accum88 r88 = startcolor.r << 8;
+  accum88 g88 = startcolor.g << 8;
+  accum88 b88 = startcolor.b << 8;
+  for (uint16_t i = startpos; i <= endpos; ++i) {
+    leds[i] = CRGB(r88 >> 8, g88 >> 8, b88 >> 8);
+    r88 += rdelta87;
+    g88 += gdelta87;
+    b88 += bdelta87;
+  }
+}
+
+CRGBPalette16& CRGBPalette16::operator=(TProgmemRGBGradientPalette_bytes progpal) {
+  const uint8_t* progent = progpal;
+
+  // Count entries
+  uint16_t count = 0;
+  while (progent[count * 4] != 255) ++count;
+  ++count;
+
+  int8_t lastSlotUsed = -1;
+  CRGB rgbstart(progent[1], progent[2], progent[3]);
+  int indexstart = 0;
+  while (indexstart < 255) {
+    progent += 4;
+    int indexend = progent[0];
+    CRGB rgbend(progent[1], progent[2], progent[3]);
+    uint8_t istart8 = indexstart / 16;
+    uint8_t iend8 = indexend / 16;
+    if (count < 16) {
+      if ((istart8 <= lastSlotUsed) && (lastSlotUsed < 15)) {
+        istart8 = lastSlotUsed + 1;
+        if (iend8 < istart8) iend8 = istart8;
+      }
+      lastSlotUsed = iend8;
+    }
+    fill_gradient_RGB(&(entries[0]), istart8, rgbstart, iend8, rgbend);
+    indexstart = indexend;
+    rgbstart = rgbend;
+  }
+  return *this;
+}
+
+CRGB ColorFromPalette(const CRGBPalette16& pal, uint8_t index, uint8_t brightness, TBlendType blendType) {
+  if (blendType == LINEARBLEND_NOWRAP) index = map8(index, 0, 239);
+
+  uint8_t hi4 = index >> 4;
+  uint8_t lo4 = index & 0x0F;
+
+  const CRGB* entry = &(pal[0]) + hi4;
+  uint8_t red1 = entry->red;
+  uint8_t green1 = entry->green;
+  uint8_t blue1 = entry->blue;
+
+  if (lo4 && (blendType != NOBLEND)) {
+    entry = (hi4 == 15) ? &(pal[0]) : entry + 1;
+    uint8_t f2 = lo4 << 4;
+    uint8_t f1 = 255 - f2;
+    red1 = scale8(red1, f1) + scale8(entry->red, f2);
+    green1 = scale8(green1, f1) + scale8(entry->green, f2);
+    blue1 = scale8(blue1, f1) + scale8(entry->blue, f2);
+  }
+
+  if (brightness != 255) {
+    if (brightness) {
+      ++brightness; // adjust for rounding
+      if (red1) red1 = scale8(red1, brightness);
+      if (green1) green1 = scale8(green1, brightness);
+      if (blue1) blue1 = scale8(blue1, brightness);
+    } else {
+      red1 = green1 = blue1 = 0;
+    }
+  }
+  return CRGB(red1, green1, blue1);
+}
+
+void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb) {
+  const uint8_t K255 = 255;
+  const uint8_t K171 = 171;
+  const uint8_t K170 = 170;
+  const uint8_t K85 = 85;
+
+  uint8_t hue = hsv.hue;
+  uint8_t sat = hsv.sat;
+  uint8_t val = hsv.val;
+
+  uint8_t offset = hue & 0x1F; // 0..31
+  uint8_t offset8 = offset << 3;
+  uint8_t third = scale8(offset8, (256 / 3)); // max = 85
+
+  uint8_t r, g, b;
+  if (!(hue & 0x80)) {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) { // R -> O
+        r = K255 - third; g = third; b = 0;
+      } else {             // O -> Y
+        r = K171; g = K85 + third; b = 0;
+      }
+    } else {
+      if (!(hue & 0x20)) { // Y -> G
+        uint8_t twothirds = scale8(offset8, ((256 * 2) / 3));
+        r = K171 - twothirds; g = K170 + third; b = 0;
+      } else {             // G -> A
+        r = 0; g = K255 - third; b = third;
+      }
+    }
+  } else {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) { // A -> B
+        uint8_t twothirds = scale8(offset8, ((256 * 2) / 3));
+        r = 0; g = K171 - twothirds; b = K85 + twothirds;
+      } else {             // B -> P
+        r = third; g = 0; b = K255 - third;
+      }
+    } else {
+      if (!(hue & 0x20)) { // P -> K
+        r = K85 + third; g = 0; b = K171 - third;
+      } else {             // K -> R
+        r = K170 + third; g = 0; b = K85 - third;
+      }
+    }
+  }
+
+  if (sat != 255) {
+    if (sat == 0) {
+      r = 255; g = 255; b = 255;
+    } else {
+      uint8_t desat = 255 - sat;
+      desat = scale8_video(desat, desat);
+      uint8_t satscale = 255 - desat;
+      r = scale8(r, satscale) + desat;
+      g = scale8(g, satscale) + desat;
+      b = scale8(b, satscale) + desat;
+    }
+  }
+
+  if (val != 255) {
+    val = scale8_video(val, val);
+    if (val == 0) {
+      r = 0; g = 0; b = 0;
+    } else {
+      r = scale8(r, val);
+      g = scale8(g, val);
+      b = scale8(b, val);
+    }
+  }
+
+  rgb.r = r;
+  rgb.g = g;
+  rgb.b = b;
+}
@@ -0,0 +1,1108 @@
+/*
+
+ Native host harness: steps the firmware's patterns frame by frame on a virtual
+ clock, dumps the frames and reports how long each pattern takes to render.
+
+   .pio/build/native/program [--frames N] [--fps F] [--outer I] [--inner J]
+                             [--dump DIR] [--loop] [--press PIN@MS[:HOLDMS]]... [--bounce N]
+                             [--energy [--bench FILE] [--capacity MAH]]
+                             [--transitions] [--power-cycles N]
+                             [--wav FILE [--bpm REF]] [--stream]
+                             [--vm] [--program FILE] [--battery [--capacity MAH]]
+                             [--telemetry FILE] [--fleet N [--threads T,...] [--tile PX]]
+
+ By default every outerPatternList entry is run next to its innerPatternList
+ partner (the lists are 1-to-1).  --outer/--inner pick any single pairing.
+ Pairs render through transition.h as loop() renders them, so a keyframed
+ pattern (pattern.h) is drawn only on its keyframes and its mean time drops.
+ --dump writes one PPM per pairing: one row per frame, one column per LED.
+ Each pairing also reports its peak and average estimated current (power.h);
+ LIMITED marks those the power limiter would scale down.
+ --loop runs the real loop() instead, so buttons, the frame scheduler and
+ show() are exercised too; --press holds a button pin LOW from virtual time MS
+ for HOLDMS (default 150) and can be repeated.  Presses land even while the
+ firmware is powered down, so they also wake it from the off state.
+ --bounce adds N contact bounces (300 us apart) after every press and release
+ edge, to exercise the debounce in buttons.cpp.
+
+ --energy estimates battery life per pairing from the power model in power.h:
+ LED current from the rendered frames, MCU current from its active/idle duty.
+ Render cost only counts if --bench points at a log from [env:bench] (its
+ cycle counts are real AVR cycles); otherwise only show() time is active.
+
+ --transitions times every pattern switch over a whole crossfade, when the
+ outgoing and incoming patterns both render each frame, next to the steady
+ cost of the incoming pair.
+
+ --power-cycles tests the settings store (settings.h).  It starts from the
+ EEPROM the firmware used to leave behind (legacy bytes only), then N times:
+ presses buttons at random, cuts the power at a random moment, often in the
+ middle of a commit, and boots again.  Every boot has to load what the last
+ complete record held.  It reports the EEPROM byte writes and the wear on the
+ most-written byte.
+
+ --wav plays a WAV file (PCM, any rate and channel count) through the beat
+ engine (beat.h): it is mixed to mono, resampled to BEAT_SAMPLE_HZ, scaled to
+ 10-bit ADC counts and fed to beatSample() on the virtual clock, with
+ beatUpdate() once a frame as on the part.  It prints the engine's view once
+ a second and its desktop cost per sample and per update.  With --bpm, beats
+ are scored against a grid of that tempo starting at t=0, which is how
+ tools/synth_beat_wav.py writes its tracks.
+
+ --stream (a -DLUMA_STREAM build) opens a pseudo-terminal, prints its name and
+ runs loop() in real time for --frames frames with the pty as the pendant's
+ serial port (stream.h).  Point tools/stream_frames.py at it: it reports the
+ end-to-end latency from its side, and the harness reports what the pendant
+ saw, including when the stream stopped and the patterns took over again.
+
+ --vm renders berlinMode and bpm next to their bytecode versions (vm.h) on the
+ same frames, checks the output matches LED for LED, and compares the render
+ times; it exits 1 if any frame differs.  tools/led_sweep.py runs it on every ring length it builds, most of
+ which do not divide 256.  --program loads an EEPROM image from tools/vm_asm.py --bin before
+ booting, so the EEPROM bytecode entry of outerPatternList runs it.
+
+ --battery replays a discharge of three alkaline AAA cells through loop() at
+ the "High" brightness: the cells' voltage follows a discharge curve and
+ their internal resistance under the current the power model (power.h)
+ estimates for each frame, with the charge drawn 60 times faster than the
+ virtual clock runs, and what the part would measure of it goes to the
+ battery monitor (battery.h).  It runs twice, once with the monitor always
+ seeing fresh cells (the firmware before battery.h) and once with the real
+ voltage, until the cells brown out, and reports the hours each one ran and
+ how long it spent at each BatteryLevel.  --outer/--inner pick the pairing
+ (default: the auto-cycle).
+
+ --telemetry (a -DLUMA_TELEMETRY build) runs loop() for --frames frames,
+ with any --press, then asks for a report over Serial as a host would
+ (telemetry.h) and writes what comes back to FILE, framing and all, for
+ tools/telemetry_report.py FILE to decode.  On the virtual clock only the
+ wait and show() take any time, so the phase times show the protocol works
+ rather than what a pendant costs.
+
+ --fleet previews a crowd of N pendants.  Each one boots on a pair,
+ brightness tier, boot time (its phase) and random seed of its own, drawn
+ from its number, and runs loop() for --frames frames.  Everything the
+ firmware and these shims change is thread_local (state.h), so every pendant
+ gets a fresh thread, which is a part out of reset, and a pool of T workers
+ keeps T of them running.  It runs the fleet once per --threads count
+ (default 1 and every core), reports simulated pendant-frames per second and
+ the speedup over the first count, and checks every run drew the same frames.
+ With --dump it composites the last run into DIR/fleet_NNNNN.ppm, one per
+ frame, with the pendants side by side in PX-pixel tiles (default 16):
+   ffmpeg -framerate 129 -i DIR/fleet_%05d.ppm crowd.mp4
+ All the frames are held until the end: N x frames x 60 bytes.
+
+ Render times are desktop nanoseconds: use them to compare patterns and to
+ catch wasted work, not as an absolute AVR cost.
+
+*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <FastLED.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <math.h>
+#include <random>
+#include <thread>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "NativeHost.h"
+#include "battery.h"
+#include "beat.h"
+#include "compositor.h"
+#include "geometry.h"
+#include "transition.h"
+#include "power.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "stream.h"
+#include "telemetry.h"
+#include "tempo.h"
+#include "vm.h"
+
+extern thread_local CRGB leds_raw[];
+extern PatternFn outerPatternList[];
+extern PatternFn innerPatternList[];
+extern const uint8_t OUTER_PATTERN_COUNT;
+extern const uint8_t INNER_PATTERN_COUNT;
+
+struct RenderStats {
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+  uint32_t frames = 0;
+
+  void add(uint64_t ns) {
+    totalNs += ns;
+    if (ns > maxNs) maxNs = ns;
+    frames++;
+  }
+  uint64_t meanNs() const { return frames ? totalNs / frames : 0; }
+};
+
+static std::string patternName(PatternFn fn, const char* list, int index) {
+  Dl_info info;
+  if (dladdr((void*)fn, &info) && info.dli_sname) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : info.dli_sname;
+    free(demangled);
+    // Templates (vmPattern<N>) demangle as "void vmPattern<(unsigned char)3>(FrameContext const&)"
+    if (name.compare(0, 5, "void ") == 0) name.erase(0, 5);
+    for (size_t cast; (cast = name.find("(unsigned char)")) != std::string::npos;) name.erase(cast, 15);
+    size_t paren = name.find('(');
+    return paren == std::string::npos ? name : name.substr(0, paren);
+  }
+  return std::string(list) + "[" + std::to_string(index) + "]";
+}
+
+template <typename Fn>
+static uint64_t timeCall(Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static std::vector<uint8_t> frameLog;
+
+static void captureFrame(const CRGB* leds, int count) {
+  for (int i = 0; i < count; i++) {
+    frameLog.push_back(leds[i].r);
+    frameLog.push_back(leds[i].g);
+    frameLog.push_back(leds[i].b);
+  }
+}
+
+static void writePpm(const std::string& path, int width) {
+  if (width == 0 || frameLog.empty()) return;
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "cannot write %s\n", path.c_str());
+    return;
+  }
+  fprintf(f, "P6\n%d %zu\n255\n", width, frameLog.size() / (3 * width));
+  fwrite(frameLog.data(), 1, frameLog.size(), f);
+  fclose(f);
+}
+
+static bool isAutoCycle(int outer, int inner) {
+  if (outerPatternList[outer] && innerPatternList[inner]) return false;
+  printf("%2d %-32s %s\n", outer, "(auto-cycle)", "shows the other pairs in turn; see --loop");
+  return true;
+}
+
+// Shows a pair from fresh state and a blank canvas, as the loop renders it (keyframes and all)
+static void cutToPair(int outer, int inner) {
+  transitionCut(GROUP_OUTER, nullptr);
+  transitionCut(GROUP_INNER, nullptr);
+  transitionCut(GROUP_OUTER, outerPatternList[outer]);
+  transitionCut(GROUP_INNER, innerPatternList[inner]);
+  compositorClear();
+}
+
+static void runPair(int outer, int inner, uint32_t frames, uint32_t periodUs, const char* dumpDir) {
+  if (isAutoCycle(outer, inner)) return;
+  std::string outerName = patternName(outerPatternList[outer], "outer", outer);
+  std::string innerName = patternName(innerPatternList[inner], "inner", inner);
+  RenderStats outerStats, innerStats;
+  uint32_t peakMa = 0;
+  uint64_t totalMa = 0;
+
+  cutToPair(outer, inner);
+  frameLog.clear();
+  for (uint32_t f = 0; f < frames; f++) {
+    tempoUpdate();
+    FrameContext frame = patternFrameBegin();
+    outerStats.add(timeCall([&] { transitionRender(GROUP_OUTER, frame); }));
+    innerStats.add(timeCall([&] { transitionRender(GROUP_INNER, frame); }));
+    compositorRun();
+    uint16_t ma = powerEstimateMa(nativeLeds(), nativeLedCount());
+    peakMa = std::max<uint32_t>(peakMa, ma);
+    totalMa += ma;
+    if (dumpDir) captureFrame(nativeLeds(), nativeLedCount());
+    nativeAdvanceMicros(periodUs);
+  }
+
+  printf("%2d %-32s %8llu %8llu | %2d %-32s %8llu %8llu | %5u %5llu %s\n",
+         outer, outerName.c_str(), (unsigned long long)outerStats.meanNs(), (unsigned long long)outerStats.maxNs,
+         inner, innerName.c_str(), (unsigned long long)innerStats.meanNs(), (unsigned long long)innerStats.maxNs,
+         peakMa, (unsigned long long)(totalMa / frames), peakMa > POWER_BUDGET_MA ? "LIMITED" : "");
+
+  if (dumpDir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%02d_%s__%02d_%s.ppm", dumpDir, outer, outerName.c_str(), inner, innerName.c_str());
+    writePpm(path, nativeLedCount());
+  }
+}
+
+// Average cycles per frame for each pairing, from an [env:bench] log
+static std::map<int, uint32_t> benchCycles;
+
+static bool loadBench(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    unsigned pair, outer, inner, outerAvg, outerMax, innerAvg;
+    if (sscanf(line, "%u %u %u %u %u %u", &pair, &outer, &inner, &outerAvg, &outerMax, &innerAvg) == 6) {
+      benchCycles[pair] = outerAvg + innerAvg;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static void runEnergy(int outer, int inner, uint32_t frames, uint32_t fps, uint32_t capacityMah) {
+  if (isAutoCycle(outer, inner)) return;
+  std::string outerName = patternName(outerPatternList[outer], "outer", outer);
+  uint32_t periodUs = 1000000UL / fps;
+  int count = nativeLedCount();
+  const CRGB* out = nativeLeds();
+
+  cutToPair(outer, inner);
+  std::vector<CRGB> previous(out, out + count);
+  uint64_t ledMaSum = 0;
+  uint32_t shows = 0;
+  for (uint32_t f = 0; f < frames; f++) {
+    tempoUpdate();
+    FrameContext frame = patternFrameBegin();
+    transitionRender(GROUP_OUTER, frame);
+    transitionRender(GROUP_INNER, frame);
+    compositorRun();
+    ledMaSum += powerEstimateMa(out, count);
+    bool changed = false;
+    for (int i = 0; i < count; i++) {
+      if (!(out[i] == previous[i])) changed = true;
+      previous[i] = out[i];
+    }
+    if (changed) shows++;
+    nativeAdvanceMicros(periodUs);
+  }
+
+  double ledUa = ledMaSum * 1000.0 / frames;
+  double showUs = (double)shows / frames * (count * POWER_SHOW_US_PER_LED + POWER_SHOW_US_LATCH);
+  auto bench = benchCycles.find(outer);
+  double renderUs = bench == benchCycles.end() ? 0 : bench->second / (F_CPU / 1000000.0);
+  double active = std::min(1.0, (showUs + renderUs) / periodUs);
+  double mcuUa = active * POWER_MCU_ACTIVE_UA + (1 - active) * POWER_MCU_IDLE_UA;
+  double totalMa = (ledUa + mcuUa) / 1000.0;
+
+  printf("%2d %-32s %7.1f %7.2f %5.1f%% %8.1f %7.1f\n", outer, outerName.c_str(), ledUa / 1000.0, mcuUa / 1000.0,
+         active * 100, totalMa * POWER_SUPPLY_MV / 1000.0, capacityMah / totalMa);
+}
+
+// One frame of whatever the transitions have on show
+static uint64_t renderFrame() {
+  tempoUpdate();
+  FrameContext frame = patternFrameBegin();
+  auto start = std::chrono::steady_clock::now();
+  transitionRender(GROUP_OUTER, frame);
+  transitionRender(GROUP_INNER, frame);
+  compositorRun();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+// Desktop timings have the odd multi-ms outlier (scheduler, page faults); the median ignores them
+static uint64_t medianNs(std::vector<uint64_t> samples) {
+  if (samples.empty()) return 0;
+  std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+  return samples[samples.size() / 2];
+}
+
+static void runTransitions(uint32_t periodUs) {
+  printf("crossfades of %u ms, median frame ns (render + compositor) during the fade vs the incoming pair alone\n", TRANSITION_MS);
+  printf("%4s %4s %8s %8s %8s\n", "from", "to", "fade", "steady", "ratio");
+  double worstRatio = 0;
+  int worstFrom = 0, worstTo = 0;
+  for (int from = 0; from < OUTER_PATTERN_COUNT; from++) {
+    for (int to = 0; to < OUTER_PATTERN_COUNT; to++) {
+      if (from == to) continue;
+      int innerFrom = from < INNER_PATTERN_COUNT ? from : 0;
+      int innerTo = to < INNER_PATTERN_COUNT ? to : 0;
+      // The auto-cycle's switches are these same fades between the other pairs
+      if (!outerPatternList[from] || !outerPatternList[to] || !innerPatternList[innerFrom] || !innerPatternList[innerTo]) continue;
+
+      std::vector<uint64_t> steady, fade;
+      compositorClear();
+      transitionCut(GROUP_OUTER, outerPatternList[to]);
+      transitionCut(GROUP_INNER, innerPatternList[innerTo]);
+      for (int f = 0; f < 64; f++) {
+        steady.push_back(renderFrame());
+        nativeAdvanceMicros(periodUs);
+      }
+      compositorClear();
+      transitionCut(GROUP_OUTER, outerPatternList[from]);
+      transitionCut(GROUP_INNER, innerPatternList[innerFrom]);
+      for (int f = 0; f < 32; f++) {
+        renderFrame();
+        nativeAdvanceMicros(periodUs);
+      }
+      transitionStart(GROUP_OUTER, outerPatternList[to]);
+      transitionStart(GROUP_INNER, innerPatternList[innerTo]);
+      while (transitionActive(GROUP_OUTER) || transitionActive(GROUP_INNER)) {
+        fade.push_back(renderFrame());
+        nativeAdvanceMicros(periodUs);
+      }
+
+      uint64_t fadeNs = medianNs(fade);
+      uint64_t steadyNs = medianNs(steady);
+      double ratio = steadyNs ? (double)fadeNs / steadyNs : 0;
+      if (ratio > worstRatio) {
+        worstRatio = ratio;
+        worstFrom = from;
+        worstTo = to;
+      }
+      printf("%4d %4d %8llu %8llu %8.2f\n", from, to, (unsigned long long)fadeNs, (unsigned long long)steadyNs, ratio);
+    }
+  }
+  printf("largest fade/steady ratio: %d -> %d (%.2fx)\n", worstFrom, worstTo, worstRatio);
+}
+
+void berlinMode(const FrameContext& frame);
+void bpm(const FrameContext& frame);
+
+static bool runVm(uint32_t frames, uint32_t periodUs) {
+  struct Pair {
+    const char* name;
+    PatternFn native;
+    PatternFn bytecode;
+  };
+  static const Pair pairs[] = {
+    {"berlinMode", berlinMode, vmPattern<VM_PROGRAM_BERLIN>},
+    {"bpm", bpm, vmPattern<VM_PROGRAM_BPM>},
+  };
+
+  printf("%u frames, median render ns per frame, native vs bytecode (vm.h)\n", frames);
+  printf("%-12s %8s %8s %8s %10s\n", "pattern", "native", "bytecode", "ratio", "identical");
+  int count = nativeLedCount();
+  const CRGB* out = nativeLeds();
+  bool allIdentical = true;
+  for (const Pair& pair : pairs) {
+    PatternSlot native, bytecode;
+    patternActivate(native, pair.native);
+    patternActivate(bytecode, pair.bytecode);
+    compositorClear();
+    std::vector<uint64_t> nativeNs, bytecodeNs;
+    std::vector<CRGB> expected(count);
+    uint32_t identical = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+      tempoUpdate();
+      FrameContext frame = patternFrameBegin();
+      nativeNs.push_back(timeCall([&] { patternRender(native, frame); }));
+      compositorRun();
+      std::copy(out, out + count, expected.begin());
+      memset(leds_raw, 0, count * sizeof(CRGB));
+      bytecodeNs.push_back(timeCall([&] { patternRender(bytecode, frame); }));
+      compositorRun();
+      if (std::equal(out, out + count, expected.begin())) identical++;
+      nativeAdvanceMicros(periodUs);
+    }
+    uint64_t n = medianNs(nativeNs), b = medianNs(bytecodeNs);
+    printf("%-12s %8llu %8llu %8.2f %5u/%u\n", pair.name, (unsigned long long)n, (unsigned long long)b,
+           n ? (double)b / n : 0, identical, frames);
+    if (identical != frames) allIdentical = false;
+  }
+  return allIdentical;
+}
+
+static bool loadProgram(const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  uint8_t image[VM_EEPROM_BYTES];
+  size_t n = fread(image, 1, sizeof(image), f);
+  fclose(f);
+  for (size_t i = 0; i < n; i++) EEPROM.write(VM_EEPROM_START + i, image[i]);
+  return n > 0;
+}
+
+// Drives the pin to level at atMicros, then chatters back and forth bounces times
+static void scheduleEdge(uint32_t atMicros, uint8_t pin, uint8_t level, uint32_t bounces) {
+  nativeSchedulePin(atMicros, pin, level);
+  for (uint32_t b = 1; b <= bounces; b++) {
+    nativeSchedulePin(atMicros + (2 * b - 1) * 300, pin, !level);
+    nativeSchedulePin(atMicros + 2 * b * 300, pin, level);
+  }
+}
+
+static void runPowerCycles(uint32_t cycles) {
+  static const char* sources[] = {"log", "legacy bytes", "defaults"};
+
+  // What the firmware before the settings log kept at addresses 0-2
+  nativeEepromErase();
+  EEPROM.write(0, 2);
+  EEPROM.write(1, 2);
+  EEPROM.write(2, 1);
+  uint32_t writesBefore = nativeEepromWrites();
+
+  setup();
+  const Settings& first = settingsGet();
+  printf("first boot: from %s, outer %u inner %u brightness %u\n", sources[settingsStats().source],
+         first.outerPattern, first.innerPattern, first.brightness);
+
+  srand(1);
+  uint32_t presses = 0, button1Presses = 0, commits = 0, mismatches = 0;
+  for (uint32_t c = 0; c < cycles; c++) {
+    uint32_t now = millis();
+    uint32_t runMs = 200 + rand() % 8000;
+    for (int n = rand() % 5; n > 0; n--) {
+      uint8_t pin = rand() % 2 ? 3 : 8;
+      uint32_t atMs = now + rand() % runMs;
+      nativeSchedulePin(atMs * 1000UL, pin, LOW);
+      nativeSchedulePin((atMs + 80) * 1000UL, pin, HIGH);
+      presses++;
+      if (pin == 3) button1Presses++;
+    }
+    while (millis() - now < runMs) loop();
+
+    commits += settingsStats().commits;
+    Settings expected = settingsSaved();
+    setup(); // power back on
+    const Settings& loaded = settingsGet();
+    if (loaded.outerPattern != expected.outerPattern || loaded.innerPattern != expected.innerPattern ||
+        loaded.brightness != expected.brightness) {
+      mismatches++;
+      printf("cycle %u: loaded %u/%u/%u, last record held %u/%u/%u\n", c, loaded.outerPattern, loaded.innerPattern,
+             loaded.brightness, expected.outerPattern, expected.innerPattern, expected.brightness);
+    }
+  }
+
+  printf("%u power cycles, %u presses (%u on button 1), %u commits, %u byte writes, most-written byte %u times, %u bad boots\n",
+         cycles, presses, button1Presses, commits, nativeEepromWrites() - writesBefore, nativeEepromMaxCellWrites(),
+         mismatches);
+}
+
+// Open-circuit voltage of an alkaline AAA cell by the fraction of its charge used, in 10% steps
+static const double CELL_OCV[] = {1.58, 1.45, 1.38, 1.33, 1.29, 1.25, 1.21, 1.17, 1.12, 1.04, 0.90};
+#define BATTERY_CELLS      3
+#define BROWNOUT_MV     2700 // the part and the LED drivers stop working
+// Each virtual second drains a minute of charge: the virtual clock wraps at 71 minutes, and the
+// monitor's filter still settles within minutes of discharge, next to hours of curve
+#define DISCHARGE_SPEEDUP 60
+
+static double cellOcv(double used) {
+  double at = std::min(used, 1.0) * 10;
+  int i = std::min((int)at, 9);
+  return CELL_OCV[i] + (CELL_OCV[i + 1] - CELL_OCV[i]) * (at - i);
+}
+
+// Internal resistance in ohms, which grows as the cell runs down
+static double cellOhms(double used) {
+  return 0.15 + 0.45 * used * used;
+}
+
+// loop() from fresh cells to brown-out; the monitor sees the cells' voltage when tracking, else 4500 mV
+static double runDischarge(int outer, int inner, uint32_t capacityMah, bool tracking) {
+  static const char* levels[] = {"ok", "dim", "low", "critical"};
+  nativeEepromErase();
+  EEPROM.write(0, outer);
+  EEPROM.write(1, inner);
+  EEPROM.write(2, 2); // "High"
+  nativeSetSupplyMv(POWER_SUPPLY_MV);
+  setup();
+
+  const uint32_t showUs = nativeLedCount() * POWER_SHOW_US_PER_LED + POWER_SHOW_US_LATCH;
+  double usedMah = 0, ms = 0, levelMs[BATTERY_LEVEL_COUNT] = {};
+  double reportMs = 0;
+  uint32_t lastMillis = millis(), lastShows = nativeShowCount();
+  printf("%s:\n%6s %8s %7s %7s %7s %-8s\n", tracking ? "monitor on the cells" : "monitor always sees fresh cells",
+         "hours", "used", "mA", "cells", "seen", "level");
+  for (;;) {
+    loop();
+    uint32_t dtMs = millis() - lastMillis;
+    uint32_t shows = nativeShowCount() - lastShows;
+    lastMillis += dtMs;
+    lastShows += shows;
+    if (!dtMs) continue;
+
+    double active = std::min(1.0, shows * showUs / (dtMs * 1000.0));
+    double ma = powerStats().lastMa + (active * POWER_MCU_ACTIVE_UA + (1 - active) * POWER_MCU_IDLE_UA) / 1000.0;
+    usedMah += ma * dtMs * DISCHARGE_SPEEDUP / 3600000.0;
+    double used = usedMah / capacityMah;
+    double mv = BATTERY_CELLS * (cellOcv(used) - ma / 1000.0 * cellOhms(used)) * 1000;
+    if (tracking) nativeSetSupplyMv(std::max(mv, 1.0));
+    ms += dtMs * DISCHARGE_SPEEDUP;
+    levelMs[batteryLevel()] += dtMs * DISCHARGE_SPEEDUP;
+
+    bool out = mv < BROWNOUT_MV || used >= 1;
+    if (ms >= reportMs || out) {
+      printf("%6.2f %5.0f mAh %7.1f %4.0f mV %4u mV %-8s\n", ms / 3600000, usedMah, ma, mv, batteryMillivolts(),
+             levels[batteryLevel()]);
+      reportMs += 3600000 / 2;
+    }
+    if (out) break;
+  }
+  printf("ran %.2f hours:", ms / 3600000);
+  for (int l = 0; l < BATTERY_LEVEL_COUNT; l++) printf(" %s %.2f h", levels[l], levelMs[l] / 3600000);
+  printf("\n\n");
+  return ms / 3600000;
+}
+
+static void runBattery(int outer, int inner, uint32_t capacityMah) {
+  printf("%u mAh x %d alkaline AAA cells, brown-out at %u mV\n\n", capacityMah, BATTERY_CELLS, BROWNOUT_MV);
+  double before = runDischarge(outer, inner, capacityMah, false);
+  double after = runDischarge(outer, inner, capacityMah, true);
+  printf("runtime %.2f -> %.2f hours (%+.0f%%)\n", before, after, (after / before - 1) * 100);
+}
+
+// PCM samples mixed to mono, as -32768..32767
+static bool loadWav(const char* path, std::vector<int16_t>& mono, uint32_t& rate) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+
+  auto u16 = [&](size_t at) { return (uint32_t)data[at] | (data[at + 1] << 8); };
+  auto u32 = [&](size_t at) { return u16(at) | (u16(at + 2) << 16); };
+  if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) || memcmp(&data[8], "WAVE", 4)) return false;
+
+  uint32_t channels = 0, bits = 0;
+  for (size_t at = 12; at + 8 <= data.size();) {
+    uint32_t size = u32(at + 4);
+    size_t body = at + 8;
+    if (!memcmp(&data[at], "fmt ", 4) && size >= 16 && u16(body) == 1) {
+      channels = u16(body + 2);
+      rate = u32(body + 4);
+      bits = u16(body + 14);
+    } else if (!memcmp(&data[at], "data", 4) && channels && (bits == 8 || bits == 16)) {
+      size_t bytes = bits / 8, frame = bytes * channels;
+      size_t end = std::min(data.size(), body + size);
+      for (size_t i = body; i + frame <= end; i += frame) {
+        int32_t sum = 0;
+        for (uint32_t c = 0; c < channels; c++) {
+          size_t s = i + c * bytes;
+          sum += bits == 8 ? (data[s] - 128) << 8 : (int16_t)u16(s);
+        }
+        mono.push_back(sum / (int32_t)channels);
+      }
+      return !mono.empty();
+    }
+    at = body + size + (size & 1);
+  }
+  return false;
+}
+
+static void runWav(const char* path, double refBpm, uint32_t periodUs) {
+  std::vector<int16_t> pcm;
+  uint32_t rate = 0;
+  if (!loadWav(path, pcm, rate)) {
+    fprintf(stderr, "cannot read %s (PCM WAV, 8 or 16 bit)\n", path);
+    return;
+  }
+
+  // Box-filter down to the engine's rate, then to ADC counts around mid-rail
+  std::vector<uint16_t> adc;
+  double step = (double)rate / BEAT_SAMPLE_HZ;
+  for (double at = 0; at + step <= pcm.size(); at += step) {
+    int32_t sum = 0, count = 0;
+    for (size_t i = (size_t)at; i < (size_t)(at + step); i++, count++) sum += pcm[i];
+    int32_t level = 512 + (count ? sum / count : 0) / 64;
+    adc.push_back(std::max(0, std::min(1023, level)));
+  }
+  printf("%s: %u Hz, %.1f s, %zu samples at %u Hz\n", path, rate, (double)pcm.size() / rate, adc.size(), BEAT_SAMPLE_HZ);
+  printf("%5s %4s %5s %6s %6s %5s %6s %5s\n", "t_s", "bpm", "conf", "locked", "beats", "build", "kicks", "drops");
+
+  beatReset();
+  const uint32_t startUs = nativeMicros();
+  const uint32_t sampleUs = 1000000UL / BEAT_SAMPLE_HZ;
+  uint64_t sampleNs = 0, updateNs = 0;
+  uint32_t updates = 0, lockedAtMs = 0, kicks = 0, drops = 0;
+  uint32_t lastBeats = 0, lastKickMs = 0xFFFF, lastDropMs = 0xFFFF;
+  double bpmError = 0, phaseBias = 0, phaseError = 0, phaseWorst = 0;
+  uint32_t bpmSamples = 0, scoredBeats = 0;
+  size_t next = 0;
+  uint32_t nextReportMs = 1000;
+
+  while (next < adc.size()) {
+    uint32_t frameEnd = nativeMicros() + periodUs;
+    auto t0 = std::chrono::steady_clock::now();
+    for (; next < adc.size() && (int32_t)(nativeMicros() - frameEnd) < 0; next++) {
+      beatSample(adc[next]);
+      nativeAdvanceMicros(sampleUs);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    beatUpdate();
+    auto t2 = std::chrono::steady_clock::now();
+    sampleNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    updateNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+    updates++;
+
+    const BeatInfo& info = beatInfo();
+    uint32_t nowMs = (nativeMicros() - startUs) / 1000;
+    if (info.kickMs < lastKickMs) kicks++;
+    if (info.dropMs < lastDropMs) drops++;
+    lastKickMs = info.kickMs;
+    lastDropMs = info.dropMs;
+
+    if (beatLocked()) {
+      if (!lockedAtMs) lockedAtMs = nowMs;
+      if (refBpm > 0) {
+        bpmError += fabs(info.bpm - refBpm);
+        bpmSamples++;
+        if (info.beats != lastBeats) {
+          double beatMs = nowMs - info.sinceBeatMs;
+          double gridMs = 60000.0 / refBpm;
+          double offset = fmod(beatMs, gridMs);
+          if (offset > gridMs / 2) offset -= gridMs;
+          phaseBias += offset;
+          phaseError += fabs(offset);
+          phaseWorst = std::max(phaseWorst, fabs(offset));
+          scoredBeats++;
+        }
+      }
+    }
+    lastBeats = info.beats;
+
+    if (nowMs >= nextReportMs) {
+      printf("%5u %4u %5u %6s %6u %5u %6u %5u\n", nowMs / 1000, info.bpm, info.confidence, beatLocked() ? "yes" : "no",
+             info.beats, info.build, kicks, drops);
+      nextReportMs += 1000;
+    }
+  }
+
+  printf("first lock at %.2f s; %u kicks, %u drops\n", lockedAtMs / 1000.0, kicks, drops);
+  if (refBpm > 0 && bpmSamples) {
+    printf("vs %.1f BPM: tempo off by %.2f BPM on average while locked\n", refBpm, bpmError / bpmSamples);
+    if (scoredBeats) {
+      printf("%u beats scored: %+.1f ms from the grid on average, %.1f ms mean absolute, %.1f ms at worst\n",
+             scoredBeats, phaseBias / scoredBeats, phaseError / scoredBeats, phaseWorst);
+    }
+  }
+  printf("desktop cost: %.1f ns per sample, %.1f ns per beatUpdate()\n", (double)sampleNs / adc.size(),
+         (double)updateNs / updates);
+}
+
+static void schedulePress(const char* spec, uint32_t bounces) {
+  unsigned pin = 0, atMs = 0, holdMs = 150;
+  sscanf(spec, "%u@%u:%u", &pin, &atMs, &holdMs);
+  scheduleEdge(atMs * 1000UL, pin, LOW, bounces);
+  scheduleEdge((atMs + holdMs) * 1000UL, pin, HIGH, bounces);
+}
+
+static bool validPress(const char* spec) {
+  unsigned pin, atMs, holdMs;
+  return sscanf(spec, "%u@%u:%u", &pin, &atMs, &holdMs) >= 2;
+}
+
+static void runLoop(uint32_t frames, const char* dumpDir) {
+  if (dumpDir) nativeSetShowHook(captureFrame);
+  uint64_t totalNs = 0;
+  for (uint32_t f = 0; f < frames; f++) {
+    totalNs += timeCall(loop);
+  }
+  nativeSetShowHook(nullptr);
+  const PowerStats& power = powerStats();
+  printf("loop(): %u frames, %llu ns/frame, %u show() calls, %.1f virtual fps\n",
+         frames, (unsigned long long)(totalNs / frames), nativeShowCount(), frames * 1000.0 / millis());
+  printf("power: peak %u mA before limiting, avg %u mA, %u frames limited to %u mA\n", power.peakMa,
+         power.frames ? (unsigned)(power.totalMa / power.frames) : 0, power.limitedFrames, POWER_BUDGET_MA);
+  if (dumpDir) writePpm(std::string(dumpDir) + "/loop.ppm", nativeLedCount());
+}
+
+#ifdef LUMA_TELEMETRY
+
+static std::vector<uint8_t> serialLog;
+
+static void captureSerial(uint8_t byte) {
+  serialLog.push_back(byte);
+}
+
+static void runTelemetry(uint32_t frames, const char* path) {
+  uint64_t totalNs = 0;
+  for (uint32_t f = 0; f < frames; f++) totalNs += timeCall(loop);
+  printf("loop(): %u frames, %llu ns/frame, %u recorded\n", frames, (unsigned long long)(totalNs / frames),
+         telemetryReport().frames);
+
+  nativeSetSerialHook(captureSerial);
+  nativeSerialInput(TELEMETRY_REQUEST);
+  uint32_t sent = 0;
+  // Sync and length first, then the report and its CRC
+  while (sent < 100 && (serialLog.size() < 3 || serialLog.size() < 5u + (serialLog[1] | serialLog[2] << 8))) {
+    loop();
+    sent++;
+  }
+  nativeSetSerialHook(nullptr);
+
+  FILE* f = fopen(path, "wb");
+  if (!f || fwrite(serialLog.data(), 1, serialLog.size(), f) != serialLog.size()) {
+    perror(path);
+    return;
+  }
+  fclose(f);
+  printf("report: %zu bytes over %u frames, written to %s\n", serialLog.size(), sent, path);
+}
+
+#endif
+
+#ifdef LUMA_STREAM
+
+static void runStream(uint32_t frames) {
+  int port = posix_openpt(O_RDWR | O_NOCTTY);
+  if (port < 0 || grantpt(port) || unlockpt(port)) {
+    perror("cannot open a pseudo-terminal");
+    return;
+  }
+  const char* name = ptsname(port);
+  // Held open so the port survives the host reconnecting, and raw so the
+  // pty does not echo the credits back as if they were frame bytes
+  int peer = open(name, O_RDWR | O_NOCTTY);
+  termios raw;
+  tcgetattr(peer, &raw);
+  cfmakeraw(&raw);
+  tcsetattr(peer, TCSANOW, &raw);
+
+  printf("streaming on %s for %.1f s: tools/stream_frames.py %s\n", name, frames / 129.0, name);
+  fflush(stdout);
+  nativeRealTime(port, streamReceive);
+
+  const uint32_t startMs = millis();
+  bool was = false;
+  for (uint32_t f = 0; f < frames; f++) {
+    loop();
+    bool now = streamActive();
+    if (now != was) {
+      printf("%7.2f s  %s\n", (millis() - startMs) / 1000.0, now ? "stream started" : "stream stopped, patterns back");
+      fflush(stdout);
+    }
+    was = now;
+  }
+
+  const StreamStats& stats = streamStats();
+  printf("%u frames received, %u shown, %u bad CRC, %u line errors, %u lost, %u overwritten\n", stats.frames,
+         stats.shown, stats.crcErrors, stats.lineErrors, stats.lost, stats.overwritten);
+  if (stats.shown) {
+    printf("received to shown: %.2f ms average, %.2f ms at worst\n", stats.latencySumUs / 1000.0 / stats.shown,
+           stats.latencyMaxUs / 1000.0);
+  }
+  printf("%u frames overran their slot\n", schedulerStats().overruns);
+  close(peer);
+  close(port);
+}
+
+#endif
+
+// Calls job(0) .. job(count - 1) on threads workers, each taking the next index as it comes free
+template <typename Job>
+static void parallelFor(uint32_t threads, uint32_t count, Job job) {
+  std::atomic<uint32_t> next(0);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; t++) {
+    workers.emplace_back([&] {
+      for (uint32_t i; (i = next++) < count;) job(i);
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+}
+
+// What sets one pendant of the crowd apart; drawn from its number, so a run is the same on any threads
+struct FleetPendant {
+  uint8_t pair;       // outer and inner entry, 0 being the auto-cycle
+  uint8_t brightness; // one of the three lit tiers
+  uint32_t bootUs;    // switched on this far into the show, which sets its phase
+  uint16_t seed;      // rand16seed, so no two sparkle alike
+};
+
+struct FleetResult {
+  uint64_t hash = 0;           // FNV-1a over every frame, to hold the runs against each other
+  std::vector<uint8_t> frames; // frame by frame, LED by LED, RGB; only kept for --dump
+};
+
+static FleetPendant fleetPendant(uint32_t number) {
+  std::minstd_rand rng(number + 1);
+  FleetPendant p;
+  p.pair = rng() % OUTER_PATTERN_COUNT;
+  p.brightness = rng() % 3;
+  p.bootUs = rng() % 2000000;
+  p.seed = rng();
+  return p;
+}
+
+// Boots a pendant and runs it; the thread must be new, as its thread_local state is the pendant's RAM
+static void runFleetPendant(const FleetPendant& p, uint32_t frames, bool keep, FleetResult& result) {
+  nativeSetMicros(p.bootUs);
+  rand16seed = p.seed;
+  // The legacy bytes, which a first boot takes its settings from
+  EEPROM.write(0, p.pair);
+  EEPROM.write(1, p.pair);
+  EEPROM.write(2, p.brightness);
+  setup();
+
+  const CRGB* out = nativeLeds();
+  int count = nativeLedCount();
+  uint64_t hash = 14695981039346656037ULL;
+  if (keep) result.frames.reserve((size_t)frames * count * 3);
+  for (uint32_t f = 0; f < frames; f++) {
+    loop();
+    for (int i = 0; i < count; i++) {
+      for (uint8_t c : {out[i].r, out[i].g, out[i].b}) {
+        hash = (hash ^ c) * 1099511628211ULL;
+        if (keep) result.frames.push_back(c);
+      }
+    }
+  }
+  result.hash = hash;
+}
+
+// One pendant to a tile, face on, with LED 0 (+x in geometry.h) at the top and the ring running anticlockwise
+static void writeFleetFrames(const char* dir, const std::vector<FleetResult>& results, uint32_t frames, uint32_t tile,
+                             uint32_t threads) {
+  const uint32_t count = GEOMETRY_LED_COUNT;
+  const uint32_t cols = ceil(sqrt(results.size()));
+  const uint32_t rows = (results.size() + cols - 1) / cols;
+  const uint32_t width = cols * tile, height = rows * tile;
+  const uint32_t dot = std::max<uint32_t>(1, tile / 8);
+  const uint32_t span = tile - dot - 2; // a pixel of black between neighbours
+  uint32_t ledCol[count], ledRow[count];
+  for (uint32_t led = 0; led < count; led++) {
+    ledCol[led] = 1 + (255 - ledY(led)) * span / 255;
+    ledRow[led] = 1 + (255 - ledX(led)) * span / 255;
+  }
+
+  parallelFor(threads, frames, [&](uint32_t f) {
+    std::vector<uint8_t> image((size_t)width * height * 3);
+    for (uint32_t p = 0; p < results.size(); p++) {
+      const uint8_t* leds = &results[p].frames[(size_t)f * count * 3];
+      for (uint32_t led = 0; led < count; led++) {
+        uint32_t x0 = p % cols * tile + ledCol[led], y0 = p / cols * tile + ledRow[led];
+        for (uint32_t y = y0; y < y0 + dot; y++) {
+          uint8_t* pixel = &image[((size_t)y * width + x0) * 3];
+          // Where the inner LEDs come close to the ring, the brighter of the two shows
+          for (uint32_t i = 0; i < dot * 3; i++) pixel[i] = std::max(pixel[i], leds[led * 3 + i % 3]);
+        }
+      }
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/fleet_%05u.ppm", dir, f);
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+      fprintf(stderr, "cannot write %s\n", path);
+      return;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    fwrite(image.data(), 1, image.size(), file);
+    fclose(file);
+  });
+  printf("%u frames of %ux%u written to %s/fleet_NNNNN.ppm\n", frames, width, height, dir);
+}
+
+static void runFleet(uint32_t pendants, uint32_t frames, const std::vector<uint32_t>& threadCounts, const char* dumpDir,
+                     uint32_t tile) {
+  std::vector<FleetPendant> fleet;
+  for (uint32_t i = 0; i < pendants; i++) fleet.push_back(fleetPendant(i));
+  printf("fleet of %u pendants, %u frames each (%.1f s at 129 fps): pairs 0-%u, three brightness tiers, 2 s of boot phase\n",
+         pendants, frames, frames / 129.0, OUTER_PATTERN_COUNT - 1);
+  printf("%7s %8s %16s %7s %s\n", "threads", "seconds", "pendant-frames/s", "speedup", "same frames");
+
+  std::vector<uint64_t> firstHashes;
+  double firstRate = 0;
+  std::vector<FleetResult> results;
+  for (size_t run = 0; run < threadCounts.size(); run++) {
+    bool keep = dumpDir && run + 1 == threadCounts.size();
+    results.assign(pendants, FleetResult());
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(threadCounts[run], pendants, [&](uint32_t i) {
+      // A thread of its own: one the last pendant ran on would still hold that pendant's state
+      std::thread(runFleetPendant, std::cref(fleet[i]), frames, keep, std::ref(results[i])).join();
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double rate = (double)pendants * frames / seconds;
+
+    std::string same = "-";
+    if (run == 0) {
+      firstRate = rate;
+      for (const FleetResult& result : results) firstHashes.push_back(result.hash);
+    } else {
+      uint32_t differ = 0;
+      for (uint32_t i = 0; i < pendants; i++) differ += results[i].hash != firstHashes[i];
+      same = differ ? "NO: " + std::to_string(differ) + " pendants differ" : "yes";
+    }
+    printf("%7u %8.2f %16.0f %6.2fx %s\n", threadCounts[run], seconds, rate, rate / firstRate, same.c_str());
+  }
+  if (dumpDir) writeFleetFrames(dumpDir, results, frames, tile, threadCounts.back());
+}
+
+static bool parseThreads(const char* list, std::vector<uint32_t>& counts) {
+  counts.clear();
+  for (const char* at = list; *at;) {
+    char* end;
+    unsigned long n = strtoul(at, &end, 10);
+    if (end == at || n == 0 || (*end && *end != ',')) return false;
+    counts.push_back(n);
+    at = *end ? end + 1 : end;
+  }
+  return !counts.empty();
+}
+
+static void usage(const char* prog) {
+  fprintf(stderr, "usage: %s [--frames N] [--fps F] [--outer I] [--inner J] [--dump DIR] [--loop] [--press PIN@MS[:HOLDMS]]... [--bounce N]\n"
+                  "       %*s [--energy [--bench FILE] [--capacity MAH]] [--transitions] [--power-cycles N]\n"
+                  "       %*s [--wav FILE [--bpm REF]] [--stream] [--vm] [--program FILE] [--battery] [--telemetry FILE]\n"
+                  "       %*s [--fleet N [--threads T,...] [--tile PX]]\n", prog, (int)strlen(prog), "", (int)strlen(prog), "",
+          (int)strlen(prog), "");
+}
+
+int main(int argc, char** argv) {
+  uint32_t frames = 1290; // 10 s at 129 fps
+  uint32_t fps = 129;
+  int outer = -1;
+  int inner = -1;
+  const char* dumpDir = nullptr;
+  bool useLoop = false;
+  bool energy = false;
+  bool transitions = false;
+  bool vm = false;
+  bool battery = false;
+  uint32_t powerCycles = 0;
+  const char* wavPath = nullptr;
+  double refBpm = 0;
+  uint32_t capacityMah = 1000; // typical alkaline AAA
+  std::vector<const char*> pressSpecs;
+  uint32_t bounces = 0;
+  uint32_t fleet = 0;
+  uint32_t tile = 16;
+  std::vector<uint32_t> threadCounts = {1};
+  if (std::thread::hardware_concurrency() > 1) threadCounts.push_back(std::thread::hardware_concurrency());
+#ifdef LUMA_STREAM
+  bool stream = false;
+#endif
+#ifdef LUMA_TELEMETRY
+  const char* telemetryPath = nullptr;
+#endif
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--frames" && hasValue) frames = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--fps" && hasValue) fps = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--outer" && hasValue) outer = atoi(argv[++i]);
+    else if (arg == "--inner" && hasValue) inner = atoi(argv[++i]);
+    else if (arg == "--dump" && hasValue) dumpDir = argv[++i];
+    else if (arg == "--loop") useLoop = true;
+    else if (arg == "--press" && hasValue && validPress(argv[i + 1])) pressSpecs.push_back(argv[++i]);
+    else if (arg == "--bounce" && hasValue) bounces = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--energy") energy = true;
+    else if (arg == "--transitions") transitions = true;
+    else if (arg == "--vm") vm = true;
+    else if (arg == "--battery") battery = true;
+    else if (arg == "--program" && hasValue && loadProgram(argv[i + 1])) i++;
+    else if (arg == "--wav" && hasValue) wavPath = argv[++i];
+    else if (arg == "--bpm" && hasValue) refBpm = atof(argv[++i]);
+    else if (arg == "--power-cycles" && hasValue) powerCycles = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--bench" && hasValue && loadBench(argv[i + 1])) i++;
+    else if (arg == "--capacity" && hasValue) capacityMah = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--fleet" && hasValue) fleet = strtoul(argv[++i], nullptr, 0);
+    else if (arg == "--threads" && hasValue && parseThreads(argv[i + 1], threadCounts)) i++;
+    else if (arg == "--tile" && hasValue) tile = strtoul(argv[++i], nullptr, 0);
+#ifdef LUMA_STREAM
+    else if (arg == "--stream") stream = true;
+#endif
+#ifdef LUMA_TELEMETRY
+    else if (arg == "--telemetry" && hasValue) telemetryPath = argv[++i];
+#endif
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (frames == 0 || fps == 0 || capacityMah == 0 || outer >= OUTER_PATTERN_COUNT || inner >= INNER_PATTERN_COUNT ||
+      tile < 4) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (fleet) {
+    runFleet(fleet, frames, threadCounts, dumpDir, tile);
+    return 0;
+  }
+
+  setup();
+
+  if (useLoop) {
+    for (const char* spec : pressSpecs) schedulePress(spec, bounces);
+    runLoop(frames, dumpDir);
+    return 0;
+  }
+
+#ifdef LUMA_STREAM
+  if (stream) {
+    runStream(frames);
+    return 0;
+  }
+#endif
+
+#ifdef LUMA_TELEMETRY
+  if (telemetryPath) {
+    for (const char* spec : pressSpecs) schedulePress(spec, bounces);
+    runTelemetry(frames, telemetryPath);
+    return 0;
+  }
+#endif
+
+  if (vm) {
+    return runVm(frames, 1000000UL / fps) ? 0 : 1;
+  }
+
+  if (transitions) {
+    runTransitions(1000000UL / fps);
+    return 0;
+  }
+
+  if (wavPath) {
+    runWav(wavPath, refBpm, 1000000UL / fps);
+    return 0;
+  }
+
+  if (battery) {
+    runBattery(outer >= 0 ? outer : 0, inner >= 0 ? inner : (outer >= 0 ? outer : 0), capacityMah);
+    return 0;
+  }
+
+  if (powerCycles) {
+    runPowerCycles(powerCycles);
+    return 0;
+  }
+
+  if (energy) {
+    printf("%u frames per pattern at %u fps, %lu mV supply, %u mAh%s\n", frames, fps, POWER_SUPPLY_MV, capacityMah,
+           benchCycles.empty() ? ", render time not counted (no --bench)" : "");
+    printf("%2s %-32s %7s %7s %6s %8s %7s\n", "#", "outer", "led_mA", "mcu_mA", "active", "mWh/h", "hours");
+    int first = outer >= 0 ? outer : 0;
+    int last = outer >= 0 ? outer : OUTER_PATTERN_COUNT - 1;
+    for (int i = first; i <= last; i++) {
+      int j = inner >= 0 ? inner : (i < INNER_PATTERN_COUNT ? i : 0);
+      runEnergy(i, j, frames, fps, capacityMah);
+    }
+    double offMa = (nativeLedCount() * POWER_LED_IDLE_UA + POWER_MCU_OFF_UA) / 1000.0;
+    printf("off state: %.2f mA, %.0f hours\n", offMa, capacityMah / offMa);
+    return 0;
+  }
+
+  uint32_t periodUs = 1000000UL / fps;
+  printf("%u frames per pattern at %u fps, mean/max render ns per frame, peak/avg estimated mA (budget %u)\n",
+         frames, fps, POWER_BUDGET_MA);
+  printf("%2s %-32s %8s %8s | %2s %-32s %8s %8s | %5s %5s\n", "#", "outer", "mean", "max", "#", "inner", "mean", "max",
+         "peak", "avg");
+
+  if (outer >= 0 || inner >= 0) {
+    runPair(outer >= 0 ? outer : inner, inner >= 0 ? inner : outer, frames, periodUs, dumpDir);
+    return 0;
+  }
+  for (int i = 0; i < OUTER_PATTERN_COUNT; i++) {
+    runPair(i, i < INNER_PATTERN_COUNT ? i : 0, frames, periodUs, dumpDir);
+  }
+  return 0;
+}
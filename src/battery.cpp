@@ -0,0 +1,124 @@
+#include "battery.h"
+#include "geometry.h"
+#include "state.h"
+
+#define BATTERY_ACC_SAMPLES 16
+#define BATTERY_ACC_FULL    (1023UL * BATTERY_ACC_SAMPLES) // the result if INTREF were at VDD
+static_assert(INNER_BACK_FIRST == INNER_FRONT_FIRST + INNER_FRONT_LEN, "the blink fills the inner LEDs as one run");
+
+// Down-thresholds per level; coming back up takes BATTERY_HYSTERESIS_MV more
+static const uint16_t thresholds[BATTERY_LEVEL_COUNT] = {0xFFFF, BATTERY_DIM_MV, BATTERY_LOW_MV, BATTERY_CRITICAL_MV};
+
+static PENDANT_STATE uint32_t filteredQ4;  // mV, Q4
+static PENDANT_STATE uint32_t lastSampleMs;
+static PENDANT_STATE bool converting;
+static PENDANT_STATE BatteryLevel level;
+
+#ifdef LUMA_NATIVE
+
+#include <NativeHost.h>
+
+// What ADC1 would read: the harness sets the supply (nativeSetSupplyMv())
+static void startConversion() {}
+
+static bool readConversion(uint16_t& result) {
+  result = (BATTERY_ACC_FULL * BATTERY_VREF_MV + nativeSupplyMv() / 2) / nativeSupplyMv();
+  return true;
+}
+
+static void adcBegin() {}
+static void adcStop() {}
+
+#else
+
+static void adcBegin() {
+  VREF.CTRLC = (VREF.CTRLC & ~VREF_ADC1REFSEL_gm) | VREF_ADC1REFSEL_1V5_gc;
+  ADC1.CTRLB = ADC_SAMPNUM_ACC16_gc;
+  ADC1.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_VDDREF_gc | ADC_PRESC_DIV16_gc; // 1 MHz
+  ADC1.CTRLD = ADC_INITDLY_DLY32_gc; // the reference settles while the ADC starts
+  ADC1.MUXPOS = ADC_MUXPOS_INTREF_gc;
+}
+
+// The ADC is only enabled from the start of a burst to its result
+static void startConversion() {
+  ADC1.CTRLA = ADC_ENABLE_bm; // 10 bits
+  ADC1.COMMAND = ADC_STCONV_bm;
+}
+
+static bool readConversion(uint16_t& result) {
+  if (!(ADC1.INTFLAGS & ADC_RESRDY_bm)) return false;
+  result = ADC1.RES; // clears RESRDY
+  ADC1.CTRLA = 0;
+  return true;
+}
+
+static void adcStop() {
+  ADC1.CTRLA = 0;
+  ADC1.INTFLAGS = ADC_RESRDY_bm;
+}
+
+#endif
+
+void batteryBegin() {
+  adcBegin();
+  filteredQ4 = 0;
+  converting = false;
+  level = BATTERY_OK;
+  lastSampleMs = 0;
+}
+
+void batteryEnd() {
+  adcStop();
+  converting = false;
+}
+
+static BatteryLevel classify(uint16_t mv) {
+  BatteryLevel next = level;
+  while (next + 1 < BATTERY_LEVEL_COUNT && mv < thresholds[next + 1]) next = BatteryLevel(next + 1);
+  while (next > BATTERY_OK && mv >= thresholds[next] + BATTERY_HYSTERESIS_MV) next = BatteryLevel(next - 1);
+  return next;
+}
+
+bool batteryUpdate(uint32_t nowMs) {
+  if (!converting) {
+    if (filteredQ4 && nowMs - lastSampleMs < BATTERY_SAMPLE_MS) return false;
+    lastSampleMs = nowMs;
+    startConversion();
+    converting = true;
+    return false;
+  }
+
+  uint16_t result;
+  if (!readConversion(result)) return false;
+  converting = false;
+  if (result == 0) return false;
+  uint32_t mvQ4 = (BATTERY_ACC_FULL * BATTERY_VREF_MV << 4) / result;
+  if (filteredQ4) {
+    filteredQ4 = filteredQ4 + ((int32_t)(mvQ4 - filteredQ4) >> BATTERY_FILTER_SHIFT);
+  } else {
+    filteredQ4 = mvQ4; // the first reading primes the filter
+  }
+
+  BatteryLevel next = classify(batteryMillivolts());
+  if (next == level) return false;
+  level = next;
+  return true;
+}
+
+BatteryLevel batteryLevel() {
+  return level;
+}
+
+uint16_t batteryMillivolts() {
+  return filteredQ4 >> 4;
+}
+
+void batteryIndicate(CRGB* leds, uint32_t nowMs) {
+  if (level < BATTERY_LOW) return;
+  // One blink at the start of each period, and a second one just after it when critical
+  uint16_t at = nowMs % BATTERY_BLINK_MS;
+  bool on = at < BATTERY_BLINK_ON_MS ||
+            (level == BATTERY_CRITICAL && at >= 2 * BATTERY_BLINK_ON_MS && at < 3 * BATTERY_BLINK_ON_MS);
+  if (!on) return;
+  fill_solid(leds + INNER_FRONT_FIRST, INNER_FRONT_LEN + INNER_BACK_LEN, CRGB(BATTERY_BLINK_BRIGHTNESS, 0, 0));
+}
@@ -0,0 +1,59 @@
+/*
+
+ Battery monitor: the supply voltage, and brightness that backs off as the cells run down.
+
+ The ATtiny1616 measures its own VDD with no extra parts: ADC1 converts the
+ internal 1.5 V reference against VDD, so the result falls as VDD rises
+ (VDD = 1.5 V x 1023 / result).  ADC1 because ADC0 belongs to the beat engine
+ on a LUMA_AUDIO build.  Once every BATTERY_SAMPLE_MS one frame starts a burst
+ of 16 accumulated conversions and the next frame reads it, so the ADC and
+ the reference are only powered for those few hundred microseconds; the
+ readings go through a fixed-point exponential filter, so a single flash that
+ pulls the cells down does not count.
+
+ The filtered voltage, measured with the LEDs drawing, sets a BatteryLevel.
+ main.cpp caps the brightness tier for each level (BATTERY_TIER_CAP), so the
+ BRIGHTNESS_LEVELS_* step down towards "Low" as the cells sag, and from
+ BATTERY_LOW the inner LEDs blink red every few seconds over whatever is
+ showing (batteryIndicate(), on the output buffer).  A level only comes back
+ once the voltage is BATTERY_HYSTERESIS_MV above where it dropped, since the
+ cells recover a little as soon as the load goes down.  The brightness the
+ wearer chose is kept in the settings: fresh cells bring it back.
+
+ The thresholds are for three alkaline AAA cells in series.  The 1.5 V
+ reference is only good to a few percent; BATTERY_VREF_MV calibrates it.
+ The native harness replays a discharge through all of this (--battery).
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#define BATTERY_SAMPLE_MS      1000
+#define BATTERY_FILTER_SHIFT   3     // each sample moves the estimate 1/8 of the way: ~8 s to settle
+#ifndef BATTERY_VREF_MV
+#define BATTERY_VREF_MV        1500  // INTREF as selected; measure a part to calibrate
+#endif
+#define BATTERY_DIM_MV         3600  // 1.2 V a cell: past the knee of the curve
+#define BATTERY_LOW_MV         3300  // 1.1 V
+#define BATTERY_CRITICAL_MV    3000  // 1.0 V: little charge left, the LEDs start to fade out
+#define BATTERY_HYSTERESIS_MV  150
+#define BATTERY_BLINK_MS       5000  // period of the low-battery blink
+#define BATTERY_BLINK_ON_MS    120
+#define BATTERY_BLINK_BRIGHTNESS 48
+
+enum BatteryLevel : uint8_t {
+  BATTERY_OK,
+  BATTERY_DIM,       // brightness capped a tier down
+  BATTERY_LOW,       // capped to the lowest tier, and a blink every BATTERY_BLINK_MS
+  BATTERY_CRITICAL,  // the same, two blinks
+  BATTERY_LEVEL_COUNT
+};
+
+void batteryBegin();
+bool batteryUpdate(uint32_t nowMs);   // once a frame; true when the level changed
+void batteryEnd();                    // before sleeping: stops a burst that is still running
+BatteryLevel batteryLevel();
+uint16_t batteryMillivolts();         // filtered; 0 until the first reading
+void batteryIndicate(CRGB* leds, uint32_t nowMs); // after compositorRun(), on the buffer that is shown
@@ -0,0 +1,301 @@
+#include "beat.h"
+#include "state.h"
+#include "timebase.h"
+
+#include <FastLED.h>
+
+// Beat lengths in timebase ticks
+#define BEAT_MIN_PERIOD  (TIMEBASE_HZ * 60 / BEAT_MAX_BPM)
+#define BEAT_MAX_PERIOD  (TIMEBASE_HZ * 60 / BEAT_MIN_BPM)
+#define BEAT_BIN_WIDTH   ((BEAT_MAX_PERIOD - BEAT_MIN_PERIOD) / BEAT_TEMPO_BINS + 1)
+
+#define BEAT_ONSET_FLOOR      48                      // block energy (ADC counts, Q4) below which nothing is an onset
+#define BEAT_KICK_HOLDOFF     (TIMEBASE_HZ / 10)      // 100 ms between kicks at most
+#define BEAT_SNARE_HOLDOFF    (TIMEBASE_HZ / 16)      // 62 ms between snare hits
+#define BEAT_DROP_BUILD       128                     // build level a kick has to end to count as a drop
+#define BEAT_ONSET_LATENCY    (TIMEBASE_HZ * 5 / 1000)  // from a kick starting to its block crossing the threshold
+
+struct BeatBlock {
+  uint16_t low;   // mean magnitude per band, ADC counts Q4
+  uint16_t high;
+  uint32_t tick;  // timebase when the block finished
+};
+
+// --- Sample side (interrupt context on the part) ---
+
+static PENDANT_STATE int32_t dc;         // input bias, ADC counts Q16
+static PENDANT_STATE bool primed;
+static PENDANT_STATE int16_t low1;       // one-pole low-pass states, Q4
+static PENDANT_STATE int16_t low;
+static PENDANT_STATE int16_t mid;
+static PENDANT_STATE uint32_t lowSum;
+static PENDANT_STATE uint32_t highSum;
+static PENDANT_STATE uint8_t blockCount;
+
+// Written only by beatSample() (head) and only by beatUpdate() (tail)
+static PENDANT_STATE volatile BeatBlock queue[BEAT_QUEUE_LEN];
+static PENDANT_STATE volatile uint8_t queueHead;
+static PENDANT_STATE volatile uint8_t queueTail;
+
+// --- Tracker side (beatUpdate()) ---
+
+struct Band {
+  uint32_t average;   // slow average of the block energy, Q4 on top of the energy's own Q4
+  uint32_t lastTick;  // last onset
+  bool above;         // over the onset threshold; re-arms below 1.25x the average
+  bool seen;
+};
+
+static PENDANT_STATE Band kick;
+static PENDANT_STATE Band snare;
+static PENDANT_STATE uint8_t bins[BEAT_TEMPO_BINS];
+static PENDANT_STATE uint32_t period;     // 0 until the first kick interval
+static PENDANT_STATE uint32_t reciprocal; // 2^30 / period, so the phase is a multiply rather than a division
+static PENDANT_STATE uint32_t nextBeat;
+static PENDANT_STATE uint8_t confidence;
+static PENDANT_STATE uint8_t build;
+static PENDANT_STATE uint8_t kicksThisBeat;
+static PENDANT_STATE uint8_t snaresThisBeat;
+static PENDANT_STATE uint32_t dropTick;
+static PENDANT_STATE bool dropped;
+static PENDANT_STATE BeatInfo info;
+
+void beatReset() {
+  noInterrupts();
+  primed = false;
+  low1 = low = mid = 0;
+  lowSum = highSum = 0;
+  blockCount = 0;
+  queueTail = queueHead;
+  interrupts();
+
+  memset(&kick, 0, sizeof(kick));
+  memset(&snare, 0, sizeof(snare));
+  memset(bins, 0, sizeof(bins));
+  period = reciprocal = 0;
+  confidence = build = 0;
+  kicksThisBeat = snaresThisBeat = 0;
+  dropped = false;
+  memset(&info, 0, sizeof(info));
+}
+
+void beatSample(uint16_t adc) {
+  if (!primed) {
+    dc = (int32_t)adc << 16;
+    primed = true;
+  }
+  dc += ((int32_t)adc << 8) - (dc >> 8); // ~10 Hz high-pass, so the mic bias never counts as signal
+  int16_t x = (int16_t)(adc << 4) - (int16_t)(dc >> 12);
+
+  low1 += (x - low1) >> 3; // two poles at ~80 Hz (at 4 kHz), so a snare's body stays out of the kick band
+  low += (low1 - low) >> 3;
+  mid += (x - mid) >> 1;  // ~640 Hz
+  int16_t high = x - mid;
+  lowSum += abs(low);
+  highSum += abs(high);
+  if (++blockCount < BEAT_BLOCK) return;
+
+  uint8_t head = queueHead;
+  if ((uint8_t)(head - queueTail) < BEAT_QUEUE_LEN) { // a full queue drops the block rather than stall
+    volatile BeatBlock& block = queue[head & (BEAT_QUEUE_LEN - 1)];
+    block.low = lowSum / BEAT_BLOCK;
+    block.high = highSum / BEAT_BLOCK;
+    block.tick = timebaseNow();
+    queueHead = head + 1;
+  }
+  blockCount = 0;
+  lowSum = highSum = 0;
+}
+
+// True when energy jumps to 1 + 2^-rise times its average; it re-arms at half
+// that rise.  A block that is not a candidate still moves the average and
+// the threshold but never counts as an onset.
+static bool onset(Band& band, uint16_t energy, uint32_t tick, uint32_t holdoff, uint8_t rise, bool candidate) {
+  uint32_t level = (uint32_t)energy << 4;
+  band.average += energy - (band.average >> 4);
+
+  if (level < band.average + (band.average >> (rise + 1))) band.above = false;
+  if (band.above || energy < BEAT_ONSET_FLOOR || level <= band.average + (band.average >> rise)) return false;
+  band.above = true;
+  if (!candidate) return false;
+  if (band.seen && tick - band.lastTick < holdoff) return false;
+  band.lastTick = tick;
+  band.seen = true;
+  return true;
+}
+
+// Folds a kick interval into the tempo range and votes with it in the
+// histogram.  Returns the folded interval (0 if it is no use) and, in peak,
+// the period at the histogram's peak.
+static uint32_t vote(uint32_t interval, uint32_t& peak) {
+  if (interval > 4 * BEAT_MAX_PERIOD) return 0; // a gap, not a beat
+  while (interval > BEAT_MAX_PERIOD) interval >>= 1;
+  while (interval < BEAT_MIN_PERIOD) interval <<= 1;
+  if (interval > BEAT_MAX_PERIOD) return 0; // faster than 16ths at the top tempo: not a beat either
+
+  uint8_t slot = (interval - BEAT_MIN_PERIOD) / BEAT_BIN_WIDTH;
+  for (uint8_t i = 0; i < BEAT_TEMPO_BINS; i++) bins[i] -= bins[i] >> 3;
+  bins[slot] = qadd8(bins[slot], 64);
+  if (slot > 0) bins[slot - 1] = qadd8(bins[slot - 1], 24);
+  if (slot < BEAT_TEMPO_BINS - 1) bins[slot + 1] = qadd8(bins[slot + 1], 24);
+
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < BEAT_TEMPO_BINS; i++) {
+    if (bins[i] > bins[best]) best = i;
+  }
+
+  // Centre of the peak and its neighbours, in half bins
+  uint16_t weight = 0;
+  uint32_t moment = 0;
+  for (uint8_t i = best > 0 ? best - 1 : 0; i <= best + 1 && i < BEAT_TEMPO_BINS; i++) {
+    weight += bins[i];
+    moment += bins[i] * (2 * i + 1);
+  }
+  peak = BEAT_MIN_PERIOD + moment * BEAT_BIN_WIDTH / (2 * weight);
+  return interval;
+}
+
+static uint16_t ticksToMs(uint32_t ticks) {
+  if (ticks >= 65535UL * TIMEBASE_HZ / 1000) return 65535;
+  return (ticks * 125) >> 12; // x 1000 / 32768
+}
+
+// The only place period changes, so its two divisions are paid per kick that moves it
+static void setPeriod(uint32_t ticks) {
+  period = ticks;
+  reciprocal = (1UL << 30) / period;
+  info.bpm = (TIMEBASE_HZ * 60 + period / 2) / period;
+  info.periodMs = ticksToMs(period);
+}
+
+static void onKick(uint32_t tick, uint32_t previous, bool hadPrevious) {
+  kicksThisBeat++;
+  if (build >= BEAT_DROP_BUILD) {
+    dropTick = tick;
+    dropped = true;
+    build = 0;
+  }
+
+  // The histogram picks the tempo; the intervals themselves, averaged, give
+  // the exact period (the bins and the 8 ms blocks are both too coarse alone)
+  uint32_t peak;
+  uint32_t interval = hadPrevious ? vote(tick - previous, peak) : 0;
+  if (interval) {
+    if (!period) {
+      setPeriod(peak);
+      nextBeat = tick + period;
+      return;
+    }
+    if (peak > period + period / 8 || peak < period - period / 8) {
+      setPeriod(peak); // the music changed tempo: start again from the histogram
+      confidence >>= 1;
+    } else if (interval < period + period / 8 && interval > period - period / 8) {
+      setPeriod(period + ((int32_t)interval - (int32_t)period) / 8);
+    }
+  }
+  if (!period) return;
+
+  // Distance to the nearest beat of the clock
+  int32_t error = (int32_t)(tick - (nextBeat - period));
+  if (error > (int32_t)period / 2) error -= period;
+  if ((uint32_t)abs(error) < period / 4) {
+    nextBeat += error / 4;
+    confidence = qadd8(confidence, 24);
+  } else {
+    confidence = qsub8(confidence, 12);
+  }
+}
+
+static void processBlock(const BeatBlock& block) {
+  uint32_t previousKick = kick.lastTick;
+  bool hadKick = kick.seen;
+  uint32_t tick = block.tick - BEAT_ONSET_LATENCY;
+  // A kick is a low-band onset the low band dominates; snare rolls leak some energy down there too
+  bool isKick = onset(kick, block.low, tick, BEAT_KICK_HOLDOFF, 1, block.low > block.high);
+  bool isSnare = onset(snare, block.high, tick, BEAT_SNARE_HOLDOFF, 2, true); // hats and noise keep the high band busy
+
+  if (isKick) onKick(tick, previousKick, hadKick);
+  if (isSnare && !isKick) snaresThisBeat++; // a kick's click shows in the high band too
+}
+
+// Judges each beat of the clock as it goes by
+static void advanceClock(uint32_t now) {
+  while (period && (int32_t)(now - nextBeat) >= 0) {
+    if (!kicksThisBeat) confidence = qsub8(confidence, 4); // breakdowns drain the lock slowly
+    // A roll too dense to split into hits still holds the build; only beats with a kick end it quickly
+    if (snaresThisBeat >= 2 && !kicksThisBeat) build = qadd8(build, 32);
+    else build -= build >> (kicksThisBeat ? 2 : 4);
+    kicksThisBeat = snaresThisBeat = 0;
+
+    nextBeat += period;
+    info.beats++;
+  }
+}
+
+void beatUpdate() {
+  while (queueTail != queueHead) {
+    uint8_t tail = queueTail;
+    volatile BeatBlock& slot = queue[tail & (BEAT_QUEUE_LEN - 1)];
+    BeatBlock block = {slot.low, slot.high, slot.tick};
+    queueTail = tail + 1;
+    processBlock(block);
+  }
+
+  uint32_t now = timebaseNow();
+  advanceClock(now);
+
+  info.confidence = confidence;
+  info.build = build;
+  info.kickMs = kick.seen ? ticksToMs(now - kick.lastTick) : 65535;
+  info.snareMs = snare.seen ? ticksToMs(now - snare.lastTick) : 65535;
+  info.dropMs = dropped ? ticksToMs(now - dropTick) : 65535;
+  if (!period) return;
+
+  int32_t since = (int32_t)(now - (nextBeat - period));
+  if (since < 0) since = 0; // the clock was just pulled later than now
+  info.phase = ((uint32_t)since * reciprocal) >> 22; // since << 8 / period; since < period < 2^15
+  info.barPhase = ((info.beats & 3) << 6) | (info.phase >> 2);
+  info.sinceBeatMs = ticksToMs(since);
+}
+
+const BeatInfo& beatInfo() {
+  return info;
+}
+
+bool beatLocked() {
+  return confidence >= BEAT_LOCK_CONFIDENCE;
+}
+
+#if defined(LUMA_AUDIO) && !defined(LUMA_NATIVE)
+
+// Reads the conversion started last time and starts the next, so the sample
+// rate is exactly the timer's.  Needs TCB0, i.e. no tone() with LUMA_AUDIO.
+ISR(TCB0_INT_vect) {
+  TCB0.INTFLAGS = TCB_CAPT_bm;
+  uint16_t sample = ADC0.RES;
+  ADC0.COMMAND = ADC_STCONV_bm;
+  beatSample(sample);
+}
+
+void beatBegin(uint8_t micPin) {
+  beatReset();
+  ADC0.CTRLA = ADC_ENABLE_bm; // 10 bits
+  ADC0.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_VDDREF_gc | ADC_PRESC_DIV16_gc; // 1 MHz, ~13 us a conversion
+  ADC0.MUXPOS = digitalPinToAnalogInput(micPin);
+  ADC0.COMMAND = ADC_STCONV_bm;
+
+  TCB0.CCMP = F_CPU / BEAT_SAMPLE_HZ - 1;
+  TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+  TCB0.INTFLAGS = TCB_CAPT_bm;
+  TCB0.INTCTRL = TCB_CAPT_bm;
+  TCB0.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_ENABLE_bm;
+}
+
+#else
+
+// Nothing to sample: the native harness feeds beatSample() itself
+void beatBegin(uint8_t) {
+  beatReset();
+}
+
+#endif
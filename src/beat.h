@@ -0,0 +1,70 @@
+/*
+
+ Beat engine: onsets, tempo and phase from a microphone.
+
+ Samples come in at BEAT_SAMPLE_HZ through beatSample(), from the TCB0
+ interrupt on a board built with LUMA_AUDIO (and MIC_PIN), or from the
+ native harness playing a WAV file (--wav).  Per sample, in the interrupt:
+ remove the DC bias, split the signal with two one-pole filters into a low
+ band (kick, below ~80 Hz) and a high band (snare and hats, above ~640 Hz),
+ and sum each band's magnitude over a BEAT_BLOCK-sample block.  That is a
+ handful of 16-bit adds and shifts per sample.  Each finished block is
+ stamped with the RTC timebase, so samples lost while FastLED.show() has
+ interrupts off cost a little energy but never skew the tempo.
+
+ beatUpdate(), once per frame, does the rest on the queued blocks:
+
+   onsets   a band's energy crossing 1.5x its own slow average
+   tempo    intervals between kicks, folded into BEAT_MIN_BPM..BEAT_MAX_BPM,
+            vote into a decaying histogram; the period follows its peak
+   phase    each kick near a predicted beat pulls the beat clock a quarter
+            of the way towards it; kicks off the grid cost confidence
+   build    beats with two or more snare hits and no kick raise the build
+            level; a kick after a build is the drop
+
+ Beats keep coming from the clock through breakdowns with no kick; the lock
+ (beatLocked()) only goes once confidence has drained away.  All of it is
+ integer maths with no division per frame: the phase multiplies by a
+ reciprocal of the period.  A kick costs two 32-bit divisions (its histogram
+ bin and the peak's centre), and two more (the reciprocal and the BPM) when
+ it moves the period.
+
+ Patterns see the engine through the tempo clock (tempo.h), which follows
+ it while it is locked.  Without LUMA_AUDIO nothing feeds the engine,
+ beatLocked() stays false and the clock keeps a tapped or default tempo.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define BEAT_SAMPLE_HZ       4000
+#define BEAT_BLOCK           32    // samples per onset frame: 8 ms
+#define BEAT_QUEUE_LEN       4     // blocks waiting for beatUpdate(); power of two
+#define BEAT_MIN_BPM         90
+#define BEAT_MAX_BPM         180
+#define BEAT_TEMPO_BINS      48
+#define BEAT_LOCK_CONFIDENCE 96
+#define BEAT_BUILD_ON        64    // build level from which a pattern should show a build-up
+
+struct BeatInfo {
+  uint8_t bpm;          // tempo estimate; 0 until there is one
+  uint8_t phase;        // 0-255 through the current beat, 0 on the beat
+  uint8_t barPhase;     // 0-255 through the current four-beat bar
+  uint8_t confidence;   // 0-255
+  uint8_t build;        // 0-255 build-up level
+  uint16_t periodMs;    // beat length
+  uint16_t sinceBeatMs; // these three saturate at 65535
+  uint16_t kickMs;      // since the last kick onset
+  uint16_t snareMs;     // since the last snare onset
+  uint16_t dropMs;      // since the last drop
+  uint32_t beats;       // beats counted by the clock
+};
+
+void beatBegin(uint8_t micPin);      // LUMA_AUDIO only: starts sampling micPin
+void beatReset();
+void beatSample(uint16_t adc);       // one 10-bit sample; interrupt context on the part
+void beatUpdate();                   // once per frame
+const BeatInfo& beatInfo();
+bool beatLocked();
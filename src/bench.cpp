@@ -0,0 +1,313 @@
+#ifdef LUMA_BENCH
+
+#include <FastLED.h>
+
+#include "beat.h"
+#include "bench.h"
+#include "compositor.h"
+#include "cycles.h"
+#include "geometry.h"
+#include "power.h"
+#include "tempo.h"
+#include "transition.h"
+#include "vm.h"
+#include "wavetable.h"
+
+extern PatternFn outerPatternList[];
+extern PatternFn innerPatternList[];
+extern const uint8_t OUTER_PATTERN_COUNT;
+extern const uint8_t INNER_PATTERN_COUNT;
+void berlinMode(const FrameContext& frame);
+void bpm(const FrameContext& frame);
+
+struct CycleStats {
+  uint32_t total;
+  uint32_t max;
+
+  void add(uint32_t cycles) {
+    total += cycles;
+    if (cycles > max) max = cycles;
+  }
+};
+
+static void printColumn(uint32_t value) {
+  Serial.print('\t');
+  Serial.print(value);
+}
+
+static void printStats(const CycleStats& stats) {
+  printColumn(stats.total / BENCH_FRAMES);
+  printColumn(stats.max);
+}
+
+// One frame's worth of a waveform: a sample per outer LED, as dualSinePulsePattern() takes them
+template <typename F>
+static uint32_t waveFrame(F shape, uint8_t phase, uint8_t* out) {
+  uint32_t start = cyclesNow();
+  for (uint8_t i = 0; i < OUTER_LEN; i++) {
+    out[i] = shape((uint8_t)(ringAngle(i) + phase));
+  }
+  return cyclesNow() - start;
+}
+
+// The lib8tion chain each table replaces
+static uint8_t computeWave(uint8_t wave, uint8_t phase) {
+  if (wave == WAVE_DUAL_PULSE) {
+    uint8_t raw = max(sin8(phase), sin8(phase + 128));
+    uint8_t contrast = scale8(raw, raw);
+    contrast = scale8(contrast, contrast);
+    return ease8InOutCubic(contrast);
+  }
+  return ease8InOutCubic(triwave8(phase));
+}
+
+void benchRun(uint8_t frameMs, CRGB* leds, uint8_t count) {
+  const uint32_t budget = frameMs * (F_CPU / 1000UL);
+
+  Serial.begin(115200);
+  cyclesBegin();
+
+  // Cost of reading the counter itself, taken off every measurement
+  uint32_t t0 = cyclesNow();
+  uint32_t overhead = cyclesNow() - t0;
+
+  Serial.print(F("# luma bench f_cpu="));
+  Serial.print(F_CPU);
+  Serial.print(F(" frames="));
+  Serial.print(BENCH_FRAMES);
+  Serial.print(F(" budget="));
+  Serial.print(budget);
+  Serial.print(F(" overhead="));
+  Serial.print(overhead);
+  Serial.print(F(" board=" BOARD_NAME " leds="));
+  Serial.println(count);
+  Serial.println(F("pair\touter\tinner\touter_avg\touter_max\tinner_avg\tinner_max\tshow_avg\tshow_max\tframe_max\tover\tlimit_avg\tlimit_max\tpeak_ma\tavg_ma\tcomp_avg\tcomp_max"));
+
+  for (uint8_t pair = 0; pair < OUTER_PATTERN_COUNT; pair++) {
+    uint8_t inner = pair < INNER_PATTERN_COUNT ? pair : 0;
+    if (!outerPatternList[pair] || !innerPatternList[inner]) continue; // the auto-cycle shows the other pairs
+    // Fresh state, rendered as the loop does, so keyframed patterns (pattern.h) skip frames here too
+    transitionCut(GROUP_OUTER, nullptr);
+    transitionCut(GROUP_INNER, nullptr);
+    transitionCut(GROUP_OUTER, outerPatternList[pair]);
+    transitionCut(GROUP_INNER, innerPatternList[inner]);
+    CycleStats outerStats = {0, 0}, innerStats = {0, 0}, showStats = {0, 0}, limitStats = {0, 0}, compStats = {0, 0}, frameStats = {0, 0};
+    uint16_t overruns = 0;
+
+    compositorClear();
+    powerResetStats();
+    for (uint16_t frame = 0; frame < BENCH_FRAMES; frame++) {
+      tempoUpdate(); // timed on its own below
+      FrameContext context = patternFrameBegin();
+      uint32_t start = cyclesNow();
+      transitionRender(GROUP_OUTER, context);
+      uint32_t outerDone = cyclesNow();
+      transitionRender(GROUP_INNER, context);
+      uint32_t innerDone = cyclesNow();
+      compositorRun();
+      uint32_t compDone = cyclesNow();
+      powerLimit(leds, count, POWER_BUDGET_MA);
+      uint32_t limitDone = cyclesNow();
+      FastLED.show();
+      uint32_t showDone = cyclesNow();
+
+      outerStats.add(outerDone - start - overhead);
+      innerStats.add(innerDone - outerDone - overhead);
+      compStats.add(compDone - innerDone - overhead);
+      limitStats.add(limitDone - compDone - overhead);
+      showStats.add(showDone - limitDone - overhead);
+      uint32_t frameCycles = showDone - start - 5 * overhead;
+      frameStats.add(frameCycles);
+      if (frameCycles > budget) overruns++;
+
+      delay(frameMs); // keep pattern timing (millis, EVERY_N_MILLISECONDS) realistic
+    }
+
+    Serial.print(pair);
+    printColumn(pair);
+    printColumn(inner);
+    printStats(outerStats);
+    printStats(innerStats);
+    printStats(showStats);
+    printColumn(frameStats.max);
+    printColumn(overruns);
+    printStats(limitStats);
+    printColumn(powerStats().peakMa);
+    printColumn(powerStats().totalMa / BENCH_FRAMES);
+    printStats(compStats);
+    if (overruns) Serial.print(F("\tOVER"));
+    Serial.println();
+  }
+
+  // Every pattern switch, timed for the whole crossfade: both patterns render every frame
+  Serial.print(F("# transitions ms="));
+  Serial.println(TRANSITION_MS);
+  Serial.println(F("xfade\tfrom\tto\tframe_avg\tframe_max\tover"));
+
+  for (uint8_t from = 0; from < OUTER_PATTERN_COUNT; from++) {
+    for (uint8_t to = 0; to < OUTER_PATTERN_COUNT; to++) {
+      if (from == to) continue;
+      uint8_t innerFrom = from < INNER_PATTERN_COUNT ? from : 0;
+      uint8_t innerTo = to < INNER_PATTERN_COUNT ? to : 0;
+      if (!outerPatternList[from] || !outerPatternList[to] || !innerPatternList[innerFrom] || !innerPatternList[innerTo]) continue;
+      CycleStats frameStats = {0, 0};
+      uint16_t frames = 0, overruns = 0;
+
+      // Give the outgoing pair a canvas worth fading out
+      compositorClear();
+      transitionCut(GROUP_OUTER, outerPatternList[from]);
+      transitionCut(GROUP_INNER, innerPatternList[innerFrom]);
+      for (uint8_t frame = 0; frame < 32; frame++) {
+        tempoUpdate();
+        FrameContext context = patternFrameBegin();
+        transitionRender(GROUP_OUTER, context);
+        transitionRender(GROUP_INNER, context);
+        delay(frameMs);
+      }
+
+      transitionStart(GROUP_OUTER, outerPatternList[to]);
+      transitionStart(GROUP_INNER, innerPatternList[innerTo]);
+      while (transitionActive(GROUP_OUTER) || transitionActive(GROUP_INNER)) {
+        tempoUpdate();
+        FrameContext context = patternFrameBegin();
+        uint32_t start = cyclesNow();
+        transitionRender(GROUP_OUTER, context);
+        transitionRender(GROUP_INNER, context);
+        compositorRun();
+        powerLimit(leds, count, POWER_BUDGET_MA);
+        FastLED.show();
+        uint32_t frameCycles = cyclesNow() - start - overhead;
+
+        frameStats.add(frameCycles);
+        frames++;
+        if (frameCycles > budget) overruns++;
+        delay(frameMs);
+      }
+
+      Serial.print(F("x"));
+      printColumn(from);
+      printColumn(to);
+      printColumn(frameStats.total / frames);
+      printColumn(frameStats.max);
+      printColumn(overruns);
+      if (overruns) Serial.print(F("\tOVER"));
+      Serial.println();
+    }
+  }
+
+  // Beat engine: a frame's worth of samples (in the TCB0 interrupt on a LUMA_AUDIO
+  // build), then the per-frame update, on a kick-like burst every half second
+  const uint8_t samplesPerFrame = (uint32_t)BEAT_SAMPLE_HZ * frameMs / 1000;
+  Serial.print(F("# beat samples_per_frame="));
+  Serial.println(samplesPerFrame);
+  Serial.println(F("beat\tsample_avg\tsample_max\tupdate_avg\tupdate_max\tframe_share"));
+
+  CycleStats sampleStats = {0, 0}, updateStats = {0, 0};
+  beatReset();
+  for (uint16_t frame = 0; frame < BENCH_FRAMES; frame++) {
+    bool burst = frame % 64 < 4;
+    for (uint8_t i = 0; i < samplesPerFrame; i++) {
+      uint16_t sample = burst ? 512 + ((int8_t)(sin8(i * 8) - 128) << 1) : 504 + (random8() >> 4);
+      uint32_t start = cyclesNow();
+      beatSample(sample);
+      sampleStats.add(cyclesNow() - start - overhead);
+    }
+    uint32_t start = cyclesNow();
+    beatUpdate();
+    updateStats.add(cyclesNow() - start - overhead);
+  }
+
+  uint32_t sampleAvg = sampleStats.total / ((uint32_t)BENCH_FRAMES * samplesPerFrame);
+  Serial.print(F("beat"));
+  printColumn(sampleAvg);
+  printColumn(sampleStats.max);
+  printStats(updateStats);
+  printColumn((sampleAvg * samplesPerFrame + updateStats.total / BENCH_FRAMES) * 1000 / budget); // per mille of the frame
+  Serial.println();
+
+  // Bytecode interpreter (vm.h): the two patterns it has versions of, native then
+  // bytecode on the same frame; "differ" counts frames whose output did not match
+  Serial.println(F("vm\tpattern\tnative_avg\tnative_max\tvm_avg\tvm_max\tratio_pct\tdiffer\tover"));
+  static const PatternFn vmNative[] = {berlinMode, bpm};
+  static const PatternFn vmBytecode[] = {vmPattern<VM_PROGRAM_BERLIN>, vmPattern<VM_PROGRAM_BPM>};
+  for (uint8_t p = 0; p < 2; p++) {
+    PatternSlot native, bytecode;
+    patternActivate(native, vmNative[p]);
+    patternActivate(bytecode, vmBytecode[p]);
+    CycleStats nativeStats = {0, 0}, vmStats = {0, 0};
+    uint16_t differ = 0, overruns = 0;
+    CRGB expected[OUTER_LEN];
+
+    compositorClear();
+    for (uint16_t frame = 0; frame < BENCH_FRAMES; frame++) {
+      tempoUpdate();
+      FrameContext context = patternFrameBegin();
+      uint32_t start = cyclesNow();
+      patternRender(native, context);
+      uint32_t nativeDone = cyclesNow();
+      compositorRun();
+      memcpy(expected, leds, sizeof(expected));
+      uint32_t vmStart = cyclesNow();
+      patternRender(bytecode, context);
+      uint32_t vmDone = cyclesNow();
+      compositorRun();
+      if (memcmp(expected, leds, sizeof(expected))) differ++;
+
+      nativeStats.add(nativeDone - start - overhead);
+      vmStats.add(vmDone - vmStart - overhead);
+      if (vmDone - vmStart > budget) overruns++;
+      delay(frameMs);
+    }
+
+    Serial.print(F("vm"));
+    printColumn(p);
+    printStats(nativeStats);
+    printStats(vmStats);
+    printColumn(nativeStats.total ? vmStats.total * 100 / nativeStats.total : 0);
+    printColumn(differ);
+    printColumn(overruns);
+    if (overruns) Serial.print(F("\tOVER"));
+    Serial.println();
+  }
+
+  // Wavetables (wavetable.h): each waveform computed with lib8tion, then looked up, over
+  // every phase; "differ" counts frames whose samples did not match
+  Serial.println(F("wave\twave\tcompute_avg\tcompute_max\ttable_avg\ttable_max\tratio_pct\tdiffer"));
+  for (uint8_t w = 0; w < WAVE_COUNT; w++) {
+    CycleStats computeStats = {0, 0}, tableStats = {0, 0};
+    uint16_t differ = 0;
+    for (uint16_t frame = 0; frame < BENCH_FRAMES; frame++) {
+      uint8_t computed[OUTER_LEN], table[OUTER_LEN];
+      computeStats.add(waveFrame([w](uint8_t phase) { return computeWave(w, phase); }, frame, computed) - overhead);
+      tableStats.add(waveFrame([w](uint8_t phase) { return wave8((WaveId)w, phase); }, frame, table) - overhead);
+      if (memcmp(computed, table, sizeof(table))) differ++;
+    }
+
+    Serial.print(F("wave"));
+    printColumn(w);
+    printStats(computeStats);
+    printStats(tableStats);
+    printColumn(computeStats.total ? tableStats.total * 100 / computeStats.total : 0);
+    printColumn(differ);
+    Serial.println();
+  }
+
+  // Tempo clock: the one timing calculation every frame pays for
+  Serial.println(F("tempo\tupdate_avg\tupdate_max"));
+  CycleStats tempoStats = {0, 0};
+  for (uint16_t frame = 0; frame < BENCH_FRAMES; frame++) {
+    uint32_t start = cyclesNow();
+    tempoUpdate();
+    tempoStats.add(cyclesNow() - start - overhead);
+    delay(frameMs);
+  }
+  Serial.print(F("tempo"));
+  printStats(tempoStats);
+  Serial.println();
+
+  Serial.println(F("# done"));
+  Serial.flush();
+  for (;;) {}
+}
+
+#endif
@@ -0,0 +1,31 @@
+/*
+
+ Frame-budget benchmark ([env:bench]).
+
+ Runs every outer/inner pattern pair for BENCH_FRAMES frames, measuring CPU
+ cycles for each render (keyframed patterns only on their keyframes, as
+ loop() renders them), the compositor, the power limiter and FastLED.show(), and prints one
+ table row per pair over Serial, with the pair's peak and average estimated
+ current (power.h).  Rows whose render + show exceeded the frame budget are
+ flagged OVER.  A second table (rows starting "x") times every pattern switch
+ over a whole crossfade, when both patterns render each frame.  The "beat"
+ row is the beat engine's cost per sample and per frame (beat.h), and its
+ share of the frame budget in per mille; the "tempo" row is the tempo
+ clock's update (tempo.h).  The "vm" rows time berlinMode and bpm against
+ their bytecode versions (vm.h) and check both draw the same frames; the
+ "wave" rows do the same for each wavetable (wavetable.h) against the
+ lib8tion it replaces.  Save the output and diff runs with
+ tools/bench_compare.py.  The header line names the board profile and its LED
+ count (boards.h), which is how tools/led_sweep.py tells the logs of a sweep
+ apart.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#define BENCH_FRAMES 256
+
+void benchRun(uint8_t frameMs, CRGB* leds, uint8_t count); // never returns
@@ -0,0 +1,78 @@
+/*
+
+ Board profiles: how many LEDs a pendant has and where they are.
+
+ Pick one at build time with -DLUMA_BOARD=BOARD_...; geometry.h lays the
+ segments out from it and builds its tables, and the patterns only see the
+ segments, so no other file names an LED count.
+
+   BOARD_PENDANT        pcb/luma_pendant.kicad_pcb (the default): 16 LEDs on
+                        a 47 mm ring, two lighting the acrylic from the front
+                        and two from the back
+   BOARD_PENDANT_100MM  pcb/luma_pendant-100mm.kicad_pcb: the same 20 LEDs on
+                        a 93 mm ring, with the back pair the other way round
+   BOARD_RING           BOARD_RING_LEDS on the outer ring and the pendant's
+                        inner four: for larger rings, and for the LED-count
+                        sweep (tools/led_sweep.py)
+
+ On both PCBs the strip starts at the top of the ring and runs anticlockwise
+ seen from the front, then the front pair (top, bottom), then the back pair.
+ BOARD_INNER_XY puts the inner LEDs on geometry.h's face grid, where the ring
+ is 127 from the centre and LED 0 is at +x, so "top" is +x there.  The
+ positions were read off the PCBs.
+
+ The strip is addressed with uint8_t throughout, so it stops at 255 LEDs;
+ each LED costs 15 bytes of RAM (leds_raw, leds_out, the compositor's two
+ canvases and output.h's copy of the frame shown), 21 on a LUMA_STREAM build.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define BOARD_PENDANT        1
+#define BOARD_PENDANT_100MM  2
+#define BOARD_RING           3
+
+#ifndef LUMA_BOARD
+#define LUMA_BOARD BOARD_PENDANT
+#endif
+
+#if LUMA_BOARD == BOARD_PENDANT
+#define BOARD_NAME              "pendant"
+#define BOARD_OUTER_LEDS        16
+#define BOARD_INNER_FRONT_LEDS  2
+#define BOARD_INNER_BACK_LEDS   2
+// Front top, front bottom, back left, back right; the inner LEDs are 20.5 mm out on a 23.7 mm ring
+#define BOARD_INNER_XY          {238, 128, 18, 128, 128, 238, 128, 18}
+
+#elif LUMA_BOARD == BOARD_PENDANT_100MM
+#define BOARD_NAME              "pendant-100mm"
+#define BOARD_OUTER_LEDS        16
+#define BOARD_INNER_FRONT_LEDS  2
+#define BOARD_INNER_BACK_LEDS   2
+// Front top, front bottom, back right, back left; 42.2 mm out on a 46.7 mm ring
+#define BOARD_INNER_XY          {243, 128, 13, 128, 128, 13, 128, 243}
+
+#elif LUMA_BOARD == BOARD_RING
+#ifndef BOARD_RING_LEDS
+#define BOARD_RING_LEDS         32
+#endif
+#define BOARD_NAME              "ring"
+#define BOARD_OUTER_LEDS        BOARD_RING_LEDS
+#define BOARD_INNER_FRONT_LEDS  2
+#define BOARD_INNER_BACK_LEDS   2
+#define BOARD_INNER_XY          {238, 128, 18, 128, 128, 238, 128, 18}
+
+#else
+#error "LUMA_BOARD is not one of the BOARD_ profiles in boards.h"
+#endif
+
+#define BOARD_LED_COUNT (BOARD_OUTER_LEDS + BOARD_INNER_FRONT_LEDS + BOARD_INNER_BACK_LEDS)
+static_assert(BOARD_OUTER_LEDS >= 2 && BOARD_INNER_FRONT_LEDS >= 1 && BOARD_INNER_BACK_LEDS >= 1,
+              "every segment needs an LED, and the ring two");
+static_assert(BOARD_LED_COUNT <= 255, "LED indices are uint8_t");
+
+// x, y for each inner LED, front then back
+constexpr uint8_t boardInnerXY[2 * (BOARD_INNER_FRONT_LEDS + BOARD_INNER_BACK_LEDS)] = BOARD_INNER_XY;
@@ -0,0 +1,201 @@
+#include "buttons.h"
+#include "state.h"
+
+#define BUTTON_DOWN       0x01 // debounced level
+#define BUTTON_LONG_SENT  0x02 // this press already sent BUTTON_LONG
+#define BUTTON_DOUBLES    0x04 // recognises double presses
+
+struct ButtonState {
+  uint8_t pin;
+  uint8_t flags;
+  uint8_t clicks;  // short presses waiting out the double press gap
+  uint32_t edgeMs; // last accepted edge: start of the press, or of the release
+  uint32_t pressMs; // start of the last press
+};
+
+static PENDANT_STATE volatile ButtonState buttons[BUTTON_COUNT];
+
+// Written only by interrupts (head) and only by the main loop (tail)
+static PENDANT_STATE volatile ButtonEvent queue[BUTTON_QUEUE_LEN];
+static PENDANT_STATE volatile uint8_t queueHead;
+static PENDANT_STATE volatile uint8_t queueTail;
+
+static PENDANT_STATE volatile bool ticking;
+
+static void tickStart();
+static void tickStop();
+
+// A full queue drops the new gesture: the loop has fallen far behind and
+// would only act on stale presses
+static void push(uint8_t button, uint8_t gesture) {
+  uint8_t head = queueHead;
+  if ((uint8_t)(head - queueTail) >= BUTTON_QUEUE_LEN) return;
+  volatile ButtonEvent& slot = queue[head & (BUTTON_QUEUE_LEN - 1)];
+  slot.button = button;
+  slot.gesture = gesture;
+  slot.pressMs = buttons[button].pressMs;
+  queueHead = head + 1;
+}
+
+// Interrupt context only
+static void sample(uint8_t i, uint32_t now) {
+  volatile ButtonState& b = buttons[i];
+  bool down = digitalRead(b.pin) == LOW;
+  if (down == (bool)(b.flags & BUTTON_DOWN)) return;
+  if (now - b.edgeMs < BUTTON_DEBOUNCE_MS) return; // bounce; the tick looks again once the window has passed
+
+  b.edgeMs = now;
+  if (down) {
+    b.flags = (b.flags | BUTTON_DOWN) & ~BUTTON_LONG_SENT;
+    b.pressMs = now;
+  } else {
+    b.flags &= ~BUTTON_DOWN;
+    if (b.flags & BUTTON_LONG_SENT) return;
+    if (!(b.flags & BUTTON_DOUBLES)) {
+      push(i, BUTTON_SHORT);
+    } else if (++b.clicks == 2) {
+      push(i, BUTTON_DOUBLE);
+      b.clicks = 0;
+    }
+  }
+}
+
+static void tick() {
+  uint32_t now = millis();
+  bool busy = false;
+
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    sample(i, now);
+    volatile ButtonState& b = buttons[i];
+    uint32_t since = now - b.edgeMs;
+    bool down = b.flags & BUTTON_DOWN;
+
+    if (down && !(b.flags & BUTTON_LONG_SENT) && since >= BUTTON_LONG_MS) {
+      if (b.clicks) push(i, BUTTON_SHORT); // the press before this one was a plain short press
+      b.clicks = 0;
+      push(i, BUTTON_LONG);
+      b.flags |= BUTTON_LONG_SENT;
+    }
+    if (!down && b.clicks && since >= BUTTON_DOUBLE_MS) {
+      push(i, BUTTON_SHORT);
+      b.clicks = 0;
+    }
+
+    busy |= since < BUTTON_DEBOUNCE_MS || b.clicks || (down && !(b.flags & BUTTON_LONG_SENT));
+  }
+
+  if (!busy) tickStop();
+}
+
+static void edge1() {
+  sample(BUTTON_1, millis());
+  tickStart();
+}
+
+static void edge2() {
+  sample(BUTTON_2, millis());
+  tickStart();
+}
+
+#ifdef LUMA_NATIVE
+
+static void tickStart() {
+  if (ticking) return;
+  ticking = true;
+  nativeSetTimer(tick, BUTTON_TICK_MS * 1000UL);
+}
+
+static void tickStop() {
+  ticking = false;
+  nativeSetTimer(nullptr, 0);
+}
+
+static void tickEnable(bool) {}
+
+#else
+
+ISR(RTC_PIT_vect) {
+  RTC.PITINTFLAGS = RTC_PI_bm;
+  tick();
+}
+
+// The PIT keeps counting the whole time (timebase.cpp has the RTC clock
+// running); only its interrupt comes and goes, which needs no clock-domain sync
+static void tickStart() {
+  if (ticking) return;
+  ticking = true;
+  RTC.PITINTFLAGS = RTC_PI_bm;
+  RTC.PITINTCTRL = RTC_PI_bm;
+}
+
+static void tickStop() {
+  ticking = false;
+  RTC.PITINTCTRL = 0;
+}
+
+static void tickEnable(bool on) {
+  while (RTC.PITSTATUS & RTC_CTRLBUSY_bm) {}
+  RTC.PITCTRL = on ? (RTC_PERIOD_CYC512_gc | RTC_PITEN_bm) : 0;
+}
+
+#endif
+
+void buttonsBegin(uint8_t pin1, uint8_t pin2, uint8_t doubleMask) {
+  uint8_t pins[BUTTON_COUNT] = {pin1, pin2};
+  uint32_t now = millis();
+
+  noInterrupts();
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    pinMode(pins[i], INPUT_PULLUP);
+    buttons[i].pin = pins[i];
+    buttons[i].flags = (digitalRead(pins[i]) == LOW ? BUTTON_DOWN | BUTTON_LONG_SENT : 0) // a press held through begin is not a gesture
+                     | (doubleMask & BUTTON_MASK(i) ? BUTTON_DOUBLES : 0);
+    buttons[i].clicks = 0;
+    buttons[i].edgeMs = now - BUTTON_DEBOUNCE_MS;
+    buttons[i].pressMs = now;
+  }
+  queueTail = queueHead;
+  interrupts();
+
+  tickEnable(true);
+  attachInterrupt(digitalPinToInterrupt(pin1), edge1, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(pin2), edge2, CHANGE);
+}
+
+void buttonsEnd() {
+  detachInterrupt(digitalPinToInterrupt(buttons[BUTTON_1].pin));
+  detachInterrupt(digitalPinToInterrupt(buttons[BUTTON_2].pin));
+  noInterrupts();
+  tickStop();
+  interrupts();
+  tickEnable(false);
+}
+
+void buttonsSetDoubles(uint8_t doubleMask) {
+  noInterrupts();
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    if (doubleMask & BUTTON_MASK(i)) {
+      buttons[i].flags |= BUTTON_DOUBLES;
+    } else if (buttons[i].flags & BUTTON_DOUBLES) {
+      buttons[i].flags &= ~BUTTON_DOUBLES;
+      if (buttons[i].clicks) push(i, BUTTON_SHORT); // nothing will wait out its gap any more
+      buttons[i].clicks = 0;
+    }
+  }
+  interrupts();
+}
+
+bool buttonsRead(ButtonEvent& event) {
+  uint8_t tail = queueTail;
+  if (tail == queueHead) return false;
+  volatile ButtonEvent& slot = queue[tail & (BUTTON_QUEUE_LEN - 1)];
+  event.button = slot.button;
+  event.gesture = slot.gesture;
+  event.pressMs = slot.pressMs;
+  queueTail = tail + 1;
+  return true;
+}
+
+bool buttonsHeld(uint8_t button) {
+  return buttons[button].flags & BUTTON_DOWN;
+}
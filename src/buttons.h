@@ -0,0 +1,71 @@
+/*
+
+ Interrupt-driven buttons with gestures.
+
+ Each button pin has a pin-change interrupt.  The first edge after a quiet
+ spell is taken straight away (leading-edge debounce), so a press registers
+ when the contact closes rather than at the next frame; edges in the
+ BUTTON_DEBOUNCE_MS after it are contact bounce and are ignored.
+
+ While any button is busy (held, bouncing or waiting out a double press) the
+ RTC periodic interrupt ticks every BUTTON_TICK_MS: it re-reads pins whose
+ bounce window has passed, so a level that settled during the window is not
+ missed, and it times the long and double presses.  Once both buttons are
+ idle the tick is switched off again, so nothing polls them.
+
+ Gestures go into a small queue that only interrupts write and only the main
+ loop reads (buttonsRead()), so neither side needs a lock:
+
+   BUTTON_SHORT   released before BUTTON_LONG_MS
+   BUTTON_LONG    held for BUTTON_LONG_MS; sent while still held, no SHORT follows
+   BUTTON_DOUBLE  two short presses, the second starting within BUTTON_DOUBLE_MS
+
+ Only buttons in the doubleMask passed to buttonsBegin() (or later to
+ buttonsSetDoubles()) recognise double presses.  Those hold each SHORT back
+ until BUTTON_DOUBLE_MS has gone by without a second press; the others send
+ SHORT on release.  Every gesture carries the time its last press started,
+ so a late SHORT still tells when the button went down.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef BUTTON_DEBOUNCE_MS
+#define BUTTON_DEBOUNCE_MS 30
+#endif
+#ifndef BUTTON_LONG_MS
+#define BUTTON_LONG_MS 800
+#endif
+#ifndef BUTTON_DOUBLE_MS
+#define BUTTON_DOUBLE_MS 250
+#endif
+#define BUTTON_TICK_MS 16 // RTC PIT at 512 cycles of 32.768 kHz (15.6 ms)
+#define BUTTON_QUEUE_LEN 8 // power of two
+
+enum ButtonId {
+  BUTTON_1,
+  BUTTON_2,
+  BUTTON_COUNT
+};
+
+enum ButtonGesture {
+  BUTTON_SHORT,
+  BUTTON_LONG,
+  BUTTON_DOUBLE
+};
+
+#define BUTTON_MASK(id) (1 << (id))
+
+struct ButtonEvent {
+  uint8_t button;   // ButtonId
+  uint8_t gesture;  // ButtonGesture
+  uint32_t pressMs; // millis() when the gesture's last press started, e.g. for tap tempo
+};
+
+void buttonsBegin(uint8_t pin1, uint8_t pin2, uint8_t doubleMask); // pins are active low, pulled up here
+void buttonsSetDoubles(uint8_t doubleMask);  // change which buttons recognise double presses
+void buttonsEnd();                      // detach the interrupts and stop the tick, e.g. for powerDown()
+bool buttonsRead(ButtonEvent& event);   // next queued gesture; false when there is none
+bool buttonsHeld(uint8_t button);       // debounced level
@@ -0,0 +1,156 @@
+#include "compositor.h"
+#include "state.h"
+
+struct SegmentRange {
+  uint8_t first;
+  uint8_t len;
+};
+
+static const SegmentRange segments[SEGMENT_COUNT] = {
+  {OUTER_FIRST, OUTER_LEN},
+  {INNER_FRONT_FIRST, INNER_FRONT_LEN},
+  {INNER_BACK_FIRST, INNER_BACK_LEN},
+};
+
+static PENDANT_STATE CRGB* rawLeds;
+static PENDANT_STATE CRGB* outLeds;
+static PENDANT_STATE CRGB outgoingLeds[GEOMETRY_LED_COUNT]; // the outgoing pattern's canvas during a transition
+static PENDANT_STATE CRGB keyframeLeds[GEOMETRY_LED_COUNT]; // the canvas before the last keyframe, for compositorTween()
+static PENDANT_STATE uint8_t master[SEGMENT_COUNT];
+static PENDANT_STATE uint8_t patternScale[LAYER_COUNT][SEGMENT_COUNT] = {{255, 255, 255}, {255, 255, 255}};
+static PENDANT_STATE uint8_t heldScale[SEGMENT_COUNT] = {255, 255, 255}; // the current layer's scaling last frame
+static PENDANT_STATE bool held[SEGMENT_COUNT];
+static PENDANT_STATE uint8_t mix[SEGMENT_COUNT] = {255, 255, 255};
+static PENDANT_STATE uint8_t tween[SEGMENT_COUNT] = {255, 255, 255};
+static PENDANT_STATE uint8_t layer = LAYER_CURRENT;
+
+#ifdef LUMA_GAMMA
+
+// 255 * (x / 255) ^ (COMPOSITOR_GAMMA_X4 / 4), worked out by the compiler
+constexpr double gammaQuarterRoot(double x) {
+  // Newton's method for sqrt, twice
+  double r = x > 1 ? x : 1;
+  for (uint8_t i = 0; i < 40; i++) r = (r + x / r) / 2;
+  double q = r > 1 ? r : 1;
+  for (uint8_t i = 0; i < 40; i++) q = (q + r / q) / 2;
+  return x == 0 ? 0 : q;
+}
+
+struct GammaTable {
+  uint8_t value[256];
+
+  constexpr GammaTable() : value() {
+    for (uint16_t i = 0; i < 256; i++) {
+      double quarter = gammaQuarterRoot(i / 255.0);
+      double y = 1;
+      for (uint8_t k = 0; k < COMPOSITOR_GAMMA_X4; k++) y *= quarter;
+      value[i] = (uint8_t)(y * 255 + 0.5);
+    }
+  }
+};
+
+static constexpr GammaTable gammaTable PROGMEM = GammaTable();
+
+static inline uint8_t applyGamma(uint8_t x) { return pgm_read_byte(&gammaTable.value[x]); }
+
+#else
+
+static inline uint8_t applyGamma(uint8_t x) { return x; }
+
+#endif
+
+void compositorBegin(CRGB* raw, CRGB* out) {
+  rawLeds = raw;
+  outLeds = out;
+}
+
+void compositorClear() {
+  memset(rawLeds, 0, GEOMETRY_LED_COUNT * sizeof(CRGB));
+  memset(outgoingLeds, 0, GEOMETRY_LED_COUNT * sizeof(CRGB));
+  memset(keyframeLeds, 0, GEOMETRY_LED_COUNT * sizeof(CRGB));
+  memset(outLeds, 0, GEOMETRY_LED_COUNT * sizeof(CRGB));
+}
+
+void compositorCaptureOutgoing(SegmentId segment) {
+  CRGB* raw = rawLeds + segments[segment].first;
+  memcpy(outgoingLeds + segments[segment].first, raw, segments[segment].len * sizeof(CRGB));
+  memset(raw, 0, segments[segment].len * sizeof(CRGB));
+  // If this happens mid-frame, the outgoing layer shows what was just drawn, as it was drawn
+  patternScale[LAYER_OUTGOING][segment] = patternScale[LAYER_CURRENT][segment];
+  mix[segment] = 0;
+}
+
+void compositorSwapOutgoing(SegmentId segment) {
+  CRGB* a = rawLeds + segments[segment].first;
+  CRGB* b = outgoingLeds + segments[segment].first;
+  for (uint8_t i = 0; i < segments[segment].len; i++) {
+    CRGB t = a[i];
+    a[i] = b[i];
+    b[i] = t;
+  }
+}
+
+void compositorSetLayer(CompositorLayer drawing) {
+  layer = drawing;
+}
+
+void compositorMix(SegmentId segment, fract8 amountOfCurrent) {
+  mix[segment] = amountOfCurrent;
+}
+
+void compositorKeyframe(SegmentId segment) {
+  memcpy(keyframeLeds + segments[segment].first, rawLeds + segments[segment].first, segments[segment].len * sizeof(CRGB));
+}
+
+void compositorHold(SegmentId segment) {
+  held[segment] = true;
+}
+
+void compositorTween(SegmentId segment, fract8 amountOfCanvas) {
+  tween[segment] = amountOfCanvas;
+}
+
+void compositorSetMaster(SegmentId segment, uint8_t brightness) {
+  master[segment] = brightness;
+}
+
+void compositorScale(SegmentId segment, uint8_t scale) {
+  patternScale[layer][segment] = scale;
+}
+
+static inline CRGB composite(const CRGB& in, uint8_t scale) {
+  return CRGB(scale8(applyGamma(in.r), scale), scale8(applyGamma(in.g), scale), scale8(applyGamma(in.b), scale));
+}
+
+void compositorRun() {
+  for (uint8_t s = 0; s < SEGMENT_COUNT; s++) {
+    if (!held[s]) heldScale[s] = patternScale[LAYER_CURRENT][s];
+    uint8_t scale = scale8(master[s], heldScale[s]);
+    uint8_t scaleOutgoing = scale8(master[s], patternScale[LAYER_OUTGOING][s]);
+    uint8_t amount = mix[s];
+    uint8_t amountOfCanvas = tween[s];
+    patternScale[LAYER_CURRENT][s] = 255;
+    patternScale[LAYER_OUTGOING][s] = 255;
+    held[s] = false;
+    mix[s] = 255;
+    tween[s] = 255;
+
+    const CRGB* in = rawLeds + segments[s].first;
+    CRGB* out = outLeds + segments[s].first;
+    if (amount == 255 && amountOfCanvas == 255) {
+      for (uint8_t i = 0; i < segments[s].len; i++) {
+        out[i] = composite(in[i], scale);
+      }
+    } else if (amount == 255) {
+      const CRGB* keyframe = keyframeLeds + segments[s].first;
+      for (uint8_t i = 0; i < segments[s].len; i++) {
+        out[i] = composite(blend(keyframe[i], in[i], amountOfCanvas), scale);
+      }
+    } else {
+      const CRGB* outgoing = outgoingLeds + segments[s].first;
+      for (uint8_t i = 0; i < segments[s].len; i++) {
+        out[i] = blend(composite(outgoing[i], scaleOutgoing), composite(in[i], scale), amount);
+      }
+    }
+  }
+}
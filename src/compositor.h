@@ -0,0 +1,78 @@
+/*
+
+ Output compositor: the one pass from what the patterns drew to what is shown.
+
+ Patterns render at full scale into leds_raw and never touch master
+ brightness.  Once per frame, just before show(), compositorRun() writes each
+ LED of leds_raw into the output buffer FastLED sends, applying in one fused
+ pass:
+
+   - gamma correction (only with -DLUMA_GAMMA; the AgroGamma palettes are
+     already tuned by hand for these LEDs, so it is off by default),
+   - the pattern's own scaling for that segment (compositorScale()),
+   - the segment's master brightness (compositorSetMaster(), from button 2).
+
+ Keeping leds_raw unscaled also means trails faded in place (fadeToBlackBy)
+ decay the same way at every brightness level.
+
+ During a pattern transition (transition.h) the outgoing pattern keeps its own
+ canvas in a second, compositor-owned buffer.  compositorSwapOutgoing() swaps
+ it into leds_raw around the outgoing pattern's render, so patterns never
+ need to know which buffer they draw into, and compositorRun() blends the two
+ layers, each with its own pattern scaling.
+
+ A pattern that renders keyframes (pattern.h) leaves its canvas alone
+ between them.  compositorHold() keeps its scaling from the frame it last
+ drew, and with PATTERN_INTERPOLATE compositorKeyframe() keeps the canvas as
+ it was before each keyframe, so compositorTween() can show a blend from it
+ to the canvas.  The blend is only for what is shown: leds_raw stays what the
+ pattern drew, trails and all.
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#include "geometry.h"
+
+// Gamma exponent in quarters, used with -DLUMA_GAMMA (10 = 2.5, as FastLED's napplyGamma_video)
+#ifndef COMPOSITOR_GAMMA_X4
+#define COMPOSITOR_GAMMA_X4 10
+#endif
+
+enum SegmentId : uint8_t {
+  SEGMENT_OUTER,
+  SEGMENT_INNER_FRONT,
+  SEGMENT_INNER_BACK,
+  SEGMENT_COUNT
+};
+
+enum CompositorLayer : uint8_t {
+  LAYER_CURRENT,
+  LAYER_OUTGOING,
+  LAYER_COUNT
+};
+
+void compositorBegin(CRGB* raw, CRGB* out);
+void compositorSetMaster(SegmentId segment, uint8_t brightness);
+// Per-pattern scaling; call while rendering, it applies to this frame only
+void compositorScale(SegmentId segment, uint8_t scale);
+void compositorRun();
+void compositorClear(); // blanks every buffer, e.g. when the brightness changes
+
+// Transitions: move a segment's canvas to the outgoing layer and blank it for the new pattern
+void compositorCaptureOutgoing(SegmentId segment);
+// Swap the outgoing canvas into leds_raw; call again to swap back
+void compositorSwapOutgoing(SegmentId segment);
+// Which layer compositorScale() applies to while a pattern renders
+void compositorSetLayer(CompositorLayer drawing);
+// Blend for this frame only: 0 = all outgoing, 255 = all current
+void compositorMix(SegmentId segment, fract8 amountOfCurrent);
+
+// Keyframes: keep the segment's canvas as the keyframe to blend from, before the pattern draws the next
+void compositorKeyframe(SegmentId segment);
+// The pattern did not draw this frame: its scaling from the last frame it drew applies
+void compositorHold(SegmentId segment);
+// Blend for this frame only: 0 = the kept keyframe, 255 = the canvas; not during a transition
+void compositorTween(SegmentId segment, fract8 amountOfCanvas);
@@ -0,0 +1,43 @@
+#include "cycles.h"
+#include "state.h"
+
+#ifdef LUMA_NATIVE
+
+// On the desktop there is no cycle counter to read, so derive one from the virtual clock
+void cyclesBegin() {}
+
+uint32_t cyclesNow() {
+  return nativeMicros() * (F_CPU / 1000000UL);
+}
+
+#else
+
+static PENDANT_STATE volatile uint16_t cyclesWraps = 0;
+
+ISR(TCB1_INT_vect) {
+  TCB1.INTFLAGS = TCB_CAPT_bm;
+  cyclesWraps++;
+}
+
+void cyclesBegin() {
+  TCB1.CTRLA = 0;
+  TCB1.CTRLB = TCB_CNTMODE_INT_gc; // periodic interrupt, wraps at CCMP
+  TCB1.CCMP = 0xFFFF;
+  TCB1.CNT = 0;
+  TCB1.INTFLAGS = TCB_CAPT_bm;
+  TCB1.INTCTRL = TCB_CAPT_bm;
+  TCB1.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+uint32_t cyclesNow() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t count = TCB1.CNT;
+  uint16_t wraps = cyclesWraps;
+  // A wrap that happened while interrupts were off has not been counted yet
+  if ((TCB1.INTFLAGS & TCB_CAPT_bm) && count < 0x8000) wraps++;
+  SREG = sreg;
+  return ((((uint32_t)wraps) << 16) | count) << 1;
+}
+
+#endif
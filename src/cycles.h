@@ -0,0 +1,17 @@
+/*
+
+ CPU cycle counter for measuring render and show cost on the pendant itself.
+
+ TCB1 free-runs at CLK_PER/2 and its wrap interrupt extends the count to 32 bits.
+ The counter keeps running while interrupts are off (FastLED.show()), and one
+ missed wrap is recovered from the pending flag, so any span up to ~8 ms with
+ interrupts disabled is measured exactly (to 2 cycles).
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+void cyclesBegin();
+uint32_t cyclesNow();
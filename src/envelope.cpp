@@ -0,0 +1,28 @@
+#include "envelope.h"
+
+// 255 * exp(-k / 8) for k = 0..64, i.e. 1/8 e-fold steps out to 8 e-folds
+static const uint8_t EXP_DECAY_LUT[65] PROGMEM = {
+  255, 225, 199, 175, 155, 136, 120, 106, 94, 83, 73, 64, 57, 50, 44, 39,
+   35,  30,  27,  24,  21,  18,  16,  14, 13, 11, 10,  9,  8,  7,  6,  5,
+    5,   4,   4,   3,   3,   2,   2,   2,  2,  2,  1,  1,  1,  1,  1,  1,
+    1,   1,   0,   0,   0,   0,   0,   0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0
+};
+
+uint8_t envExpDecay8(uint16_t elapsedMs, uint16_t rate) {
+  uint32_t efolds = ((uint32_t)elapsedMs * rate) >> 8; // 1/256 e-folds
+  if (efolds >= (64 << 5)) return 0;
+
+  // Table steps are 1/8 e-fold (32 units); interpolate inside the step
+  uint8_t index = efolds >> 5;
+  uint8_t frac = (efolds & 0x1F) << 3;
+  uint8_t a = pgm_read_byte(&EXP_DECAY_LUT[index]);
+  uint8_t b = pgm_read_byte(&EXP_DECAY_LUT[index + 1]);
+  return a - scale8(a - b, frac);
+}
+
+void envFade(CRGB* leds, uint8_t count, fract8 keep) {
+  for (uint8_t i = 0; i < count; i++) {
+    leds[i].nscale8(keep);
+  }
+}
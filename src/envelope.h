@@ -0,0 +1,25 @@
+/*
+
+ Fixed-point envelopes for the patterns: exponential decay and a
+ multiplicative per-step fade.  Everything is 8/16-bit integer math with a
+ small PROGMEM table, so nothing here pulls in the AVR soft-float library.
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+// Decay rate for exp(-t / (DECAY_MS / DIVISOR)), the form the patterns used
+// with floats, in 1/256 e-folds per ms.  Evaluated at compile time.
+#define ENV_DECAY_RATE(DECAY_MS, DIVISOR) ((uint16_t)((65536UL * (DIVISOR) + (DECAY_MS) / 2) / (DECAY_MS)))
+
+// Keep-factor for CRGB::nscale8()/envFade() that matches multiplying by KEEP
+// (0.0 - 1.0), e.g. ENV_KEEP(0.85) for a 15% fade per step.
+#define ENV_KEEP(KEEP) ((fract8)((KEEP) * 256 - 1))
+
+// 255 * exp(-elapsed / tau), where rate comes from ENV_DECAY_RATE()
+uint8_t envExpDecay8(uint16_t elapsedMs, uint16_t rate);
+
+// Multiply every channel by keep/256 (one step of a multiplicative fade)
+void envFade(CRGB* leds, uint8_t count, fract8 keep);
@@ -0,0 +1,4 @@
+#include "geometry.h"
+
+// constexpr forces the constructor to run in the compiler, so this is plain data in flash
+constexpr RingTables geometry PROGMEM = RingTables();
@@ -0,0 +1,67 @@
+/*
+
+ Pendant geometry, computed at compile time from the segment layout.
+
+ The outer ring is OUTER_LEN LEDs evenly spaced round a circle; the inner
+ acrylic has two LEDs lighting it from the front and two from the back.  Every
+ per-LED quantity the patterns used to recompute each frame (position as an
+ angle, the LED across the ring, its neighbours, x/y on the face) is built
+ into flash tables here, so a pattern pays one LPM instead of a divide.
+
+ x/y are on a 0-255 grid with the ring centred at (128, 128) and LED 0 at
+ angle 0 (+x).  The segment sizes and where the inner LEDs sit come from the
+ board profile (boards.h).
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "boards.h"
+#include "math8.h"
+
+// Segment layout: indices into the one LED strip
+#define OUTER_FIRST       0
+#define OUTER_LEN         BOARD_OUTER_LEDS
+#define INNER_FRONT_FIRST (OUTER_FIRST + OUTER_LEN)
+#define INNER_FRONT_LEN   BOARD_INNER_FRONT_LEDS
+#define INNER_BACK_FIRST  (INNER_FRONT_FIRST + INNER_FRONT_LEN)
+#define INNER_BACK_LEN    BOARD_INNER_BACK_LEDS
+#define GEOMETRY_LED_COUNT (INNER_BACK_FIRST + INNER_BACK_LEN)
+
+struct RingTables {
+  uint8_t angle[OUTER_LEN];    // position round the ring, 256 = one turn
+  uint8_t opposite[OUTER_LEN]; // LED half a turn away
+  uint8_t next[OUTER_LEN];     // clockwise neighbour
+  uint8_t prev[OUTER_LEN];     // anticlockwise neighbour
+  uint8_t x[GEOMETRY_LED_COUNT];
+  uint8_t y[GEOMETRY_LED_COUNT];
+
+  constexpr RingTables() : angle(), opposite(), next(), prev(), x(), y() {
+    for (uint8_t i = 0; i < OUTER_LEN; i++) {
+      angle[i] = (uint16_t)i * 256 / OUTER_LEN;
+      opposite[i] = (i + OUTER_LEN / 2) % OUTER_LEN;
+      next[i] = (i + 1) % OUTER_LEN;
+      prev[i] = (i + OUTER_LEN - 1) % OUTER_LEN;
+      x[OUTER_FIRST + i] = constCos8(angle[i]);
+      y[OUTER_FIRST + i] = constSin8(angle[i]);
+    }
+    for (uint8_t i = 0; i < INNER_FRONT_LEN + INNER_BACK_LEN; i++) {
+      x[INNER_FRONT_FIRST + i] = boardInnerXY[2 * i];
+      y[INNER_FRONT_FIRST + i] = boardInnerXY[2 * i + 1];
+    }
+  }
+};
+
+extern const RingTables geometry PROGMEM;
+
+// Outer ring lookups; i is an index into leds_outer
+inline uint8_t ringAngle(uint8_t i)    { return pgm_read_byte(&geometry.angle[i]); }
+inline uint8_t ringOpposite(uint8_t i) { return pgm_read_byte(&geometry.opposite[i]); }
+inline uint8_t ringNext(uint8_t i)     { return pgm_read_byte(&geometry.next[i]); }
+inline uint8_t ringPrev(uint8_t i)     { return pgm_read_byte(&geometry.prev[i]); }
+
+// Face position of any LED; led is an index into the whole strip
+inline uint8_t ledX(uint8_t led) { return pgm_read_byte(&geometry.x[led]); }
+inline uint8_t ledY(uint8_t led) { return pgm_read_byte(&geometry.y[led]); }
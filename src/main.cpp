@@ -5,93 +5,130 @@
 */
 
 #include <Arduino.h>
-#include <Bounce2.h> 
 #include <FastLED.h> // re: below, see https://github.com/FastLED/FastLED/issues/1754
-#include <EEPROM.h>
+
+#include "battery.h"
+#include "beat.h"
+#include "bench.h"
+#include "buttons.h"
+#include "compositor.h"
+#include "envelope.h"
+#include "geometry.h"
+#include "output.h"
+#include "palettes.h"
+#include "pattern.h"
+#include "power.h"
+#include "scheduler.h"
+#include "segment.h"
+#include "settings.h"
+#include "state.h"
+#include "stream.h"
+#include "telemetry.h"
+#include "tempo.h"
+#include "transition.h"
+#include "vm.h"
+#include "wavetable.h"
 
 // Hardware specific macros
 #define BTN_1_PIN 3 // megaTinyCore # for PA7
 #define BTN_2_PIN 8 // megaTinyCore # for PB1
 #define DATA_PIN 1 // megaTinyCore # for PA5
-#define NUM_LEDS 20
+#define DOUBLE_PRESS_BUTTONS BUTTON_MASK(BUTTON_1) // step back; button 2 answers on release
+// LUMA_AUDIO builds need a microphone (biased to VDD/2) on an ADC pin, given as MIC_PIN; the pendant PCB has none
+#if defined(LUMA_AUDIO) && !defined(MIC_PIN)
+#error "LUMA_AUDIO needs MIC_PIN, the megaTinyCore # of the microphone's ADC pin"
+#endif
+// LUMA_STREAM builds show frames sent over USART0 (stream.h), which the bench uses for its report
+#if defined(LUMA_STREAM) && defined(LUMA_BENCH)
+#error "LUMA_STREAM and LUMA_BENCH both need USART0"
+#endif
+// LUMA_TELEMETRY builds answer report requests on USART0 (telemetry.h)
+#if defined(LUMA_TELEMETRY) && defined(LUMA_STREAM)
+#error "LUMA_TELEMETRY and LUMA_STREAM both need USART0"
+#endif
+#if defined(LUMA_TELEMETRY) && defined(LUMA_BENCH)
+#error "LUMA_TELEMETRY and LUMA_BENCH both need USART0"
+#endif
+#define NUM_LEDS GEOMETRY_LED_COUNT // from the board profile (boards.h)
 #define ANIMATION_FPS 129 // This is the typical BPM of EDM music
-#define EEPROM_ADDR_OUTER 0
-#define EEPROM_ADDR_INNER 1
-#define EEPROM_ADDR_BRIGHTNESS 2
 #define ARRAY_SIZE(A) (sizeof(A) / sizeof((A)[0]))
 
 // Global brightness macros
 #define BRIGHTNESS_CYCLE_LEN 4
 
 // LED Segments - Use to simplify control of outer/acrylic front/back
-CRGB leds_raw[NUM_LEDS];
-CRGBSet leds(leds_raw, NUM_LEDS);
-CRGBSet leds_outer(leds(0, 15)); 
-CRGBSet leds_inner_front(leds(16, 17)); 
-CRGBSet leds_inner_back(leds(18, 19));
+// Patterns draw into leds_raw at full scale; compositorRun() fills leds_out, which is what gets shown
+PENDANT_STATE CRGB leds_raw[NUM_LEDS];
+// leds_outer, leds_inner_front and leds_inner_back are the segments of leds_raw (segment.h)
+PENDANT_STATE CRGB leds_out[NUM_LEDS];
 
 // Pattern specific global variables
-Bounce button_1 = Bounce(); 
-Bounce button_2 = Bounce();
+PENDANT_STATE uint8_t outerCurrentPattern = 0; // Index number of which pattern is current
+PENDANT_STATE uint8_t innerCurrentPattern = 0; // Index number of which pattern is current
 
-uint8_t outerCurrentPattern = 0; // Index number of which pattern is current
-uint8_t innerCurrentPattern = 0; // Index number of which pattern is current
-uint8_t outerHuePosition = 0;    // Rotating "base color" used by many of the patterns
-uint8_t innerHuePosition = 0;    // Rotating "base color" used by many of the patterns
-int outerLEDPosition = 0;        // Marker for point-based animations
+// Entry 0 of both lists is the auto-cycle: it shows the other pairs in turn, moving on at the
+// first bar line after AUTO_CYCLE_MS.  It is not a pattern itself, so it has no function.
+#define AUTO_CYCLE nullptr
+#define AUTO_CYCLE_MS 10000
+#define AUTO_CYCLE_FIRST 2           // skips the first two pairs
+PENDANT_STATE uint8_t autoCyclePair = 0;           // pair the auto-cycle shows; 0 while it is not selected
+PENDANT_STATE uint32_t autoCycleChangedMs = 0;
 
 // Patter brightness specific global variables
-uint8_t brightnessLevelIndex = 0;     // Used to iterate through the button 2 brightness level presses
+PENDANT_STATE uint8_t brightnessLevelIndex = 0;     // Used to iterate through the button 2 brightness level presses
 
 const uint8_t BRIGHTNESS_LEVELS_OUTER[BRIGHTNESS_CYCLE_LEN] = {20, 50, 100, 0};
 const uint8_t BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[BRIGHTNESS_CYCLE_LEN] = {25, 75, 150, 0};
 const uint8_t BRIGHTNESS_LEVELS_INNER_FRONT[BRIGHTNESS_CYCLE_LEN] = {10, 60, 125, 125};
 const uint8_t BRIGHTNESS_LEVELS_INNER_BACK[BRIGHTNESS_CYCLE_LEN] = {10, 60, 125, 125};
 
-uint8_t BRIGHTNESS_OUTER = BRIGHTNESS_LEVELS_OUTER[0];                       // Sets the "Low" brightness level for the outer leds
-uint8_t BRIGHTNESS_OUTER_PULSE_HEAD = BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[0]; // Sets the "Low" brightness level for the pulse heads 
-uint8_t BRIGHTNESS_INNER_FRONT = BRIGHTNESS_LEVELS_INNER_FRONT[0];           // Sets the "Low" brightness level for the inner front leds
-uint8_t BRIGHTNESS_INNER_BACK = BRIGHTNESS_LEVELS_INNER_BACK[0];             // Sets the "Low" brightness level for the inner back leds
+PENDANT_STATE uint8_t BRIGHTNESS_OUTER = BRIGHTNESS_LEVELS_OUTER[0];                       // Sets the "Low" brightness level for the outer leds
+PENDANT_STATE uint8_t BRIGHTNESS_OUTER_PULSE_HEAD = BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[0]; // Sets the "Low" brightness level for the pulse heads 
+PENDANT_STATE uint8_t BRIGHTNESS_INNER_FRONT = BRIGHTNESS_LEVELS_INNER_FRONT[0];           // Sets the "Low" brightness level for the inner front leds
+PENDANT_STATE uint8_t BRIGHTNESS_INNER_BACK = BRIGHTNESS_LEVELS_INNER_BACK[0];             // Sets the "Low" brightness level for the inner back leds
+
+// The brightest tier the cells can still carry at each battery level (see battery.h)
+const uint8_t BATTERY_TIER_CAP[BATTERY_LEVEL_COUNT] = {2, 1, 0, 0};
 
 
 
 
 // Need to forward declarations for the patterns here -- update with new patterns
 // Outer patterns
-void wispyRainbow();
-void berlinMode();
-void cyanMode();
-void magentaMode();
-void wmTiamat();
-void sinelonDualEffect();
-void bpm();
-void bpmFlood();
-void outerCycle();
+void wispyRainbow(const FrameContext& frame);
+void berlinMode(const FrameContext& frame);
+void cyanMode(const FrameContext& frame);
+void magentaMode(const FrameContext& frame);
+void wmTiamat(const FrameContext& frame);
+void sinelonDualEffect(const FrameContext& frame);
+void bpm(const FrameContext& frame);
+void bpmFlood(const FrameContext& frame);
 
 // Inner patterns
-void innerCycle();
-void innerCrossfadePalette();
-void innerCrossfadeRedWhite();
-void innerCrossfadeOrangeCyan();
-void innerCrossfadeMagentaTurquoise();
-void innerEDMSoundReactive_Rainbow();
-void innerEDMSoundReactive_Cyan();
-void innerEDMSoundReactive_Magenta();
-void innerComplementaryCycle();
+void innerCrossfadePalette(const FrameContext& frame);
+void innerCrossfadeRedWhite(const FrameContext& frame);
+void innerCrossfadeOrangeCyan(const FrameContext& frame);
+void innerCrossfadeMagentaTurquoise(const FrameContext& frame);
+void innerEDMSoundReactive_Rainbow(const FrameContext& frame);
+void innerEDMSoundReactive_Cyan(const FrameContext& frame);
+void innerEDMSoundReactive_Magenta(const FrameContext& frame);
+void innerComplementaryCycle(const FrameContext& frame);
 
 // Helper functions
+void applyBrightnessLevel();
+void showSelected();
 void dualSinePulsePattern(uint8_t red, uint8_t green, uint8_t blue);
-void washingMachineEffect(CRGBPalette16 palette);
+void washingMachineEffect(const FrameContext& frame, PaletteId paletteId);
 
 /*
  * List of patterns to cycle through on button press.  Each is defined as a separate function below.
  * The outer patterns and the inner patters will be 1-to-1.
  */
 
-typedef void (*PatternList[])();
+typedef PatternFn PatternList[];
 
 PatternList outerPatternList = {
-  outerCycle,
+  AUTO_CYCLE,
   wispyRainbow,
   berlinMode, 
   cyanMode, 
@@ -99,11 +136,12 @@ PatternList outerPatternList = {
   wmTiamat, 
   sinelonDualEffect, 
   bpm, 
-  bpmFlood
+  bpmFlood,
+  vmPattern<VM_PROGRAM_EEPROM> // bytecode from the EEPROM (vm.h); a comet until one is written
 }; 
 
 PatternList innerPatternList = { 
-  innerCycle,                     // outerCycle
+  AUTO_CYCLE,
   innerComplementaryCycle,        // wispyRainbow
   innerCrossfadeRedWhite,         // berlin mode
   innerCrossfadeOrangeCyan,       // cyanMode
@@ -112,330 +150,244 @@ PatternList innerPatternList = {
   innerCrossfadePalette,          // sinelonDualEffect
   innerEDMSoundReactive_Rainbow,  // bpm
   innerCrossfadePalette,  // bpmFlood
+  innerCrossfadePalette,          // EEPROM bytecode
 }; 
 
-/* 
- ---  Custom Palette Definitions ---
-*/
-
-// rainbow for various patterns, heavily tweaked to look ok on the tomorrowland pendant outer ring
-DEFINE_GRADIENT_PALETTE(rainbowLoopAgroGamma) {
-      0, 255,   0,   0,   // Red 
-     21, 255,  60,   0,   // Red-Orange 
-     42, 220, 128,   0,   // Yellow 
-     63,  80, 255,   0,   // Yellow-Green 
-     85,   0, 255,   0,   // Green 
-    106,   0, 255, 128,   // Green-Cyan
-    127,   0, 220, 255,   // Cyan 
-    148,   0,  80, 255,   // Cyan-Blue
-    169,   0,   0, 255,   // Blue 
-    190,  20,   0, 255,   // Blue-Violet
-    211, 128,   0, 120,   // Magenta 
-    232, 255,   0,  20,   // Magenta-Red
-    255, 255,   0,   0    // Red (back to zero)
-};
-
-CRGBPalette16 myRainbowPalette = rainbowLoopAgroGamma;
-
-// Tiamat palette adapted from WLED
-// A bright meteor with blue, teal and magenta hues
-DEFINE_GRADIENT_PALETTE(tiamatAgroGamma) {
-    0,   1,  2, 14,   // Very dark navy (nearly black-blue)
-   33,   2,  5, 35,   // Midnight blue
-  100,  13,135, 92,   // Teal green (deep jade)
-  120,  43,255,193,   // Bright aqua mint
-  140, 247,  7,249,   // Neon pink-violet
-  160, 193, 17,208,   // Electric purple
-  180,  39,255,154,   // Bright seafoam green
-  200,   4,213,236,   // Electric cyan (vivid)
-  220,  39,252,135,   // Bright spring green
-  240, 193,213,253,   // Light periwinkle / icy blue
-  255, 255,249,255    // Near white with pink tint (pastel)
-};
-
-CRGBPalette16 tiamatPalette = tiamatAgroGamma;
-
-// Yelmag-inspired palette (warm yellows with magenta and red)
-DEFINE_GRADIENT_PALETTE(yelmagAgroGamma) {
-    0,   0,   0,   0, // Black
-   42, 113,   0,   0, // Dark Red / Maroon
-   84, 255,   0,   0, // Pure Red
-  127, 255,   0, 117, // Hot Pink / Red-Magenta mix
-  170, 255,   0, 255, // Magenta
-  212, 255, 128, 117, // Light Red-Orange / Coral
-  255, 255, 255,   0  // Yellow
-};
-
-CRGBPalette16 yelmagPalette = yelmagAgroGamma;
-
-// Sherbet palette from WLED (soft pinks, oranges, and whites)
-DEFINE_GRADIENT_PALETTE(rainbowSherbetAgroGamma) {
-    0,   255, 102,  41,   // dark orange
-   43,   255, 140,  90,   // peach
-   86,   255,  51,  90,   // hot pink
-  127,   255, 153, 169,   // soft pink
-  170,   255, 255, 249,   // off-white
-  209,   113, 255,  85,   // green-lime
-  255,   157, 255, 137    // mint-lime
-};
-
-CRGBPalette16 sherbetPalette = rainbowSherbetAgroGamma;
+// Exported so host tools (lib/NativeHost) can walk the lists
+extern const uint8_t OUTER_PATTERN_COUNT = ARRAY_SIZE(outerPatternList);
+extern const uint8_t INNER_PATTERN_COUNT = ARRAY_SIZE(innerPatternList);
+static_assert(ARRAY_SIZE(outerPatternList) == ARRAY_SIZE(innerPatternList), "the auto-cycle steps both lists together");
+static_assert(ARRAY_SIZE(outerPatternList) <= TELEMETRY_MAX_PATTERNS, "telemetry.h keeps counters for every pattern");
 
 void setup() {
-  FastLED.addLeds<WS2812,DATA_PIN,GRB>(leds, NUM_LEDS);
-
-  pinMode(BTN_1_PIN,INPUT_PULLUP);
-  button_1.attach(BTN_1_PIN);
-  button_1.interval(100); // interval in ms
-  
-  pinMode(BTN_2_PIN,INPUT_PULLUP);
-  button_2.attach(BTN_2_PIN);
-  button_2.interval(100); // interval in ms
-
-  // Read saved pattern indices
-  outerCurrentPattern = EEPROM.read(EEPROM_ADDR_OUTER);
-  innerCurrentPattern = EEPROM.read(EEPROM_ADDR_INNER);
-  brightnessLevelIndex = EEPROM.read(EEPROM_ADDR_BRIGHTNESS);
-
-  // Safety bounds check
-  if (outerCurrentPattern >= ARRAY_SIZE(outerPatternList)) outerCurrentPattern = 0;
-  if (innerCurrentPattern >= ARRAY_SIZE(innerPatternList)) innerCurrentPattern = 0;
-
-  BRIGHTNESS_OUTER = BRIGHTNESS_LEVELS_OUTER[brightnessLevelIndex];
-  BRIGHTNESS_OUTER_PULSE_HEAD = BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[brightnessLevelIndex];
-  BRIGHTNESS_INNER_FRONT = BRIGHTNESS_LEVELS_INNER_FRONT[brightnessLevelIndex];
-  BRIGHTNESS_INNER_BACK = BRIGHTNESS_LEVELS_INNER_BACK[brightnessLevelIndex];
-}
-
-// This is not used here - but we need to add it in order to support FastLED requirements
-volatile unsigned long timer_millis = 0;
-void update_millis() {
-    static unsigned long last_micros = 0;
-    unsigned long current_micros = micros();
-    if (current_micros - last_micros >= 1000) {
-        timer_millis++;
-        last_micros = current_micros;
-    }
+  FastLED.addLeds<WS2812,DATA_PIN,GRB>(leds_out, NUM_LEDS);
+  compositorBegin(leds_raw, leds_out);
+  vmBegin(leds_raw);
+
+  buttonsBegin(BTN_1_PIN, BTN_2_PIN, DOUBLE_PRESS_BUTTONS);
+  batteryBegin();
+#ifdef LUMA_AUDIO
+  beatBegin(MIC_PIN);
+#endif
+#ifdef LUMA_STREAM
+  streamBegin();
+#endif
+
+  // Read saved pattern indices and brightness (each checked against its list)
+  const Settings& saved = settingsBegin({ARRAY_SIZE(outerPatternList), ARRAY_SIZE(innerPatternList), BRIGHTNESS_CYCLE_LEN});
+  outerCurrentPattern = saved.outerPattern;
+  innerCurrentPattern = saved.innerPattern;
+  brightnessLevelIndex = saved.brightness;
+
+  applyBrightnessLevel();
+
+  schedulerBegin(ANIMATION_FPS); // also starts the RTC timebase the tempo clock runs on
+  tempoBegin();
+  showSelected(); // nothing is showing yet, so no fade
+  telemetryBegin(ARRAY_SIZE(outerPatternList), ANIMATION_FPS);
+
+#ifdef LUMA_BENCH
+  benchRun(1000/ANIMATION_FPS, leds_out, NUM_LEDS);
+#endif
 }
 
-// native SetBrightness() does not accept a CRGBSet
-void setSegBrightness(CRGBSet& segment, uint8_t brightness) {
-  for (uint16_t i = 0; i < segment.len; i++) {
-    segment[i].r = scale8(segment[i].r, brightness);
-    segment[i].g = scale8(segment[i].g, brightness);
-    segment[i].b = scale8(segment[i].b, brightness);
-  }
-}
 
 /* 
  --- Outer LED Patterns ---
 */
 
-#define PULSE_DECAY 0.85f // Fade by % each step
-
-void dualSinePulsePattern(uint8_t red, uint8_t green, uint8_t blue) {
-  // This is a master timer that moves the waves. The number controls the speed.
-  uint8_t master_phase = beat8(15);
-
-  for (int i = 0; i < leds_outer.len; i++) {
-    // Map the LED's physical position to a point on a circle (0-255).
-    uint8_t led_angle = map(i, 0, leds_outer.len, 0, 255);
+#define PULSE_DECAY ENV_KEEP(0.85) // Fade by % each step
 
-    // Calculate the brightness from the two opposing waves.
-    uint8_t brightness1 = sin8(led_angle + master_phase);
-    uint8_t brightness2 = sin8(led_angle + master_phase + 128);
+// These patterns used to apply BRIGHTNESS_OUTER twice (in the color and again per LED);
+// scaling by the "High" outer level keeps that setting looking the same
+#define DUAL_SINE_SCALING 100
 
-    // Take the brighter of the two waves as our base.
-    uint8_t raw_brightness = max(brightness1, brightness2);
+void dualSinePulsePattern(uint8_t red, uint8_t green, uint8_t blue) {
+  // This is a master timer that moves the waves: once round every two bars
+  uint8_t master_phase = tempoCycle8(TEMPO_2_BARS);
 
-    // Extra contrast boost and smooth easing.
-    uint8_t contrast_brightness = scale8(raw_brightness, raw_brightness);
-    contrast_brightness = scale8(contrast_brightness, contrast_brightness); // extra contrast
-    uint8_t eased_brightness = ease8InOutCubic(contrast_brightness);
+  leds_outer.each([&](auto i, CRGB& led) {
+    // The brighter of two opposing sine waves at the LED's position round the circle,
+    // contrast boosted and eased (WAVE_DUAL_PULSE)
+    uint8_t eased_brightness = wave8(WAVE_DUAL_PULSE, ringAngle(i) + master_phase);
 
     // Apply the specified color, scaled by our adjusted brightness.
-    leds_outer[i] = CRGB(red, green, blue);
-    leds_outer[i].nscale8(scale8(eased_brightness, BRIGHTNESS_OUTER));
-  }
+    led = CRGB(red, green, blue);
+    led.nscale8(eased_brightness);
+  });
+  compositorScale(SEGMENT_OUTER, DUAL_SINE_SCALING);
 }
 
 
 // Wispy Dynamic Rainbow Spin Pattern
-void wispyRainbow() {
+struct WispyState {
+  uint8_t hue;          // Rotating "base color"
+  uint8_t head;         // LED the head is on
+  uint16_t sinceMove;   // ms since the head last moved
+  uint16_t hueTimer;
+  uint16_t fadeTimer;
+};
+
+void wispyRainbow(const FrameContext& frame) {
+  WispyState& state = patternState<WispyState>(frame);
   const uint8_t WISPY_BRIGHTNESS_SCALING = 150;
   // set outer_led to have a rainbow pattern
   //fill_rainbow(leds_outer, leds_outer.len, 0, 360/leds_outer.len, 240, 100);
-  for (int i = 0; i < leds_outer.len; i++) {
-    uint8_t colorIndex = (outerHuePosition + (i * (256 / leds_outer.len))) % 256;
-    leds_outer[i] = ColorFromPalette(myRainbowPalette, colorIndex, 110, LINEARBLEND);
-  }
-  setSegBrightness(leds_outer, scale8(BRIGHTNESS_OUTER, WISPY_BRIGHTNESS_SCALING));
-  EVERY_N_MILLISECONDS( 20 ) { outerHuePosition++; }
+  const CRGBPalette16& palette = paletteGet(PALETTE_RAINBOW);
+  leds_outer.each([&](auto i, CRGB& led) {
+    uint8_t colorIndex = state.hue + ringAngle(i);
+    led = ColorFromPalette(palette, colorIndex, 110, LINEARBLEND);
+  });
+  compositorScale(SEGMENT_OUTER, WISPY_BRIGHTNESS_SCALING);
+  state.hue += patternEvery(state.hueTimer, 20, frame);
 
   // set the head
-  leds_outer[outerLEDPosition] = leds_outer[outerLEDPosition].nscale8_video(BRIGHTNESS_OUTER_PULSE_HEAD);
+  leds_outer[state.head] = leds_outer[state.head].nscale8_video(BRIGHTNESS_OUTER_PULSE_HEAD);
 
   // set the opposing head
-  int oppositePos = (outerLEDPosition + leds_outer.len / 2) % leds_outer.len;
+  uint8_t oppositePos = ringOpposite(state.head);
   leds_outer[oppositePos] = leds_outer[oppositePos].nscale8_video(BRIGHTNESS_OUTER_PULSE_HEAD);
 
-   // move the head with dynamic movement speed using a sine wave
-  static uint16_t lastMoveTime = 0;
-  uint16_t now = millis();
-
-  // Speed oscillates between 30ms and 150ms per move at ~0.25Hz (i.e., ~4s full cycle)
-  uint16_t dynamicSpeed = beatsin16(15, 30, 150); 
+  // move the head with dynamic movement speed using a sine wave
+  // Speed oscillates between 30ms and 150ms per move, once every two bars (3.75 s at 128 BPM)
+  uint16_t dynamicSpeed = tempoSin16(TEMPO_2_BARS, 30, 150);
 
-  if (now - lastMoveTime > dynamicSpeed) {
-    outerLEDPosition = (outerLEDPosition + 1) % leds_outer.len;
-    lastMoveTime = now;
+  state.sinceMove += frame.dt;
+  if (state.sinceMove > dynamicSpeed) {
+    state.head = ringNext(state.head);
+    state.sinceMove = 0;
   }
 
   // dim the tail
-  EVERY_N_MILLISECONDS(50) {
-    for (int i = 0; i < leds_outer.len; i++) {
-      leds_outer[i].r = (uint8_t)(leds_outer[i].r * PULSE_DECAY);
-      leds_outer[i].g = (uint8_t)(leds_outer[i].g * PULSE_DECAY);
-      leds_outer[i].b = (uint8_t)(leds_outer[i].b * PULSE_DECAY);
-    }
+  if (patternEvery(state.fadeTimer, 50, frame)) {
+    envFade(leds_outer, leds_outer.len, PULSE_DECAY);
   }
 }
 
-void berlinMode() {
+void berlinMode(const FrameContext&) {
   const uint8_t BERLIN_BRIGHTNESS_SCALING = 200;  // Adjust this value (0–255)
-  uint8_t scaledBrightness = scale8(BRIGHTNESS_OUTER, BERLIN_BRIGHTNESS_SCALING);
-  dualSinePulsePattern(scaledBrightness, 0, 0);
+  dualSinePulsePattern(BERLIN_BRIGHTNESS_SCALING, 0, 0);
 }
 
-void cyanMode() {
-  dualSinePulsePattern(0, BRIGHTNESS_OUTER, BRIGHTNESS_OUTER);
+void cyanMode(const FrameContext&) {
+  dualSinePulsePattern(0, 255, 255);
 }
 
-void magentaMode() {
-  dualSinePulsePattern(BRIGHTNESS_OUTER, 0, BRIGHTNESS_OUTER);
+void magentaMode(const FrameContext&) {
+  dualSinePulsePattern(255, 0, 255);
 }
 
+// Trails of the moving-dot patterns: what fadeToBlackBy(20) every frame gave at ANIMATION_FPS, per ms
+// so that it looks the same at any frame rate (with envExpDecay8(frame.dt, TRAIL_DECAY_RATE))
+#define TRAIL_DECAY_RATE ENV_DECAY_RATE(95, 1)
+
 // Imitates a washing machine, rotating same waves forward,
 // then pause, then backwards.
 // Adapted from WLED: https://github.com/wled/WLED/blob/main/wled00/FX.cpp#L4478
-void washingMachineEffect(CRGBPalette16 palette) {
-  static uint8_t wmSpeed = 8;                     // Lower is slower
-  uint8_t wmIntensity = BRIGHTNESS_OUTER;  // Brightness peak (0–255)
-  static CRGBPalette16 wmPalette = palette;
+void washingMachineEffect(const FrameContext& frame, PaletteId paletteId) {
+  const TempoCycle wmCycle = TEMPO_4_BARS;       // Longer is slower
+  uint8_t wmIntensity = 255;               // Brightness peak (0–255)
 
   // Position moves back and forth like a washer drum oscillating
-  uint16_t pos = beatsin16(wmSpeed, 0, leds_outer.len - 1);
-  // Brightness pulsing
-  uint8_t bri = beatsin8(wmSpeed * 2, wmIntensity / 4, wmIntensity);
+  uint16_t pos = tempoSin16(wmCycle, 0, leds_outer.len - 1);
+  // Brightness pulsing, twice as fast
+  uint8_t bri = tempoSin8(TempoCycle(wmCycle - 1), wmIntensity / 4, wmIntensity);
 
   // Fade existing frame for trailing effect
-  fadeToBlackBy(leds_outer, leds_outer.len, 20);
+  envFade(leds_outer, leds_outer.len, envExpDecay8(frame.dt, TRAIL_DECAY_RATE));
 
   // Main color from palette
-  CRGB c = ColorFromPalette(wmPalette, (uint8_t)(pos * (255 / leds_outer.len)), bri);
+  CRGB c = ColorFromPalette(paletteGet(paletteId), ringAngle(pos), bri);
 
   // Light up the head
   leds_outer[pos] = c;
 
   // Light up the opposing head (180 degrees apart)
-  uint16_t pos2 = (pos + leds_outer.len / 2) % leds_outer.len;
+  uint8_t pos2 = ringOpposite(pos);
   leds_outer[pos2] = c;
 }
 
-void wmTiamat() {
-  washingMachineEffect(tiamatPalette);
+void wmTiamat(const FrameContext& frame) {
+  washingMachineEffect(frame, PALETTE_TIAMAT);
 }
 
 
 // Dual Sinelon effect for leds_outer
-void sinelonDualEffect() {
-  // Static state variables
-  static uint8_t beatA = 10;        // speed of first comet
-  static uint8_t beatB = 7;         // speed of second comet
-  static uint8_t indexA = 0;        // Color index A
-  static uint8_t indexB = 127;      // Color index B
+struct SinelonState {
+  uint8_t indexA;     // Color index A
+  uint8_t indexB;     // Color index B
+  uint16_t timer;
+};
+
+void sinelonDualEffect(const FrameContext& frame) {
+  SinelonState& state = patternState<SinelonState>(frame);
+  const TempoCycle cycleA = TEMPO_2_BARS; // period of first comet
+  const TempoCycle cycleB = TEMPO_4_BARS; // period of second comet
+  if (frame.start) state.indexB = 127;
 
   // Fade existing frame by a small amount for trails
-  fadeToBlackBy(leds_outer, leds_outer.len, 20);
+  envFade(leds_outer, leds_outer.len, envExpDecay8(frame.dt, TRAIL_DECAY_RATE));
 
   // Calculate positions using sinewave / ping-pong motion
-  uint16_t posA = beatsin16(beatA, 0, leds_outer.len - 1);
-  uint16_t posB = beatsin16(beatB, 0, leds_outer.len - 1);
-
-  // Colors from Sherbet palette
-  for (int i = 0; i < leds_outer.len; i++) {
-    uint8_t colorIndexA = (indexA + (i * (256 / leds_outer.len))) % 256;
-    uint8_t colorIndexB = (indexB + (i * (256 / leds_outer.len))) % 256;
-    leds_outer[posA] = ColorFromPalette(sherbetPalette, colorIndexA, 110, LINEARBLEND);
-    leds_outer[posB] = ColorFromPalette(sherbetPalette, colorIndexB, 110, LINEARBLEND);
-  }
-  leds_outer[posA].nscale8(BRIGHTNESS_OUTER);
-  leds_outer[posB].nscale8(BRIGHTNESS_OUTER);
+  uint16_t posA = tempoSin16(cycleA, 0, leds_outer.len - 1);
+  uint16_t posB = tempoSin16(cycleB, 0, leds_outer.len - 1);
+
+  // Colors from Sherbet palette. Only the two heads are drawn, so look the colors up once
+  // (at the offset of the last LED, which is what the old per-LED loop ended up keeping)
+  uint8_t colorOffset = ringAngle(OUTER_LEN - 1);
+  const CRGBPalette16& palette = paletteGet(PALETTE_SHERBET);
+  leds_outer[posA] = ColorFromPalette(palette, state.indexA + colorOffset, 110, LINEARBLEND);
+  leds_outer[posB] = ColorFromPalette(palette, state.indexB + colorOffset, 110, LINEARBLEND);
 
   // Advance palette indices slowly
-  EVERY_N_MILLISECONDS(20) {
-    indexA += 1;
-    indexB += 1;
-  }
+  uint8_t steps = patternEvery(state.timer, 20, frame);
+  state.indexA += steps;
+  state.indexB += steps;
 }
 
 // colored stripes pulsing at a defined Beats-Per-Minute (BPM)
-void bpm() {
+void bpm(const FrameContext&) {
   const uint8_t BPM_BRIGHTNESS_SCALING = 150;
-  uint8_t BeatsPerMinute = 32;
-  uint8_t beat = beatsin8(BeatsPerMinute, 64, 255);
-  for (int i = 0; i < leds_outer.len; i++) {
-    uint8_t colorIndex = (outerHuePosition + (i * (256 / leds_outer.len))) % 256;
-    leds_outer[i] = ColorFromPalette(myRainbowPalette, colorIndex, beat-1+(i*10), LINEARBLEND);
-    leds_outer[i].nscale8(scale8(BRIGHTNESS_OUTER, BPM_BRIGHTNESS_SCALING));
-  }
+  uint8_t beat = tempoSin8(TEMPO_BAR, 64, 255, 64); // one cycle a bar, peaking on the downbeat
+  const CRGBPalette16& palette = paletteGet(PALETTE_RAINBOW);
+  leds_outer.each([&](auto i, CRGB& led) {
+    uint8_t colorIndex = ringAngle(i);
+    led = ColorFromPalette(palette, colorIndex, beat-1+(i*10), LINEARBLEND);
+  });
+  compositorScale(SEGMENT_OUTER, BPM_BRIGHTNESS_SCALING);
 }
 
 // All outer leds pulsing at a defined Beats-Per-Minute (BPM)
-void bpmFlood() {
+void bpmFlood(const FrameContext&) {
   const uint8_t BPM_BRIGHTNESS_SCALING = 150;
-  uint8_t BeatsPerMinute = 32;
-  uint8_t beat = beatsin8(BeatsPerMinute, 32, 128);
-  CRGB color = ColorFromPalette(myRainbowPalette, beat, 110);
+  uint8_t beat = tempoSin8(TEMPO_BAR, 32, 128, 64);
+  CRGB color = ColorFromPalette(paletteGet(PALETTE_RAINBOW), beat, 110);
   fill_solid(leds_outer, leds_outer.len, color);
-  setSegBrightness(leds_outer, scale8(BRIGHTNESS_OUTER, BPM_BRIGHTNESS_SCALING));
-}
-
-void outerCycle() {
-  void (**outerPatternListCycle)() = outerPatternList;
-  static uint8_t current = 2; // Start at index 2 to avoid first two patterns
-  static unsigned long lastChangeTime = 0;
-  static bool firstRun = true;
-
-  // Call the current pattern
-  outerPatternListCycle[current]();
-
-  // Every 10 seconds, advance to the next pattern, or on first run
-  unsigned long now = millis();
-  if (now - lastChangeTime >= 10000 || firstRun) {
-    lastChangeTime = now;
-    current++;
-    if (current >= ARRAY_SIZE(outerPatternList)) current = 1;
-    FastLED.clear();  // Optional: wipe leftover LEDs when switching
-    firstRun = false;
-  }
+  compositorScale(SEGMENT_OUTER, BPM_BRIGHTNESS_SCALING);
 }
 
+
 /* 
  --- Inner LED Patterns ---
 */
 
-void innerCrossfadePalette() {
-  // --- Static variables to hold state ---
-  static uint8_t back_palette_index = 0;
-  static uint8_t front_palette_index = 1; // Start one step ahead for color separation
-  static bool back_is_active = false;
-  static bool front_is_active = false;
+struct CrossfadePaletteState {
+  uint8_t back_palette_index;
+  uint8_t front_palette_index;
+  bool back_is_active;
+  bool front_is_active;
+};
+
+void innerCrossfadePalette(const FrameContext& frame) {
+  // --- State, kept between frames ---
+  CrossfadePaletteState& state = patternState<CrossfadePaletteState>(frame);
+  if (frame.start) state.front_palette_index = 1; // Start one step ahead for color separation
+  // A slow fade: keyframes close enough together to land in the 2-step window that changes colour
+  patternKeyframeMs(24, PATTERN_INTERPOLATE);
 
   const uint8_t INNER_CROSSFADE_BRIGHTNESS_SCALING = 150;
 
   // --- TIMING & CONFIGURATION ---
-  const uint8_t BPM = 15;
   const uint8_t LED1_DURATION = 100;
   const uint8_t LED2_DURATION = 100;
   const uint8_t PALETTE_STEP = 50;
@@ -445,80 +397,75 @@ void innerCrossfadePalette() {
   const uint8_t FRONT_PANEL_OFFSET = 60; //TOTAL_CYCLE_DURATION / 2; // e.g., 80
 
   // --- Master Beat Timers ---
-  uint8_t back_beat = map(beat8(BPM), 0, 255, 0, TOTAL_CYCLE_DURATION);
+  uint8_t back_beat = map(tempoCycle8(TEMPO_2_BARS), 0, 255, 0, TOTAL_CYCLE_DURATION);
   // The front panel's timer is the same, just offset.
   uint8_t front_beat = (back_beat + FRONT_PANEL_OFFSET) % TOTAL_CYCLE_DURATION;
 
 
   // --- Helper function to calculate animation for a single panel ---
   // This avoids code duplication and keeps the logic clean.
-  auto calculatePanelAnimation = [](uint8_t beat, uint8_t duration1, uint8_t duration2, CRGB& color1, CRGB& color2, uint8_t& brightness1, uint8_t& brightness2) {
+  auto calculatePanelAnimation = [](uint8_t beat, uint8_t duration1, uint8_t duration2, CRGB&, CRGB&, uint8_t& brightness1, uint8_t& brightness2) {
     // Determine the start times based on the duration. This is just for calculation.
     const uint8_t start1 = 0;
     const uint8_t start2 = (duration1 / 2) - (duration1 / 4); // Overlap logic
 
     if ((beat >= start1) && (beat < (start1 + duration1))) {
         uint8_t progress = beat - start1;
-        uint8_t wave = triwave8(map(progress, 0, duration1 - 1, 0, 255));
-        brightness1 = ease8InOutCubic(wave);
+        brightness1 = wave8(WAVE_TRI_CUBIC, map(progress, 0, duration1 - 1, 0, 255));
     }
     if ((beat >= start2) && (beat < (start2 + duration2))) {
         uint8_t progress = beat - start2;
-        uint8_t wave = triwave8(map(progress, 0, duration2 - 1, 0, 255));
-        brightness2 = ease8InOutCubic(wave);
+        brightness2 = wave8(WAVE_TRI_CUBIC, map(progress, 0, duration2 - 1, 0, 255));
     }
   };
 
   // --- Color Assignment ---
   // Check if the BACK panel's animation is starting a new cycle
-  if (back_beat < 2 && !back_is_active) { // Use a small window to catch the start
-    back_is_active = true;
-    back_palette_index += (PALETTE_STEP * 2);
+  if (back_beat < 2 && !state.back_is_active) { // Use a small window to catch the start
+    state.back_is_active = true;
+    state.back_palette_index += (PALETTE_STEP * 2);
   } else if (back_beat > 2) {
-    back_is_active = false;
+    state.back_is_active = false;
   }
   // Check if the FRONT panel's animation is starting a new cycle
-  if (front_beat < 2 && !front_is_active) {
-    front_is_active = true;
-    front_palette_index += (PALETTE_STEP * 2);
+  if (front_beat < 2 && !state.front_is_active) {
+    state.front_is_active = true;
+    state.front_palette_index += (PALETTE_STEP * 2);
   } else if (front_beat > 2) {
-    front_is_active = false;
+    state.front_is_active = false;
   }
 
   // --- Brightness Calculation ---
-  CRGB back_color1 = ColorFromPalette(myRainbowPalette, back_palette_index, 255, LINEARBLEND);
-  CRGB back_color2 = ColorFromPalette(myRainbowPalette, back_palette_index + PALETTE_STEP, 255, LINEARBLEND);
+  const CRGBPalette16& palette = paletteGet(PALETTE_RAINBOW);
+  CRGB back_color1 = ColorFromPalette(palette, state.back_palette_index, 255, LINEARBLEND);
+  CRGB back_color2 = ColorFromPalette(palette, state.back_palette_index + PALETTE_STEP, 255, LINEARBLEND);
   uint8_t b_bright1 = 0, b_bright2 = 0;
   calculatePanelAnimation(back_beat, LED1_DURATION, LED2_DURATION, back_color1, back_color2, b_bright1, b_bright2);
 
-  CRGB front_color1 = ColorFromPalette(myRainbowPalette, front_palette_index, 255, LINEARBLEND);
-  CRGB front_color2 = ColorFromPalette(myRainbowPalette, front_palette_index + PALETTE_STEP, 255, LINEARBLEND);
+  CRGB front_color1 = ColorFromPalette(palette, state.front_palette_index, 255, LINEARBLEND);
+  CRGB front_color2 = ColorFromPalette(palette, state.front_palette_index + PALETTE_STEP, 255, LINEARBLEND);
   uint8_t f_bright1 = 0, f_bright2 = 0;
   calculatePanelAnimation(front_beat, LED1_DURATION, LED2_DURATION, front_color1, front_color2, f_bright1, f_bright2);
 
 
   // --- Apply final values ---
-  leds_inner_back[0] = back_color1;
-  leds_inner_back[0].nscale8(scale8(scale8(b_bright1, BRIGHTNESS_INNER_BACK), INNER_CROSSFADE_BRIGHTNESS_SCALING));
-  leds_inner_back[1] = back_color2;
-  leds_inner_back[1].nscale8(scale8(scale8(b_bright2, BRIGHTNESS_INNER_BACK), INNER_CROSSFADE_BRIGHTNESS_SCALING));
+  leds_inner_back.alternate(back_color1.nscale8(b_bright1), back_color2.nscale8(b_bright2));
+  leds_inner_front.alternate(front_color1.nscale8(f_bright1), front_color2.nscale8(f_bright2));
 
-  leds_inner_front[0] = front_color1;
-  leds_inner_front[0].nscale8(scale8(scale8(f_bright1, BRIGHTNESS_INNER_FRONT), INNER_CROSSFADE_BRIGHTNESS_SCALING));
-  leds_inner_front[1] = front_color2;
-  leds_inner_front[1].nscale8(scale8(scale8(f_bright2, BRIGHTNESS_INNER_FRONT), INNER_CROSSFADE_BRIGHTNESS_SCALING));
+  compositorScale(SEGMENT_INNER_BACK, INNER_CROSSFADE_BRIGHTNESS_SCALING);
+  compositorScale(SEGMENT_INNER_FRONT, INNER_CROSSFADE_BRIGHTNESS_SCALING);
 }
 
 void innerCrossfadeTwoColorCore(CRGB back_color, CRGB front_color) {
+  patternKeyframeMs(32, PATTERN_INTERPOLATE); // one sweep every two bars
   // --- TIMING & CONFIGURATION ---
-  const uint8_t BPM = 15;
   const uint8_t LED1_DURATION = 75;
   const uint8_t LED2_DURATION = 75;
   const uint8_t TOTAL_CYCLE_DURATION = 120;
   const uint8_t FRONT_PANEL_OFFSET = 40; //TOTAL_CYCLE_DURATION / 2; // 80
 
   // --- Master Beat Timers ---
-  uint8_t back_beat = map(beat8(BPM), 0, 255, 0, TOTAL_CYCLE_DURATION);
+  uint8_t back_beat = map(tempoCycle8(TEMPO_2_BARS), 0, 255, 0, TOTAL_CYCLE_DURATION);
   uint8_t front_beat = (back_beat + FRONT_PANEL_OFFSET) % TOTAL_CYCLE_DURATION;
 
   // --- Brightness variables (default to off) ---
@@ -534,13 +481,11 @@ void innerCrossfadeTwoColorCore(CRGB back_color, CRGB front_color) {
 
     if ((beat >= start1) && (beat < (start1 + duration1))) {
         uint8_t progress = beat - start1;
-        uint8_t wave = triwave8(map(progress, 0, duration1 - 1, 0, 255));
-        brightness1 = ease8InOutCubic(wave);
+        brightness1 = wave8(WAVE_TRI_CUBIC, map(progress, 0, duration1 - 1, 0, 255));
     }
     if ((beat >= start2) && (beat < (start2 + duration2))) {
         uint8_t progress = beat - start2;
-        uint8_t wave = triwave8(map(progress, 0, duration2 - 1, 0, 255));
-        brightness2 = ease8InOutCubic(wave);
+        brightness2 = wave8(WAVE_TRI_CUBIC, map(progress, 0, duration2 - 1, 0, 255));
     }
   };
 
@@ -549,29 +494,23 @@ void innerCrossfadeTwoColorCore(CRGB back_color, CRGB front_color) {
   calculatePanelBrightness(front_beat, LED1_DURATION, LED2_DURATION, front_brightness1, front_brightness2);
 
   // --- Apply final values ---
-  leds_inner_back[0] = back_color;
-  leds_inner_back[0].nscale8(scale8(back_brightness1, BRIGHTNESS_INNER_BACK));
-  leds_inner_back[1] = back_color;
-  leds_inner_back[1].nscale8(scale8(back_brightness2, BRIGHTNESS_INNER_BACK));
-
-  leds_inner_front[0] = front_color;
-  leds_inner_front[0].nscale8(scale8(front_brightness1, BRIGHTNESS_INNER_FRONT));
-  leds_inner_front[1] = front_color;
-  leds_inner_front[1].nscale8(scale8(front_brightness2, BRIGHTNESS_INNER_FRONT));
+  CRGB back_color2 = back_color, front_color2 = front_color;
+  leds_inner_back.alternate(back_color.nscale8(back_brightness1), back_color2.nscale8(back_brightness2));
+  leds_inner_front.alternate(front_color.nscale8(front_brightness1), front_color2.nscale8(front_brightness2));
 }
 
 // --- WRAPPER for Red/White Berlin Mode crossfade animation ---
-void innerCrossfadeRedWhite() {
+void innerCrossfadeRedWhite(const FrameContext&) {
   innerCrossfadeTwoColorCore(CRGB::Red, CRGB::White);
 }
 
 // --- WRAPPER for Orange/Cyan crossfade animation ---
-void innerCrossfadeOrangeCyan() {
+void innerCrossfadeOrangeCyan(const FrameContext&) {
   innerCrossfadeTwoColorCore(CRGB::Orange, CRGB::Cyan);
 }
 
 // --- WRAPPER for Magenta/Turquoise crossfade animation ---
-void innerCrossfadeMagentaTurquoise() {
+void innerCrossfadeMagentaTurquoise(const FrameContext&) {
   innerCrossfadeTwoColorCore(CRGB::Magenta, CRGB::Turquoise);
 }
 
@@ -579,33 +518,39 @@ void innerCrossfadeMagentaTurquoise() {
 // Complementary Rainbow Cycle
 // Slowly cycles through the rainbow, with the front and back panels
 // always showing complementary colors (180 degrees apart on the color wheel).
-void innerComplementaryCycle() {
+struct ComplementaryState {
+  uint8_t current_hue;
+  uint16_t hue_timer;
+  int8_t sparkle_led_index;   // Which LED is sparkling (-1 for none)
+  uint16_t sparkle_age;       // ms since the sparkle started
+};
+
+void innerComplementaryCycle(const FrameContext& frame) {
   // --- CONFIGURATION ---
   // Controls the speed of the color cycle. A higher number means a slower change.
   const uint8_t CYCLE_SPEED_MS = 50; 
   
   // --- SPARKLE CONFIGURATION (UPDATED) ---
-  // How often new sparkles can be triggered. Higher value = more sparkles.
-  const uint8_t SPARKLE_CHANCE = 4;
+  // How often new sparkles can be triggered, per ms in 1/65536ths. Higher value = more sparkles.
+  const uint8_t SPARKLE_CHANCE = 131; // about two a second
   // The brightness of the white sparkles.
   const uint8_t SPARKLE_BRIGHTNESS = 220;
   // How long each sparkle lasts in milliseconds to make it perceptible.
   const uint16_t SPARKLE_DURATION_MS = 100;
 
   // --- STATE ---
-  // Use a static variable to hold the current hue. It persists between calls.
-  static uint8_t current_hue = 0;
-  EVERY_N_MILLISECONDS(CYCLE_SPEED_MS) { current_hue++; }
-  
-  // --- SPARKLE STATE (NEW) ---
-  static int8_t sparkle_led_index = -1; // Which LED is sparkling (-1 for none)
-  static uint32_t sparkle_start_time = 0; // When the sparkle started
+  // The current hue and the sparkle persist between frames in the pattern's state.
+  ComplementaryState& state = patternState<ComplementaryState>(frame);
+  if (frame.start) state.sparkle_led_index = -1;
+  // Nothing moves between hue steps, so it only needs drawing that often
+  patternKeyframeMs(CYCLE_SPEED_MS, PATTERN_HOLD);
+  state.current_hue += patternEvery(state.hue_timer, CYCLE_SPEED_MS, frame);
 
   // --- COLOR CALCULATION ---
   // The front color is based on the current hue.
-  CRGB front_color = CHSV(current_hue, 255, 255);
+  CRGB front_color = CHSV(state.current_hue, 255, 255);
   // The back color is offset by 128, which is 180° on the 0-255 hue scale.
-  CRGB back_color = CHSV(current_hue + 128, 255, 255);
+  CRGB back_color = CHSV(state.current_hue + 128, 255, 255);
 
   // --- APPLY BASE COLORS ---
   // Set the base colors first. Sparkles will be layered on top.
@@ -614,39 +559,48 @@ void innerComplementaryCycle() {
 
   // --- MANAGE SPARKLE EFFECT (UPDATED LOGIC) ---
   // Check if a sparkle is currently active
-  if (sparkle_led_index != -1) {
+  if (state.sparkle_led_index != -1) {
     // If the sparkle's duration has passed, turn it off.
-    if (millis() - sparkle_start_time > SPARKLE_DURATION_MS) {
-      sparkle_led_index = -1;
-    } else {
-      // Otherwise, keep drawing the sparkle on the correct LED.
-      if (sparkle_led_index < 2) {
-        leds_inner_front[sparkle_led_index] = CRGB(SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS);
-      } else {
-        leds_inner_back[sparkle_led_index - 2] = CRGB(SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS);
-      }
+    state.sparkle_age += frame.dt;
+    if (state.sparkle_age > SPARKLE_DURATION_MS) {
+      state.sparkle_led_index = -1;
     }
   } else {
     // If no sparkle is active, try to trigger a new one.
-    if (random8() < SPARKLE_CHANCE) {
-      sparkle_led_index = random8(4); // Pick a new LED to sparkle (0-3)
-      sparkle_start_time = millis();  // Record the start time
-      // The sparkle itself will be drawn on the next frame loop.
+    if (random16() < (uint16_t)SPARKLE_CHANCE * frame.dt) {
+      state.sparkle_led_index = random8(leds_inner_front.len + leds_inner_back.len); // Pick a new inner LED to sparkle
+      state.sparkle_age = 0;  // Start timing it
+    }
+  }
+  // Draw it from the frame it starts on, so it lasts SPARKLE_DURATION_MS however far apart the keyframes are
+  if (state.sparkle_led_index != -1) {
+    if (state.sparkle_led_index < leds_inner_front.len) {
+      leds_inner_front[state.sparkle_led_index] = CRGB(SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS);
+    } else {
+      leds_inner_back[state.sparkle_led_index - leds_inner_front.len] = CRGB(SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS, SPARKLE_BRIGHTNESS);
     }
   }
-  
-  // --- APPLY MASTER BRIGHTNESS ---
-  // Scale the final output (both base colors and sparkles) by the master brightness settings.
-  setSegBrightness(leds_inner_front, BRIGHTNESS_INNER_FRONT);
-  setSegBrightness(leds_inner_back, BRIGHTNESS_INNER_BACK);
 }
 
 
+struct EDMState {
+  uint8_t hihat_rainbow_hue;
+  uint8_t synth_hue;
+  uint16_t hihat_timer;
+  uint16_t synth_timer;
+};
+
 // This is the new "core" function that accepts a color parameter.
 // It contains all the logic for the animation.
-void innerEDMSoundReactive_core(CRGB base_color) {
+void innerEDMSoundReactive_core(const FrameContext& frame, CRGB base_color) {
+  EDMState& state = patternState<EDMState>(frame);
+
   // --- CORE CONFIGURATION ---
-  const uint8_t BPM = 128;
+  // The beats come from the tempo clock (tempo.h), which follows the music once the
+  // beat engine (beat.h) has locked onto it; live, the kicks, snares and builds are heard too
+  const Tempo& clock = tempo();
+  const bool live = beatLocked();
+  const BeatInfo& heard = beatInfo();
 
   // --- RHYTHM CONFIGURATION (BACK PANEL) ---
   const CRGB KICK_COLOR = CRGB::White;
@@ -656,19 +610,19 @@ void innerEDMSoundReactive_core(CRGB base_color) {
   // Otherwise, use the provided static color.
   CRGB hihat_color;
   if (base_color == CRGB::Black) {
-    static uint8_t hihat_rainbow_hue = 0;
-    EVERY_N_MILLISECONDS(30) { hihat_rainbow_hue++; } // Speed of the rainbow change
-    hihat_color = CHSV(hihat_rainbow_hue, 240, 255);
+    state.hihat_rainbow_hue += patternEvery(state.hihat_timer, 30, frame); // Speed of the rainbow change
+    hihat_color = CHSV(state.hihat_rainbow_hue, 240, 255);
   } else {
     hihat_color = base_color;
   }
 
   const uint16_t KICK_DECAY_MS = 150;
   const uint16_t SNARE_DECAY_MS = 120;
+  const uint16_t KICK_DECAY_RATE = ENV_DECAY_RATE(KICK_DECAY_MS, 4);   // e-folding time of 1/4 the decay
+  const uint16_t SNARE_DECAY_RATE = ENV_DECAY_RATE(SNARE_DECAY_MS, 5); // e-folding time of 1/5 the decay
 
   // --- MELODIC CONFIGURATION (FRONT PANEL) ---
-  static uint8_t synth_hue = 0;
-  const uint8_t SYNTH_PAD_SPEED_DIVISOR = 8;
+  const TempoCycle SYNTH_PAD_CYCLE = TEMPO_2_BARS;
 
   // --- STRUCTURE & FX CONFIGURATION ---
   const uint8_t BUILD_UP_CYCLE = 32;
@@ -677,39 +631,28 @@ void innerEDMSoundReactive_core(CRGB base_color) {
   const uint16_t PRE_DROP_SILENCE_MS = 100;
 
   // --- BEAT TRACKING ---
-  static uint32_t beat_counter = 0;
-  static uint32_t last_beat_time = 0;
-  uint32_t current_time = millis();
-  uint32_t beat_interval = 60000 / BPM;
-
-  bool new_beat = false;
-  if (current_time - last_beat_time >= beat_interval) {
-    new_beat = true;
-    last_beat_time = current_time;
-    beat_counter++;
-  }
-  uint32_t time_since_beat = current_time - last_beat_time;
+  uint32_t beat_counter = clock.beats;
+  uint32_t beat_interval = clock.periodMs;
+  uint32_t time_since_beat = clock.sinceBeatMs;
 
   // --- KICK DRUM SIMULATION ---
   uint8_t kick_brightness = 0;
-  if (time_since_beat < KICK_DECAY_MS) {
-    kick_brightness = 255 * exp(-(float)time_since_beat / (KICK_DECAY_MS / 4.0f));
+  uint32_t time_since_kick = live ? heard.kickMs : time_since_beat;
+  if (time_since_kick < KICK_DECAY_MS) {
+    kick_brightness = envExpDecay8(time_since_kick, KICK_DECAY_RATE);
   }
 
   // --- SNARE/CLAP SIMULATION ---
+  // Without the music, on beats 2 and 4 of the bar
   uint8_t snare_brightness = 0;
-  static uint32_t last_snare_time = 0;
-  if (new_beat && (beat_counter % 2 != 0)) {
-    last_snare_time = current_time;
-  }
-  uint32_t time_since_snare = current_time - last_snare_time;
+  uint32_t time_since_snare = live ? heard.snareMs : time_since_beat + (beat_counter % 2 ? 0 : beat_interval);
   if (time_since_snare < SNARE_DECAY_MS) {
-    snare_brightness = 255 * exp(-(float)time_since_snare / (SNARE_DECAY_MS / 5.0f));
+    snare_brightness = envExpDecay8(time_since_snare, SNARE_DECAY_RATE);
   }
 
   // --- HI-HAT SIMULATION ---
   uint8_t hihat_brightness = 30; // Base brightness to prevent flickering
-  uint8_t sixteen_step = beat16(BPM) % 16;
+  uint8_t sixteen_step = clock.sixteenth;
   switch (sixteen_step) {
     case 0:  hihat_brightness = 150; break;
     case 4:  hihat_brightness = 220; break;
@@ -719,31 +662,31 @@ void innerEDMSoundReactive_core(CRGB base_color) {
   }
 
   // --- SMOOTH SYNTH PAD SIMULATION ---
-  uint8_t synth_speed = BPM / SYNTH_PAD_SPEED_DIVISOR;
   uint8_t min_bright = 40;
   uint8_t max_bright = 200;
-  uint8_t synth_brightness1 = beatsin8(synth_speed, min_bright, max_bright, 0, 0);
-  uint8_t synth_brightness2 = beatsin8(synth_speed, min_bright, max_bright, 0, 128);
-  EVERY_N_MILLISECONDS(40) { synth_hue++; }
-  CRGB synth_color1 = CHSV(synth_hue, 240, 255);
-  CRGB synth_color2 = CHSV(synth_hue + 85, 240, 255);
+  uint8_t synth_brightness1 = tempoSin8(SYNTH_PAD_CYCLE, min_bright, max_bright, 0);
+  uint8_t synth_brightness2 = tempoSin8(SYNTH_PAD_CYCLE, min_bright, max_bright, 128);
+  state.synth_hue += patternEvery(state.synth_timer, 40, frame);
+  CRGB synth_color1 = CHSV(state.synth_hue, 240, 255);
+  CRGB synth_color2 = CHSV(state.synth_hue + 85, 240, 255);
 
   // --- BUILD-UP / DROP STRUCTURE ---
+  // Live, the engine's build level and drop stand in for the fixed 32-beat cycle; a drop can't be seen coming, so no pre-drop gap
   uint8_t build_phase = beat_counter % BUILD_UP_CYCLE;
-  bool is_in_build = (build_phase >= BUILD_UP_CYCLE - 8);
-  bool is_drop = (build_phase == 0 && beat_counter > 0);
-  bool is_pre_drop = (build_phase == BUILD_UP_CYCLE - 1 && time_since_beat > beat_interval - PRE_DROP_SILENCE_MS);
+  bool is_in_build = live ? heard.build >= BEAT_BUILD_ON : (build_phase >= BUILD_UP_CYCLE - 8);
+  bool is_drop = live ? heard.dropMs < beat_interval : (build_phase == 0 && beat_counter > 0);
+  bool is_pre_drop = !live && (build_phase == BUILD_UP_CYCLE - 1 && time_since_beat > beat_interval - PRE_DROP_SILENCE_MS);
   uint8_t roll_brightness = 0;
   if (is_in_build) {
-    float build_progress = (float)(build_phase - (BUILD_UP_CYCLE - 8)) / 8.0f;
-    uint8_t roll_speed = map(build_progress * 255, 0, 255, 8, 2);
-    if (beat16(BPM) % roll_speed == 0) { roll_brightness = 255; }
+    fract8 build_progress = live ? heard.build : (build_phase - (BUILD_UP_CYCLE - 8)) * (256 / 8); // 0-224 over the 8 build beats
+    uint8_t roll_speed = lerp8by8(8, 2, build_progress); // 128th notes from one hit to the next
+    if ((clock.beat16 >> 11) % roll_speed == 0) { roll_brightness = 255; }
     snare_brightness = max(snare_brightness, roll_brightness);
-    uint8_t filter_amount = map(build_progress * 255, 0, 255, 100, 255);
+    uint8_t filter_amount = lerp8by8(100, 255, build_progress);
     hihat_brightness = scale8(hihat_brightness, filter_amount);
-    uint8_t saturation = map(build_progress * 255, 0, 255, 180, 255);
-    synth_color1.setHSV(synth_hue, saturation, 255);
-    synth_color2.setHSV(synth_hue + 85, saturation, 255);
+    uint8_t saturation = lerp8by8(180, 255, build_progress);
+    synth_color1.setHSV(state.synth_hue, saturation, 255);
+    synth_color2.setHSV(state.synth_hue + 85, saturation, 255);
   }
 
   // --- DYNAMIC EFFECTS (FX) ---
@@ -755,112 +698,220 @@ void innerEDMSoundReactive_core(CRGB base_color) {
 
   // --- FINAL OUTPUT MAPPING ---
   if (is_drop) {
-    fill_solid(leds_inner_back, 4, CRGB::White);
-    fill_solid(leds_inner_front, 2, CRGB::White);
-    // Apply global brightness to the drop flash
-    setSegBrightness(leds_inner_back, BRIGHTNESS_INNER_BACK);
-    setSegBrightness(leds_inner_front, BRIGHTNESS_INNER_FRONT);
+    fill_solid(leds_inner_back, leds_inner_back.len, CRGB::White);
+    fill_solid(leds_inner_front, leds_inner_front.len, CRGB::White);
   } else if (is_pre_drop) {
-    fill_solid(leds_inner_back, 4, CRGB::Black);
-    fill_solid(leds_inner_front, 2, CRGB::Black);
+    fill_solid(leds_inner_back, leds_inner_back.len, CRGB::Black);
+    fill_solid(leds_inner_front, leds_inner_front.len, CRGB::Black);
   } else {
-    // Back Panel - Apply global brightness to each effect
-    leds_inner_back[0] = KICK_COLOR;
-    leds_inner_back[0].nscale8(scale8(kick_brightness, BRIGHTNESS_INNER_BACK));
-    leds_inner_back[1] = hihat_color;
-    leds_inner_back[1].nscale8(scale8(hihat_brightness, BRIGHTNESS_INNER_BACK));
-    leds_inner_back[2] = (roll_brightness > 0) ? BUILD_UP_COLOR : SNARE_COLOR;
-    leds_inner_back[2].nscale8(scale8(snare_brightness, BRIGHTNESS_INNER_BACK));
-    leds_inner_back[3] = CRGB::Black;
-
-    // Front Panel - Apply global brightness to each effect
-    leds_inner_front[0] = synth_color1;
-    leds_inner_front[0].nscale8(scale8(synth_brightness1, BRIGHTNESS_INNER_FRONT));
-    leds_inner_front[1] = synth_color2;
-    leds_inner_front[1].nscale8(scale8(synth_brightness2, BRIGHTNESS_INNER_FRONT));
+    // Back Panel: drums on the even LEDs, the hihat on the odd ones.  On the pendant's
+    // pair the kick and the snare share one LED; they land on alternate beats, and live
+    // the brighter hit wins
+    CRGB drum_color = KICK_COLOR;
+    uint8_t drum_brightness = kick_brightness;
+    if (snare_brightness > kick_brightness) {
+      drum_color = (roll_brightness > 0) ? BUILD_UP_COLOR : SNARE_COLOR;
+      drum_brightness = snare_brightness;
+    }
+    leds_inner_back.alternate(drum_color.nscale8(drum_brightness), hihat_color.nscale8(hihat_brightness));
+
+    // Front Panel
+    leds_inner_front.alternate(synth_color1.nscale8(synth_brightness1), synth_color2.nscale8(synth_brightness2));
   }
 }
 
 // --- WRAPPER FUNCTIONS ---
 // Create one of these for each color you want to use.
 
-void innerEDMSoundReactive_Cyan() {
-  innerEDMSoundReactive_core(CRGB::Cyan);
+void innerEDMSoundReactive_Cyan(const FrameContext& frame) {
+  innerEDMSoundReactive_core(frame, CRGB::Cyan);
 }
 
-void innerEDMSoundReactive_Magenta() {
-  innerEDMSoundReactive_core(CRGB::Magenta);
+void innerEDMSoundReactive_Magenta(const FrameContext& frame) {
+  innerEDMSoundReactive_core(frame, CRGB::Magenta);
 }
 
-void innerEDMSoundReactive_Rainbow() {
-  innerEDMSoundReactive_core(CRGB::Black);
+void innerEDMSoundReactive_Rainbow(const FrameContext& frame) {
+  innerEDMSoundReactive_core(frame, CRGB::Black);
 }
 
 
-void innerCycle() {
-  void (**innerPatternListCycle)() = innerPatternList;
-  static uint8_t current = 2; // Start at index 2 to avoid first two patterns
-  static unsigned long lastChangeTime = 0;
-  static bool firstRun = true;
 
-  // Call the current pattern
-  innerPatternListCycle[current]();
+/* END PATTERNS */
+
+// Saved to EEPROM once the buttons have been left alone for a while (see settings.h)
+void saveSettings() {
+  settingsSet({outerCurrentPattern, innerCurrentPattern, brightnessLevelIndex});
+}
 
-  // Every 10 seconds, advance to the next pattern, or on first run
-  unsigned long now = millis();
-  if (now - lastChangeTime >= 10000 || firstRun) {
-    lastChangeTime = now;
-    current++;
-    if (current >= ARRAY_SIZE(innerPatternList)) current = 1;
-    FastLED.clear();  // Optional: wipe leftover LEDs when switching
-    firstRun = false;
+// Fade each group over to its selected pattern, or to the auto-cycle's pair for entry 0
+void showSelected() {
+  if (outerCurrentPattern && innerCurrentPattern) {
+    autoCyclePair = 0;
+  } else if (!autoCyclePair) {
+    autoCyclePair = AUTO_CYCLE_FIRST;
+    autoCycleChangedMs = tempo().ms;
   }
+  transitionStart(GROUP_OUTER, outerPatternList[outerCurrentPattern ? outerCurrentPattern : autoCyclePair]);
+  transitionStart(GROUP_INNER, innerPatternList[innerCurrentPattern ? innerCurrentPattern : autoCyclePair]);
 }
 
-/* END PATTERNS */
+void autoCycleTick(const FrameContext& frame) {
+  if (!autoCyclePair || frame.now - autoCycleChangedMs < AUTO_CYCLE_MS || !tempo().newBar) return;
+  if (++autoCyclePair >= ARRAY_SIZE(outerPatternList)) autoCyclePair = 1;
+  autoCycleChangedMs = frame.now;
+  showSelected();
+}
 
-void outerPatternAdvance() {
-  // add one to the current pattern number, and wrap around at the end
-  outerCurrentPattern = (outerCurrentPattern + 1) % ARRAY_SIZE( outerPatternList );
-  EEPROM.update(EEPROM_ADDR_OUTER, outerCurrentPattern); // save to EEPROM
+// Switch both lists to the given entries, fading over from what is showing now
+void patternSelect(uint8_t outer, uint8_t inner) {
+  outerCurrentPattern = outer;
+  innerCurrentPattern = inner;
+  showSelected();
+  saveSettings();
 }
 
-void innerPatternAdvance() {
+void patternAdvance() {
   // add one to the current pattern number, and wrap around at the end
-  innerCurrentPattern = (innerCurrentPattern + 1) % ARRAY_SIZE( innerPatternList );
-  EEPROM.update(EEPROM_ADDR_INNER, innerCurrentPattern); // save to EEPROM
+  patternSelect((outerCurrentPattern + 1) % ARRAY_SIZE( outerPatternList ),
+                (innerCurrentPattern + 1) % ARRAY_SIZE( innerPatternList ));
+}
+
+void patternRetreat() {
+  patternSelect((outerCurrentPattern + ARRAY_SIZE( outerPatternList ) - 1) % ARRAY_SIZE( outerPatternList ),
+                (innerCurrentPattern + ARRAY_SIZE( innerPatternList ) - 1) % ARRAY_SIZE( innerPatternList ));
+}
+
+// The chosen tier, held down to what the battery level allows; the choice itself is not changed
+void applyBrightnessLevel() {
+  const uint8_t cap = BATTERY_TIER_CAP[batteryLevel()];
+  BRIGHTNESS_OUTER = min(BRIGHTNESS_LEVELS_OUTER[brightnessLevelIndex], BRIGHTNESS_LEVELS_OUTER[cap]);
+  BRIGHTNESS_OUTER_PULSE_HEAD = min(BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[brightnessLevelIndex], BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[cap]);
+  BRIGHTNESS_INNER_FRONT = min(BRIGHTNESS_LEVELS_INNER_FRONT[brightnessLevelIndex], BRIGHTNESS_LEVELS_INNER_FRONT[cap]);
+  BRIGHTNESS_INNER_BACK = min(BRIGHTNESS_LEVELS_INNER_BACK[brightnessLevelIndex], BRIGHTNESS_LEVELS_INNER_BACK[cap]);
+
+  compositorSetMaster(SEGMENT_OUTER, BRIGHTNESS_OUTER);
+  compositorSetMaster(SEGMENT_INNER_FRONT, BRIGHTNESS_INNER_FRONT);
+  compositorSetMaster(SEGMENT_INNER_BACK, BRIGHTNESS_INNER_BACK);
 }
 
 void patternBrightnessAdvance() {
   // advance the brightness cycle
   brightnessLevelIndex = (brightnessLevelIndex + 1) % BRIGHTNESS_CYCLE_LEN;
+  applyBrightnessLevel();
 
-  BRIGHTNESS_OUTER = BRIGHTNESS_LEVELS_OUTER[brightnessLevelIndex];
-  BRIGHTNESS_OUTER_PULSE_HEAD = BRIGHTNESS_LEVELS_OUTER_PULSE_HEAD[brightnessLevelIndex];
-  BRIGHTNESS_INNER_FRONT = BRIGHTNESS_LEVELS_INNER_FRONT[brightnessLevelIndex];
-  BRIGHTNESS_INNER_BACK = BRIGHTNESS_LEVELS_INNER_BACK[brightnessLevelIndex];
+  saveSettings();
+}
 
-  EEPROM.update(EEPROM_ADDR_BRIGHTNESS, brightnessLevelIndex); //save to EEPROM
+void buttonsWaitRelease() {
+  while (digitalRead(BTN_1_PIN) == LOW || digitalRead(BTN_2_PIN) == LOW) {
+    delay(10);
+  }
+  delay(50); // let the contacts settle
 }
 
-void loop() {
-  button_1.update();
-  button_2.update();
+// Blank the LEDs and power down until a button is pressed
+void enterOffState() {
+  buttonsEnd(); // powerDown() takes the pin interrupts over
+  telemetryDiscard(); // the time powered down is not a frame
+  batteryEnd(); // a conversion left running would hold the reference on
+  FastLED.clear();
+  outputShow(leds_out, NUM_LEDS);
+  buttonsWaitRelease();
+
+  settingsFlush(); // the batteries may well come out before the next power up
+  powerDown(BTN_1_PIN, BTN_2_PIN);
+
+  // Swallow the wake press so it does not also change the pattern
+  buttonsWaitRelease();
+  buttonsBegin(BTN_1_PIN, BTN_2_PIN, DOUBLE_PRESS_BUTTONS);
+  schedulerResync();
+}
 
-  if ( button_1.fell() ) {
-    outerPatternAdvance();
-    innerPatternAdvance();
-    FastLED.clear(); 
+// A segment whose master brightness is zero renders black whatever the pattern does, so skip it
+static void renderPatterns(const FrameContext& frame) {
+  telemetryPhase(TELEMETRY_OUTER);
+  if (BRIGHTNESS_OUTER) {
+    transitionRender(GROUP_OUTER, frame);
+  } else {
+    fill_solid(leds_outer, leds_outer.len, CRGB::Black);
   }
-
-  if ( button_2.fell() ) {
-    patternBrightnessAdvance(); 
-    FastLED.clear();
+  telemetryPhase(TELEMETRY_INNER);
+  if (BRIGHTNESS_INNER_FRONT || BRIGHTNESS_INNER_BACK) {
+    transitionRender(GROUP_INNER, frame);
+  } else {
+    fill_solid(leds_inner_front, leds_inner_front.len, CRGB::Black);
+    fill_solid(leds_inner_back, leds_inner_back.len, CRGB::Black);
   }
+}
 
-  outerPatternList[outerCurrentPattern]();
-  innerPatternList[innerCurrentPattern]();
-
-  FastLED.show();  
-  FastLED.delay(1000/ANIMATION_FPS); 
+/*
+ * Button 1: short press for the next pattern, double press for the previous one,
+ *           long press to go back to the auto-cycling first pattern.  Long press
+ *           while it is auto-cycling to tap the tempo: then tap button 1 on the
+ *           beat, starting on a downbeat, and it goes back to patterns once the
+ *           taps stop.  No existing gesture waits on this one.
+ * Button 2: short press for the next brightness level, long press to switch off.
+ */
+void loop() {
+  telemetryFrameBegin(outerCurrentPattern ? outerCurrentPattern : autoCyclePair); // counted against the pair on show
+  telemetryPoll();
+#ifdef LUMA_AUDIO
+  beatUpdate(); // onsets, tempo and phase from the samples taken since the last frame
+#endif
+  tempoUpdate(); // the beat grid every pattern reads this frame
+  FrameContext frame = patternFrameBegin(); // and the time they draw at
+
+  ButtonEvent event;
+  while (buttonsRead(event)) {
+    if (event.button == BUTTON_1) {
+      if (event.gesture == BUTTON_LONG && autoCyclePair) {
+        tempoTapStart();
+        buttonsSetDoubles(0); // taps come faster than a double press gap allows
+      } else if (event.gesture == BUTTON_LONG) {
+        patternSelect(0, 0);
+      } else if (tempoTapping()) {
+        tempoTap(event.pressMs);
+      } else if (event.gesture == BUTTON_SHORT) {
+        patternAdvance();
+      } else {
+        patternRetreat();
+      }
+    } else if (event.gesture == BUTTON_LONG) {
+      enterOffState();
+      return;
+    } else {
+      patternBrightnessAdvance();
+      compositorClear();
+    }
+  }
+  static PENDANT_STATE bool wasTapping = false;
+  if (wasTapping && !tempoTapping()) buttonsSetDoubles(DOUBLE_PRESS_BUTTONS);
+  wasTapping = tempoTapping();
+  autoCycleTick(frame);
+  if (batteryUpdate(frame.now)) applyBrightnessLevel();
+
+#ifdef LUMA_STREAM
+  // While a host keeps sending, its newest whole frame stands in for the patterns
+  if (!streamFrame(leds_raw, NUM_LEDS)) renderPatterns(frame);
+#else
+  renderPatterns(frame);
+#endif
+
+  telemetryPhase(TELEMETRY_COMPOSE);
+  compositorRun(); // master brightness, pattern scaling and gamma, in one pass into leds_out
+  batteryIndicate(leds_out, frame.now); // the low-battery blink goes over whatever is showing
+  powerLimit(leds_out, NUM_LEDS, POWER_BUDGET_MA); // keep flashes and floods within what the cells can deliver
+#ifdef LUMA_STREAM
+  streamWaitIdle(); // show() would drop the bytes of a frame that is arriving
+#endif
+  telemetryPhase(TELEMETRY_SHOW);
+  outputShow(leds_out, NUM_LEDS); // skipped when nothing changed
+#ifdef LUMA_STREAM
+  streamShown(); // the host sends the next frame on this
+#endif
+  telemetryPhase(TELEMETRY_SAVE);
+  settingsTick(); // at most one EEPROM byte per frame
+  telemetryPhase(TELEMETRY_WAIT);
+  schedulerWait(); // wait out whatever is left of this frame's 1/ANIMATION_FPS slot
 }
\ No newline at end of file
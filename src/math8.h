@@ -0,0 +1,47 @@
+/*
+
+ constexpr versions of the lib8tion functions used to build lookup tables.
+
+ They give exactly the same results as FastLED's C implementations, so a
+ table generated at compile time matches what the runtime call would have
+ produced.  Not for use at runtime: the FastLED versions are faster there.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+constexpr uint8_t constSin8(uint8_t theta) {
+  // Same piecewise-linear quarter wave as FastLED's sin8_C()
+  const uint8_t b[4] = {0, 49, 90, 117};
+  const uint8_t m16[4] = {49, 41, 27, 10};
+  uint8_t offset = (theta & 0x40) ? (uint8_t)(255 - theta) : theta;
+  offset &= 0x3F;
+  uint8_t secoffset = (offset & 0x0F) + ((theta & 0x40) ? 1 : 0);
+  uint8_t section = offset >> 4;
+  uint8_t mx = (m16[section] * secoffset) >> 4;
+  int8_t y = (int8_t)(mx + b[section]);
+  if (theta & 0x80) y = -y;
+  return (uint8_t)(y + 128);
+}
+
+constexpr uint8_t constCos8(uint8_t theta) {
+  return constSin8((uint8_t)(theta + 64));
+}
+
+constexpr uint8_t constScale8(uint8_t i, uint8_t scale) {
+  // FASTLED_SCALE8_FIXED, as the firmware is built
+  return (uint8_t)(((uint16_t)i * (1 + (uint16_t)scale)) >> 8);
+}
+
+constexpr uint8_t constTriwave8(uint8_t in) {
+  return (uint8_t)(((in & 0x80) ? (uint8_t)(255 - in) : in) << 1);
+}
+
+constexpr uint8_t constEase8InOutCubic(uint8_t i) {
+  uint8_t ii = constScale8(i, i);
+  uint8_t iii = constScale8(ii, i);
+  uint16_t r1 = (3 * (uint16_t)ii) - (2 * (uint16_t)iii);
+  return (r1 & 0x100) ? 255 : (uint8_t)r1;
+}
@@ -0,0 +1,27 @@
+#include "output.h"
+#include "geometry.h"
+#include "state.h"
+
+#include <string.h>
+
+static PENDANT_STATE CRGB shownFrame[GEOMETRY_LED_COUNT]; // what the strip is showing
+static PENDANT_STATE uint8_t framesSinceShow = OUTPUT_REFRESH_FRAMES;
+static PENDANT_STATE uint32_t skippedFrames = 0;
+
+bool outputShow(const CRGB* leds, uint8_t count) {
+  if (count > GEOMETRY_LED_COUNT) count = GEOMETRY_LED_COUNT;
+  size_t bytes = count * sizeof(CRGB);
+  if (framesSinceShow < OUTPUT_REFRESH_FRAMES && memcmp(leds, shownFrame, bytes) == 0) {
+    framesSinceShow++;
+    skippedFrames++;
+    return false;
+  }
+  FastLED.show();
+  memcpy(shownFrame, leds, bytes);
+  framesSinceShow = 0;
+  return true;
+}
+
+uint32_t outputSkippedFrames() {
+  return skippedFrames;
+}
@@ -0,0 +1,22 @@
+/*
+
+ Output stage: only pushes a frame to the LEDs when it differs from the last one.
+
+ Every show() holds interrupts off for ~30 us per LED, so a static frame (or a
+ segment that is switched off) is pure waste.  A copy of the frame last shown
+ is kept (3 bytes per LED) and each frame is compared against it byte for
+ byte; only an exact match skips show(), so a real change is never dropped.
+ The strip is still refreshed every OUTPUT_REFRESH_FRAMES in case an LED
+ latched a glitch.
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#define OUTPUT_REFRESH_FRAMES 255
+
+// Shows leds if they changed since the last call; returns true if it did
+bool outputShow(const CRGB* leds, uint8_t count);
+uint32_t outputSkippedFrames();
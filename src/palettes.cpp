@@ -0,0 +1,90 @@
+#include "palettes.h"
+#include "state.h"
+
+// rainbow for various patterns, heavily tweaked to look ok on the tomorrowland pendant outer ring
+DEFINE_GRADIENT_PALETTE(rainbowLoopAgroGamma) {
+      0, 255,   0,   0,   // Red 
+     21, 255,  60,   0,   // Red-Orange 
+     42, 220, 128,   0,   // Yellow 
+     63,  80, 255,   0,   // Yellow-Green 
+     85,   0, 255,   0,   // Green 
+    106,   0, 255, 128,   // Green-Cyan
+    127,   0, 220, 255,   // Cyan 
+    148,   0,  80, 255,   // Cyan-Blue
+    169,   0,   0, 255,   // Blue 
+    190,  20,   0, 255,   // Blue-Violet
+    211, 128,   0, 120,   // Magenta 
+    232, 255,   0,  20,   // Magenta-Red
+    255, 255,   0,   0    // Red (back to zero)
+};
+
+// Tiamat palette adapted from WLED
+// A bright meteor with blue, teal and magenta hues
+DEFINE_GRADIENT_PALETTE(tiamatAgroGamma) {
+    0,   1,  2, 14,   // Very dark navy (nearly black-blue)
+   33,   2,  5, 35,   // Midnight blue
+  100,  13,135, 92,   // Teal green (deep jade)
+  120,  43,255,193,   // Bright aqua mint
+  140, 247,  7,249,   // Neon pink-violet
+  160, 193, 17,208,   // Electric purple
+  180,  39,255,154,   // Bright seafoam green
+  200,   4,213,236,   // Electric cyan (vivid)
+  220,  39,252,135,   // Bright spring green
+  240, 193,213,253,   // Light periwinkle / icy blue
+  255, 255,249,255    // Near white with pink tint (pastel)
+};
+
+// Yelmag-inspired palette (warm yellows with magenta and red)
+DEFINE_GRADIENT_PALETTE(yelmagAgroGamma) {
+    0,   0,   0,   0, // Black
+   42, 113,   0,   0, // Dark Red / Maroon
+   84, 255,   0,   0, // Pure Red
+  127, 255,   0, 117, // Hot Pink / Red-Magenta mix
+  170, 255,   0, 255, // Magenta
+  212, 255, 128, 117, // Light Red-Orange / Coral
+  255, 255, 255,   0  // Yellow
+};
+
+// Sherbet palette from WLED (soft pinks, oranges, and whites)
+DEFINE_GRADIENT_PALETTE(rainbowSherbetAgroGamma) {
+    0,   255, 102,  41,   // dark orange
+   43,   255, 140,  90,   // peach
+   86,   255,  51,  90,   // hot pink
+  127,   255, 153, 169,   // soft pink
+  170,   255, 255, 249,   // off-white
+  209,   113, 255,  85,   // green-lime
+  255,   157, 255, 137    // mint-lime
+};
+
+// Indexed by PaletteId
+static const TProgmemRGBGradientPaletteRef paletteGradients[PALETTE_COUNT] PROGMEM = {
+  rainbowLoopAgroGamma,
+  tiamatAgroGamma,
+  yelmagAgroGamma,
+  rainbowSherbetAgroGamma,
+};
+
+static PENDANT_STATE CRGBPalette16 cache[PALETTE_CACHE_SLOTS];
+static PENDANT_STATE uint8_t cachedIds[PALETTE_CACHE_SLOTS]; // PaletteId + 1, so 0 is an empty slot
+static PENDANT_STATE uint8_t useOrder[PALETTE_CACHE_SLOTS] = {0, 1, 2}; // slots, most recently used first
+static_assert(PALETTE_CACHE_SLOTS == 3, "useOrder starts with every slot once");
+
+// Moves the slot at position n of useOrder to the front
+static uint8_t touch(uint8_t n) {
+  uint8_t slot = useOrder[n];
+  for (; n > 0; n--) useOrder[n] = useOrder[n - 1];
+  useOrder[0] = slot;
+  return slot;
+}
+
+const CRGBPalette16& paletteGet(PaletteId id) {
+  for (uint8_t n = 0; n < PALETTE_CACHE_SLOTS; n++) {
+    if (cachedIds[useOrder[n]] == id + 1) return cache[touch(n)];
+  }
+
+  // Miss: decode over the least recently used slot
+  uint8_t slot = touch(PALETTE_CACHE_SLOTS - 1);
+  cache[slot] = (TProgmemRGBGradientPaletteRef)pgm_read_ptr(&paletteGradients[id]);
+  cachedIds[slot] = id + 1;
+  return cache[slot];
+}
@@ -0,0 +1,38 @@
+/*
+
+ Palette registry.
+
+ The gradient definitions stay in flash and patterns refer to them by
+ PaletteId.  A decoded CRGBPalette16 is 48 bytes of SRAM, so only the palettes
+ in use are decoded, into a small cache shared by every caller.  A miss
+ decodes over the least recently used slot.  Three slots hold the most the
+ patterns ever have in use at once, during a crossfade of the outer ring: the
+ outgoing and incoming outer palettes and the inner one (the inner patterns
+ only use PALETTE_RAINBOW).  A fourth palette in use at once, say from a
+ bytecode program (vm.h), would miss and decode again on every lookup until
+ one of them is no longer drawn.
+
+ The cache is 150 bytes of SRAM: three slots (144), their ids (3) and the
+ order they were used in (3).  The four palettes as CRGBPalette16 globals and
+ washingMachineEffect()'s static copy took ~241, so that is ~91 back.
+
+ The reference paletteGet() returns is valid until the next call, so look the
+ palette up once per frame (or per call site) and use it straight away.
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#define PALETTE_CACHE_SLOTS 3
+
+enum PaletteId : uint8_t {
+  PALETTE_RAINBOW,  // rainbowLoopAgroGamma
+  PALETTE_TIAMAT,   // tiamatAgroGamma
+  PALETTE_YELMAG,   // yelmagAgroGamma
+  PALETTE_SHERBET,  // rainbowSherbetAgroGamma
+  PALETTE_COUNT
+};
+
+const CRGBPalette16& paletteGet(PaletteId id);
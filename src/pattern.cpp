@@ -0,0 +1,56 @@
+#include "pattern.h"
+#include "state.h"
+#include "tempo.h"
+
+static PENDANT_STATE uint32_t frameCount;
+static PENDANT_STATE uint32_t lastMs;
+static PENDANT_STATE bool running;
+static PENDANT_STATE PatternSlot* rendering; // the slot of the pattern being drawn, for patternKeyframeMs()
+
+FrameContext patternFrameBegin() {
+  FrameContext frame;
+  frame.now = tempo().ms;
+  uint32_t dt = running ? frame.now - lastMs : 0;
+  frame.dt = min(dt, (uint32_t)PATTERN_MAX_DT_MS);
+  frame.frame = frameCount++;
+  frame.state = nullptr;
+  frame.start = false;
+  lastMs = frame.now;
+  running = true;
+  return frame;
+}
+
+void patternActivate(PatternSlot& slot, PatternFn pattern) {
+  slot.pattern = pattern;
+  slot.start = true;
+  slot.keyframeMs = 0;
+  slot.tween = PATTERN_HOLD;
+  slot.sinceRenderMs = 0;
+  memset(slot.state, 0, sizeof(slot.state));
+}
+
+void patternRender(PatternSlot& slot, const FrameContext& frame) {
+  FrameContext own = frame;
+  own.dt = min(slot.sinceRenderMs + frame.dt, PATTERN_MAX_DT_MS);
+  own.state = slot.state;
+  own.start = slot.start;
+  slot.start = false;
+  slot.sinceRenderMs = 0;
+  rendering = &slot;
+  slot.pattern(own);
+  rendering = nullptr;
+}
+
+void patternKeyframeMs(uint8_t periodMs, PatternTween tween) {
+  if (!rendering) return;
+  rendering->keyframeMs = min(periodMs, (uint8_t)PATTERN_MAX_DT_MS);
+  rendering->tween = tween;
+}
+
+bool patternDue(const PatternSlot& slot, const FrameContext& frame) {
+  return slot.start || slot.sinceRenderMs + frame.dt >= slot.keyframeMs;
+}
+
+void patternSkip(PatternSlot& slot, const FrameContext& frame) {
+  slot.sinceRenderMs += frame.dt;
+}
@@ -0,0 +1,96 @@
+/*
+
+ Pattern interface: a frame context in, state in a fixed arena.
+
+ Every pattern is a PatternFn taking the frame it draws.  The frame gives the
+ time (now, and dt since the previous frame) and the frame number, all made
+ once per frame by patternFrameBegin(), so a pattern never reads millis()
+ itself and replays exactly from a fixed clock (the native harness).
+
+ A pattern keeps whatever it needs between frames in its slot's state arena,
+ PATTERN_STATE_BYTES that are zeroed when the pattern is activated, with
+ frame.start set on its first frame for anything that does not start at 0.
+ Only the patterns on show have state: one slot per group, and a second one
+ for the outgoing pattern while a crossfade runs (transition.h).  A pattern
+ declares its state as a struct and gets it with patternState<T>(frame),
+ which refuses at compile time a struct too big for the arena.
+
+ EVERY_N_MILLISECONDS() keeps a hidden timer on millis(); patternEvery() is
+ the same on dt, with the timer in the pattern's state.
+
+ A slow pattern need not render every frame.  Calling patternKeyframeMs()
+ while it renders (as it calls compositorScale()) makes the frames it draws
+ keyframes at most that far apart; on the frames in between it is not
+ called, and what it drew last is either held or blended towards from the
+ keyframe before it (PATTERN_INTERPOLATE, transition.h and compositor.h do the
+ blending), which shows the pattern one keyframe late.  A keyframe's dt is
+ the time since the pattern last rendered, so anything timed by dt runs at the
+ same speed at any keyframe rate; an effect counted in frames (a fixed fade
+ per render, a chance per render) has to be made per ms first.  The held
+ frames cost nothing but the compositor, and output.h skips the show of a
+ frame that does not change, so the time saved is spent asleep in
+ schedulerWait().
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define PATTERN_STATE_BYTES 16
+#define PATTERN_MAX_DT_MS   100 // a stalled frame loop (the off state) resumes instead of catching up
+
+struct FrameContext {
+  uint32_t now;     // ms, the same for everything drawn this frame
+  uint16_t dt;      // ms since the previous frame, at most PATTERN_MAX_DT_MS
+  uint32_t frame;   // frames since power up
+  void* state;      // the pattern's arena
+  bool start;       // first frame since the pattern was activated
+};
+
+typedef void (*PatternFn)(const FrameContext& frame);
+
+enum PatternTween : uint8_t {
+  PATTERN_HOLD,        // between keyframes, show the last one as it is
+  PATTERN_INTERPOLATE  // blend from the keyframe before it, for smooth fades
+};
+
+struct PatternSlot {
+  PatternFn pattern; // nullptr when empty
+  bool start;
+  uint8_t keyframeMs;      // 0: renders every frame
+  PatternTween tween;
+  uint16_t sinceRenderMs;  // dt of the frames since it last rendered
+  uint8_t state[PATTERN_STATE_BYTES] __attribute__((aligned(4)));
+};
+
+FrameContext patternFrameBegin();  // once per frame, after tempoUpdate()
+void patternActivate(PatternSlot& slot, PatternFn pattern);
+void patternRender(PatternSlot& slot, const FrameContext& frame);
+
+// Call while rendering: keyframes for this pattern at most periodMs apart (up to PATTERN_MAX_DT_MS)
+void patternKeyframeMs(uint8_t periodMs, PatternTween tween);
+// Whether the slot renders this frame; if not, call patternSkip() instead of patternRender()
+bool patternDue(const PatternSlot& slot, const FrameContext& frame);
+void patternSkip(PatternSlot& slot, const FrameContext& frame);
+// How far a skipped frame is from the last keyframe to the next, 0-254
+inline uint8_t patternProgress(const PatternSlot& slot) {
+  return (uint16_t)slot.sinceRenderMs * 255 / slot.keyframeMs;
+}
+
+template <typename T>
+inline T& patternState(const FrameContext& frame) {
+  static_assert(sizeof(T) <= PATTERN_STATE_BYTES, "pattern state does not fit PATTERN_STATE_BYTES");
+  return *static_cast<T*>(frame.state);
+}
+
+// Whole periodMs intervals completed by this frame; the remainder stays in timer
+inline uint8_t patternEvery(uint16_t& timer, uint16_t periodMs, const FrameContext& frame) {
+  timer += frame.dt;
+  uint8_t steps = 0;
+  while (timer >= periodMs) {
+    timer -= periodMs;
+    steps++;
+  }
+  return steps;
+}
@@ -0,0 +1,107 @@
+#include "power.h"
+#include "state.h"
+
+#ifndef LUMA_NATIVE
+#include <avr/sleep.h>
+#endif
+
+// Channel weights in mA per level, Q16, so the estimate needs no division
+#define POWER_WEIGHT_Q16(UA) ((uint32_t)(((UA) * 65536ULL) / (255UL * 1000UL)))
+#define POWER_IDLE_Q16       ((uint32_t)((POWER_LED_IDLE_UA * 65536ULL) / 1000UL))
+
+static PENDANT_STATE PowerStats stats;
+
+uint16_t powerEstimateMa(const CRGB* leds, uint8_t count) {
+  uint16_t sumR = 0, sumG = 0, sumB = 0; // 255 LEDs at most, so no overflow
+  for (uint8_t i = 0; i < count; i++) {
+    sumR += leds[i].r;
+    sumG += leds[i].g;
+    sumB += leds[i].b;
+  }
+  uint32_t q16 = sumR * POWER_WEIGHT_Q16(POWER_LED_RED_UA)
+               + sumG * POWER_WEIGHT_Q16(POWER_LED_GREEN_UA)
+               + sumB * POWER_WEIGHT_Q16(POWER_LED_BLUE_UA)
+               + count * POWER_IDLE_Q16;
+  return q16 >> 16;
+}
+
+uint16_t powerLimit(CRGB* leds, uint8_t count, uint16_t budgetMa) {
+  uint16_t ma = powerEstimateMa(leds, count);
+  if (ma > stats.peakMa) stats.peakMa = ma;
+
+  if (ma > budgetMa) {
+    // Only the lit part scales; the quiescent draw is there regardless
+    uint16_t idleMa = (count * POWER_IDLE_Q16) >> 16;
+    uint8_t scale = budgetMa > idleMa ? ((uint32_t)(budgetMa - idleMa) << 8) / (ma - idleMa) : 0;
+    nscale8(leds, count, scale);
+    ma = powerEstimateMa(leds, count);
+    stats.limitedFrames++;
+  }
+
+  stats.lastMa = ma;
+  stats.totalMa += ma;
+  stats.frames++;
+  return ma;
+}
+
+const PowerStats& powerStats() {
+  return stats;
+}
+
+void powerResetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+static PENDANT_STATE volatile bool powerWoken;
+
+static void powerWake() {
+  powerWoken = true;
+}
+
+#ifdef LUMA_NATIVE
+
+// Virtual time never needs waiting for; timebaseWaitUntil() jumps it instead
+void powerIdle() {}
+
+void powerDown(uint8_t wakePin1, uint8_t wakePin2) {
+  powerWoken = false;
+  attachInterrupt(digitalPinToInterrupt(wakePin1), powerWake, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(wakePin2), powerWake, CHANGE);
+  // With nothing scheduled to wake it the real part would sleep forever; return instead
+  while (!powerWoken && nativeSleep()) {}
+  detachInterrupt(digitalPinToInterrupt(wakePin1));
+  detachInterrupt(digitalPinToInterrupt(wakePin2));
+}
+
+#else
+
+void powerIdle() {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_enable();
+  sei();        // the instruction after sei always runs, so a pending wake is not lost
+  sleep_cpu();
+  sleep_disable();
+}
+
+void powerDown(uint8_t wakePin1, uint8_t wakePin2) {
+  powerWoken = false;
+  // CHANGE is BOTHEDGES, which every pin can sense asynchronously in POWER_DOWN
+  attachInterrupt(digitalPinToInterrupt(wakePin1), powerWake, CHANGE);
+  attachInterrupt(digitalPinToInterrupt(wakePin2), powerWake, CHANGE);
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  cli();
+  while (!powerWoken) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  sei();
+
+  detachInterrupt(digitalPinToInterrupt(wakePin1));
+  detachInterrupt(digitalPinToInterrupt(wakePin2));
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+
+ Sleep and the power model.
+
+ Between frames the CPU sleeps in IDLE rather than spinning: the RTC compare
+ interrupt (see timebase.cpp) wakes it at the next frame deadline.  IDLE, not
+ STANDBY, because millis() runs off a TCA/TCD tick the patterns depend on, and
+ that timer stops in STANDBY.  The tick still wakes the CPU once a millisecond,
+ but each wake is a few microseconds of work instead of a whole millisecond of
+ spinning.
+
+ The off state powers the MCU down completely until a button pin changes.  The
+ LEDs stay on the battery (the board has no switch for them), so their
+ quiescent draw dominates the off current; see POWER_LED_IDLE_UA.
+
+ The current figures are datasheet-typical values for a 4.5 V supply.  The
+ limiter uses them every frame to keep the strip under POWER_BUDGET_MA, and
+ the native harness (--energy) uses them to estimate battery life.  Replace them with
+ bench measurements of a real pendant when you have them.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#define POWER_SUPPLY_MV          4500UL  // 3 x AAA
+#define POWER_MCU_ACTIVE_UA      7000UL  // ATtiny1616 at 16 MHz, 4.5 V
+#define POWER_MCU_IDLE_UA        2600UL  // IDLE sleep, peripherals clocked
+#define POWER_MCU_OFF_UA            1UL  // POWER_DOWN, pin wake only
+#define POWER_LED_IDLE_UA         800UL  // SK6812 driver with all channels at 0
+#define POWER_LED_RED_UA        12000UL  // one channel at 255 (scales linearly)
+#define POWER_LED_GREEN_UA      12000UL
+#define POWER_LED_BLUE_UA       12000UL
+#define POWER_SHOW_US_PER_LED      30UL  // 24 bits at 800 kHz, interrupts off
+#define POWER_SHOW_US_LATCH        80UL  // reset/latch gap after the data
+
+// Cap on the estimated strip current; frames above it are scaled down
+#ifndef POWER_BUDGET_MA
+#define POWER_BUDGET_MA           100 // alkaline AAA capacity falls off quickly above ~100 mA
+#endif
+
+struct PowerStats {
+  uint16_t peakMa;        // highest estimate before limiting
+  uint16_t lastMa;        // last frame, after limiting
+  uint32_t totalMa;       // sum of lastMa, for the average
+  uint32_t frames;
+  uint32_t limitedFrames; // frames that had to be scaled down
+};
+
+// Estimated LED current in mA: per-channel sums times the weights above, plus
+// the drivers' quiescent draw.  One pass over the bytes and three multiplies.
+uint16_t powerEstimateMa(const CRGB* leds, uint8_t count);
+
+// Scales the whole frame by one factor, so segments keep their balance, when
+// the estimate is over budgetMa.  Returns the estimate after limiting.
+uint16_t powerLimit(CRGB* leds, uint8_t count, uint16_t budgetMa);
+const PowerStats& powerStats();
+void powerResetStats();
+
+void powerIdle();                           // call with interrupts disabled; returns with them enabled
+void powerDown(uint8_t wakePin1, uint8_t wakePin2); // sleeps until either pin changes level
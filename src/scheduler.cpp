@@ -0,0 +1,58 @@
+#include "scheduler.h"
+#include "state.h"
+#include "timebase.h"
+
+static PENDANT_STATE uint16_t periodTicks;  // whole ticks per frame
+static PENDANT_STATE uint8_t periodFrac;    // plus this many 1/256 ticks, so 129 fps does not drift
+static PENDANT_STATE uint8_t deadlineFrac;
+static PENDANT_STATE uint32_t deadline;
+static PENDANT_STATE uint32_t lastWake;
+static PENDANT_STATE FrameStats stats;
+
+void schedulerBegin(uint8_t fps) {
+  timebaseBegin();
+  uint32_t periodQ8 = (TIMEBASE_HZ << 8) / fps;
+  periodTicks = periodQ8 >> 8;
+  periodFrac = periodQ8 & 0xFF;
+  deadlineFrac = 0;
+  lastWake = timebaseNow();
+  deadline = lastWake + periodTicks;
+  memset(&stats, 0, sizeof(stats));
+}
+
+void schedulerWait() {
+  uint32_t now = timebaseNow();
+  stats.busyTicks += now - lastWake;
+
+  int32_t slack = (int32_t)(deadline - now);
+  if (slack > 0) {
+    timebaseWaitUntil(deadline);
+  } else {
+    stats.overruns++;
+    uint32_t late = -slack;
+    if (late >= periodTicks) {
+      stats.dropped += late / periodTicks;
+      deadline = now;
+    }
+  }
+
+  // Next deadline: one period on, carrying the fractional tick
+  uint8_t frac = deadlineFrac + periodFrac;
+  deadline += periodTicks + (frac < deadlineFrac ? 1 : 0);
+  deadlineFrac = frac;
+
+  lastWake = timebaseNow();
+  stats.frames++;
+}
+
+// The RTC does not run in POWER_DOWN, so after a sleep the deadline is simply
+// stale; start again from now rather than counting the gap as dropped frames.
+void schedulerResync() {
+  deadlineFrac = 0;
+  lastWake = timebaseNow();
+  deadline = lastWake + periodTicks;
+}
+
+const FrameStats& schedulerStats() {
+  return stats;
+}
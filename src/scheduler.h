@@ -0,0 +1,27 @@
+/*
+
+ Deadline-based frame scheduler.
+
+ Frames start on absolute deadlines spaced 1/fps apart on the RTC timebase, so
+ the render and show time of a frame comes out of the wait instead of adding
+ to it and every pattern runs at the same rate.  A frame that finishes after
+ its deadline is an overrun; when whole frame slots go by, they are counted as
+ dropped and the schedule restarts from now rather than bursting to catch up.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct FrameStats {
+  uint32_t frames;    // frames started
+  uint32_t overruns;  // frames that finished after their deadline
+  uint32_t dropped;   // whole frame slots skipped
+  uint32_t busyTicks; // timebase ticks spent outside schedulerWait()
+};
+
+void schedulerBegin(uint8_t fps);
+void schedulerWait(); // call once per frame, after FastLED.show()
+void schedulerResync(); // restart the schedule from now, e.g. after the off state
+const FrameStats& schedulerStats();
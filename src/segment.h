@@ -0,0 +1,78 @@
+/*
+
+ The strip's segments as types: Segment<FIRST, LEN> is a view of LEN LEDs of
+ leds_raw starting at FIRST, with both numbers fixed at compile time.
+
+ A segment holds nothing, so leds_outer[i] is leds_raw[FIRST + i] with the
+ address folded into the instruction, and len is a constant the compiler can
+ see through.  A segment that runs off the end of the strip does not build,
+ and neither does a constant index past the end of a segment
+ (leds_inner_back[2] is an error, where CRGBSet wrote into the next global).
+ The index check needs an optimised build (the firmware is built -Os); a
+ runtime index is not checked.
+
+ each() runs its body once per LED with the index as a compile-time
+ constant, so the loop is fully unrolled and table lookups such as
+ ringAngle(i) become constant loads:
+
+   leds_outer.each([&](auto i, CRGB& led) { led = CHSV(ringAngle(i), 255, 255); });
+
+ A segment converts to CRGB*, for fill_solid() and the like.  alternate()
+ gives even LEDs one colour and odd LEDs another: the two LEDs of an inner
+ pair on the pendant, and every other LED of a longer segment on a board
+ that has one (boards.h).
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#include "geometry.h"
+#include "state.h"
+
+extern PENDANT_STATE CRGB leds_raw[GEOMETRY_LED_COUNT];
+
+// Not defined: a call that survives optimisation is a constant index out of range
+void segmentIndexOutOfRange() __attribute__((error("constant LED index past the end of its segment")));
+
+// The index each() passes: a distinct type per LED, so every copy of the body inlines with it constant
+template <uint8_t I>
+struct SegmentIndex {
+  constexpr operator uint8_t() const { return I; }
+};
+
+template <uint8_t FIRST, uint8_t LEN>
+struct Segment {
+  static_assert(LEN > 0 && FIRST + LEN <= GEOMETRY_LED_COUNT, "segment runs past the end of the strip");
+
+  static constexpr uint8_t first = FIRST;
+  static constexpr uint8_t len = LEN;
+
+  inline __attribute__((always_inline)) CRGB& operator[](uint8_t i) const {
+    if (__builtin_constant_p(i) && i >= LEN) segmentIndexOutOfRange();
+    return leds_raw[FIRST + i];
+  }
+
+  operator CRGB*() const { return leds_raw + FIRST; }
+
+  template <typename F>
+  inline __attribute__((always_inline)) void each(F&& body) const { eachFrom<0>(body); }
+
+  void alternate(const CRGB& even, const CRGB& odd) const {
+    each([&](auto i, CRGB& led) { led = i % 2 ? odd : even; });
+  }
+
+private:
+  template <uint8_t I, typename F>
+  inline __attribute__((always_inline)) void eachFrom(F& body) const {
+    if constexpr (I < LEN) {
+      body(SegmentIndex<I>(), leds_raw[FIRST + I]);
+      eachFrom<I + 1>(body);
+    }
+  }
+};
+
+constexpr Segment<OUTER_FIRST, OUTER_LEN> leds_outer{};
+constexpr Segment<INNER_FRONT_FIRST, INNER_FRONT_LEN> leds_inner_front{};
+constexpr Segment<INNER_BACK_FIRST, INNER_BACK_LEN> leds_inner_back{};
@@ -0,0 +1,187 @@
+#include "settings.h"
+#include "state.h"
+
+#include <EEPROM.h>
+
+// Where the firmware kept each field before the log
+#define SETTINGS_LEGACY_OUTER      0
+#define SETTINGS_LEGACY_INNER      1
+#define SETTINGS_LEGACY_BRIGHTNESS 2
+
+#define SETTINGS_CRC_OFFSET 6 // the CRC covers the bytes before it
+
+static PENDANT_STATE Settings limits;
+static PENDANT_STATE Settings current;
+static PENDANT_STATE Settings saved;
+static PENDANT_STATE uint16_t savedSeq;
+static PENDANT_STATE uint8_t savedSlot;
+static PENDANT_STATE bool logged;      // saved came from, or has been written to, the log
+static PENDANT_STATE bool dirty;
+static PENDANT_STATE uint32_t changedMs;
+
+// Commit in progress, written a byte at a time; recordPos == SETTINGS_RECORD_SIZE when idle
+static PENDANT_STATE uint8_t record[SETTINGS_RECORD_SIZE];
+static PENDANT_STATE uint8_t recordPos = SETTINGS_RECORD_SIZE;
+static PENDANT_STATE uint8_t recordSlot;
+static PENDANT_STATE Settings recordSettings;
+
+static PENDANT_STATE SettingsStats stats;
+
+// CRC-16/CCITT-FALSE
+static uint16_t crc16(const uint8_t* data, uint8_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static bool sameSettings(const Settings& a, const Settings& b) {
+  return a.outerPattern == b.outerPattern && a.innerPattern == b.innerPattern && a.brightness == b.brightness;
+}
+
+static bool fieldsValid(const Settings& s) {
+  return s.outerPattern < limits.outerPattern && s.innerPattern < limits.innerPattern && s.brightness < limits.brightness;
+}
+
+static uint16_t slotAddress(uint8_t slot) {
+  return SETTINGS_LOG_START + slot * SETTINGS_RECORD_SIZE;
+}
+
+// True if the slot holds a valid record, which is then returned in s and seq
+static bool readSlot(uint8_t slot, Settings& s, uint16_t& seq) {
+  uint8_t r[SETTINGS_RECORD_SIZE];
+  for (uint8_t i = 0; i < SETTINGS_RECORD_SIZE; i++) r[i] = EEPROM.read(slotAddress(slot) + i);
+
+  uint16_t crc = r[SETTINGS_CRC_OFFSET] | (r[SETTINGS_CRC_OFFSET + 1] << 8);
+  if (crc != crc16(r, SETTINGS_CRC_OFFSET) || r[5] != SETTINGS_VERSION) return false;
+
+  seq = r[0] | (r[1] << 8);
+  s.outerPattern = r[2];
+  s.innerPattern = r[3];
+  s.brightness = r[4];
+  return fieldsValid(s);
+}
+
+static bool eepromBusy() {
+#ifdef LUMA_NATIVE
+  return false;
+#else
+  return NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm;
+#endif
+}
+
+static void startCommit() {
+  dirty = false;
+  if (logged && sameSettings(current, saved)) return; // changed and changed back
+
+  uint16_t seq = savedSeq + 1;
+  recordSettings = current;
+  recordSlot = (savedSlot + 1) % SETTINGS_SLOTS;
+  record[0] = seq;
+  record[1] = seq >> 8;
+  record[2] = current.outerPattern;
+  record[3] = current.innerPattern;
+  record[4] = current.brightness;
+  record[5] = SETTINGS_VERSION;
+  uint16_t crc = crc16(record, SETTINGS_CRC_OFFSET);
+  record[SETTINGS_CRC_OFFSET] = crc;
+  record[SETTINGS_CRC_OFFSET + 1] = crc >> 8;
+  recordPos = 0;
+}
+
+// Starts the next byte of the commit unless the last one is still being written
+static void writeNext() {
+  if (eepromBusy()) return;
+  uint16_t address = slotAddress(recordSlot) + recordPos;
+  if (EEPROM.read(address) != record[recordPos]) {
+    EEPROM.write(address, record[recordPos]);
+    stats.bytes++;
+  }
+  if (++recordPos < SETTINGS_RECORD_SIZE) return;
+
+  saved = recordSettings;
+  savedSlot = recordSlot;
+  savedSeq++;
+  logged = true;
+  stats.commits++;
+}
+
+const Settings& settingsBegin(const Settings& fieldLimits) {
+  limits = fieldLimits;
+  memset(&stats, 0, sizeof(stats));
+  recordPos = SETTINGS_RECORD_SIZE;
+  dirty = false;
+
+  bool found = false;
+  for (uint8_t slot = 0; slot < SETTINGS_SLOTS; slot++) {
+    Settings s;
+    uint16_t seq;
+    if (!readSlot(slot, s, seq)) continue;
+    if (found && (int16_t)(seq - savedSeq) <= 0) continue;
+    found = true;
+    saved = s;
+    savedSeq = seq;
+    savedSlot = slot;
+  }
+
+  logged = found;
+  if (found) {
+    stats.source = SETTINGS_FROM_LOG;
+  } else {
+    saved.outerPattern = EEPROM.read(SETTINGS_LEGACY_OUTER);
+    saved.innerPattern = EEPROM.read(SETTINGS_LEGACY_INNER);
+    saved.brightness = EEPROM.read(SETTINGS_LEGACY_BRIGHTNESS);
+    bool legacy = saved.outerPattern < limits.outerPattern || saved.innerPattern < limits.innerPattern ||
+                  saved.brightness < limits.brightness;
+    if (saved.outerPattern >= limits.outerPattern) saved.outerPattern = 0;
+    if (saved.innerPattern >= limits.innerPattern) saved.innerPattern = 0;
+    if (saved.brightness >= limits.brightness) saved.brightness = 0;
+
+    stats.source = legacy ? SETTINGS_FROM_LEGACY : SETTINGS_FROM_DEFAULTS;
+    dirty = legacy; // move them into the log
+    changedMs = millis();
+    savedSeq = 0;
+    savedSlot = 0; // so the first record goes to slot 1 and the legacy bytes in slot 0 outlive a torn first commit
+  }
+
+  current = saved;
+  return current;
+}
+
+const Settings& settingsGet() {
+  return current;
+}
+
+const Settings& settingsSaved() {
+  return saved;
+}
+
+void settingsSet(const Settings& settings) {
+  current = settings;
+  dirty = true;
+  changedMs = millis();
+}
+
+void settingsTick() {
+  if (recordPos < SETTINGS_RECORD_SIZE) {
+    writeNext();
+  } else if (dirty && millis() - changedMs >= SETTINGS_QUIET_MS) {
+    startCommit();
+  }
+}
+
+void settingsFlush() {
+  for (;;) {
+    if (recordPos < SETTINGS_RECORD_SIZE) writeNext();
+    else if (dirty) startCommit();
+    else return;
+  }
+}
+
+const SettingsStats& settingsStats() {
+  return stats;
+}
@@ -0,0 +1,67 @@
+/*
+
+ Settings store: pattern and brightness selections that survive power off.
+
+ The settings live in RAM.  settingsSet() only marks them changed, and
+ settingsTick() commits them once nothing has changed for SETTINGS_QUIET_MS,
+ so cycling through patterns writes nothing until the user settles on one.
+
+ A commit appends one 8-byte record to a ring log over the first
+ SETTINGS_LOG_BYTES of the EEPROM:
+
+   seq (2)  outer  inner  brightness  version  crc16 (2)
+
+ Records go to the slot after the newest, so each cell is written once per
+ SETTINGS_SLOTS commits instead of on every press.  The tinyAVR EEPROM
+ takes a few milliseconds per byte; settingsTick() writes one byte per call,
+ and only once the previous byte has finished, so a commit never stalls a
+ frame.  The CRC goes last, so a record cut short by a power loss fails its
+ check and the one before it still loads.
+
+ Loading takes the valid record with the highest sequence number.  A record
+ is valid if its CRC and version match and every field is below its limit.
+ If no record is valid, the three bytes the firmware used to keep at
+ addresses 0-2 are tried field by field, and anything still out of range
+ falls back to 0.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef SETTINGS_QUIET_MS
+#define SETTINGS_QUIET_MS 3000
+#endif
+#define SETTINGS_LOG_START   0
+#define SETTINGS_LOG_BYTES   192 // the rest of the EEPROM holds a bytecode pattern (vm.h)
+#define SETTINGS_RECORD_SIZE 8
+#define SETTINGS_SLOTS       (SETTINGS_LOG_BYTES / SETTINGS_RECORD_SIZE)
+#define SETTINGS_VERSION     1
+
+struct Settings {
+  uint8_t outerPattern;
+  uint8_t innerPattern;
+  uint8_t brightness;
+};
+
+struct SettingsStats {
+  uint32_t commits;     // records written since settingsBegin()
+  uint32_t bytes;       // EEPROM bytes that changed, which is what wears it
+  uint8_t source;       // where settingsBegin() found the settings (SettingsSource)
+};
+
+enum SettingsSource {
+  SETTINGS_FROM_LOG,
+  SETTINGS_FROM_LEGACY,
+  SETTINGS_FROM_DEFAULTS
+};
+
+// Loads the newest valid settings; limits holds the number of choices for each field
+const Settings& settingsBegin(const Settings& limits);
+const Settings& settingsGet();
+const Settings& settingsSaved();       // what the newest complete record holds
+void settingsSet(const Settings& settings);
+void settingsTick();                   // call once per frame
+void settingsFlush();                  // commit anything pending now, waiting for each byte (e.g. before powering down)
+const SettingsStats& settingsStats();
@@ -0,0 +1,23 @@
+/*
+
+ Pendant state: everything the firmware changes while it runs.
+
+ Every variable the firmware writes after it boots (module state, the LED
+ buffers, the odd function static) is declared PENDANT_STATE.  On the part
+ that is nothing: there is one pendant, and a reset clears its RAM.  In a
+ native build it is thread_local, so each host thread is a pendant of its
+ own, and a thread starting up gets the values a reset would leave, as a
+ fresh part does.  The fleet simulator (lib/NativeHost, --fleet) runs each
+ pendant of a crowd on its own thread this way.
+
+ Tables that never change (PROGMEM, const) are shared and stay as they are.
+
+*/
+
+#pragma once
+
+#ifdef LUMA_NATIVE
+#define PENDANT_STATE thread_local
+#else
+#define PENDANT_STATE
+#endif
@@ -0,0 +1,227 @@
+#include "stream.h"
+
+#ifdef LUMA_STREAM
+
+#include "geometry.h"
+#include "state.h"
+#include "timebase.h"
+
+#ifndef LUMA_NATIVE
+#include <util/crc16.h>
+#endif
+
+#define STREAM_TIMEOUT_TICKS      ((uint32_t)STREAM_TIMEOUT_MS * TIMEBASE_HZ / 1000)
+#define STREAM_IDLE_CREDIT_TICKS  ((uint32_t)STREAM_IDLE_CREDIT_MS * TIMEBASE_HZ / 1000)
+// Longest frame on the wire (10 bits a byte), which is as long as streamWaitIdle() waits
+#define STREAM_FRAME_US (((GEOMETRY_LED_COUNT * 3UL + 5) * 10 * 1000000UL) / STREAM_BAUD)
+
+enum ReceiveState : uint8_t {
+  RECEIVE_HUNT,   // waiting for STREAM_FRAME_SYNC
+  RECEIVE_SEQ,
+  RECEIVE_COUNT,
+  RECEIVE_PIXELS,
+  RECEIVE_CRC_LO,
+  RECEIVE_CRC_HI
+};
+
+// The receive interrupt fills buffers[back]; the main loop shows buffers[back ^ 1].
+// ready hands a complete frame over; both sides only swap with it under cli().
+static PENDANT_STATE CRGB buffers[2][GEOMETRY_LED_COUNT];
+static PENDANT_STATE volatile uint8_t back;
+static PENDANT_STATE volatile bool ready;
+static PENDANT_STATE volatile uint32_t readyTick;    // when the ready frame's last byte arrived
+static PENDANT_STATE volatile uint8_t readySeq;
+static PENDANT_STATE volatile uint32_t lastGoodTick;
+
+// Receive interrupt only, apart from receiving, which streamWaitIdle() watches
+static PENDANT_STATE volatile uint8_t receiving;     // ReceiveState
+static PENDANT_STATE uint8_t frameSeq;
+static PENDANT_STATE uint8_t frameCount;
+static PENDANT_STATE uint8_t bytesLeft;
+static PENDANT_STATE uint8_t* pixel;
+static PENDANT_STATE uint16_t crc;
+static PENDANT_STATE uint8_t crcLo;
+static PENDANT_STATE uint8_t lastSeq;
+
+// Main loop only
+static PENDANT_STATE uint32_t frontTick;
+static PENDANT_STATE bool frontShown;
+static PENDANT_STATE uint8_t frontSeq;
+static PENDANT_STATE uint32_t lastCreditTick;
+
+static PENDANT_STATE volatile StreamStats stats;
+
+static inline uint16_t crcUpdate(uint16_t crc, uint8_t byte) {
+#ifdef LUMA_NATIVE
+  crc ^= (uint16_t)byte << 8;
+  for (uint8_t i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  return crc;
+#else
+  return _crc_xmodem_update(crc, byte);
+#endif
+}
+
+static void send(uint8_t byte) {
+#ifdef LUMA_NATIVE
+  nativeSerialWrite(byte);
+#else
+  while (!(USART0.STATUS & USART_DREIF_bm)) {}
+  USART0.TXDATAL = byte;
+#endif
+}
+
+static void frameDone() {
+  uint32_t now = timebaseNow();
+  if (stats.frames) stats.lost += (uint8_t)(frameSeq - lastSeq - 1);
+  lastSeq = frameSeq;
+  stats.frames++;
+  lastGoodTick = now;
+
+  // Black out whatever the host did not send
+  memset(buffers[back] + frameCount, 0, (GEOMETRY_LED_COUNT - frameCount) * sizeof(CRGB));
+  readyTick = now;
+  readySeq = frameSeq;
+  ready = true;
+}
+
+// A frame that has started arriving takes the back buffer back from a ready
+// frame that was never shown: the newer one is shown instead
+void streamReceive(uint8_t byte) {
+  switch (receiving) {
+    case RECEIVE_HUNT:
+      if (byte == STREAM_FRAME_SYNC) receiving = RECEIVE_SEQ;
+      return;
+
+    case RECEIVE_SEQ:
+      frameSeq = byte;
+      crc = crcUpdate(0xFFFF, byte);
+      receiving = RECEIVE_COUNT;
+      return;
+
+    case RECEIVE_COUNT:
+      crc = crcUpdate(crc, byte);
+      if (byte > GEOMETRY_LED_COUNT) {
+        stats.crcErrors++;
+        receiving = RECEIVE_HUNT;
+        return;
+      }
+      if (ready) {
+        ready = false;
+        stats.overwritten++;
+      }
+      frameCount = byte;
+      bytesLeft = byte * 3;
+      pixel = (uint8_t*)buffers[back];
+      receiving = bytesLeft ? RECEIVE_PIXELS : RECEIVE_CRC_LO;
+      return;
+
+    case RECEIVE_PIXELS:
+      crc = crcUpdate(crc, byte);
+      *pixel++ = byte;
+      if (--bytesLeft == 0) receiving = RECEIVE_CRC_LO;
+      return;
+
+    case RECEIVE_CRC_LO:
+      crcLo = byte;
+      receiving = RECEIVE_CRC_HI;
+      return;
+
+    case RECEIVE_CRC_HI:
+      receiving = RECEIVE_HUNT;
+      if ((((uint16_t)byte << 8) | crcLo) == crc) {
+        frameDone();
+      } else {
+        stats.crcErrors++;
+      }
+      return;
+  }
+}
+
+void streamLineError() {
+  stats.lineErrors++;
+  receiving = RECEIVE_HUNT;
+}
+
+#ifdef LUMA_NATIVE
+
+// The harness attaches the port (nativeRealTime()) and feeds streamReceive()
+void streamBegin() {}
+
+#else
+
+ISR(USART0_RXC_vect) {
+  uint8_t status = USART0.RXDATAH; // before RXDATAL, which pops the byte
+  uint8_t byte = USART0.RXDATAL;
+  if (status & (USART_BUFOVF_bm | USART_FERR_bm)) {
+    streamLineError();
+  } else {
+    streamReceive(byte);
+  }
+}
+
+// 8N1 on the default USART0 pins.  Not Serial: its own receive interrupt
+// queues bytes for the main loop, which would tear frames across a show().
+void streamBegin() {
+  PORTB.OUTSET = PIN2_bm;
+  PORTB.DIRSET = PIN2_bm;
+  USART0.BAUD = (uint16_t)((4UL * F_CPU + STREAM_BAUD / 2) / STREAM_BAUD);
+  USART0.CTRLC = USART_CMODE_ASYNCHRONOUS_gc | USART_PMODE_DISABLED_gc | USART_SBMODE_1BIT_gc | USART_CHSIZE_8BIT_gc;
+  USART0.CTRLA = USART_RXCIE_bm;
+  USART0.CTRLB = USART_RXEN_bm | USART_TXEN_bm;
+}
+
+#endif
+
+bool streamFrame(CRGB* leds, uint8_t count) {
+  noInterrupts();
+  bool fresh = ready;
+  if (fresh) {
+    ready = false;
+    back ^= 1;
+    frontTick = readyTick;
+    frontSeq = readySeq;
+  }
+  interrupts();
+
+  if (fresh) frontShown = false;
+  if (!streamActive()) return false;
+  memcpy(leds, buffers[back ^ 1], min(count, (uint8_t)GEOMETRY_LED_COUNT) * sizeof(CRGB));
+  return true;
+}
+
+void streamWaitIdle() {
+  uint16_t waited = 0;
+  while (receiving != RECEIVE_HUNT && waited < STREAM_FRAME_US) {
+    delayMicroseconds(20);
+    waited += 20;
+  }
+}
+
+void streamShown() {
+  uint32_t now = timebaseNow();
+  bool active = streamActive();
+  if (active && !frontShown) {
+    frontShown = true;
+    uint32_t latencyUs = ((now - frontTick) * 15625UL) >> 9; // x 1000000 / 32768
+    stats.shown++;
+    stats.latencySumUs += latencyUs;
+    if (latencyUs > stats.latencyMaxUs) stats.latencyMaxUs = min(latencyUs, (uint32_t)0xFFFF);
+  }
+  if (!active && now - lastCreditTick < STREAM_IDLE_CREDIT_TICKS) return;
+  lastCreditTick = now;
+  send(STREAM_CREDIT_SYNC);
+  send(frontSeq);
+}
+
+bool streamActive() {
+  noInterrupts();
+  bool active = stats.frames && timebaseNow() - lastGoodTick < STREAM_TIMEOUT_TICKS;
+  interrupts();
+  return active;
+}
+
+const StreamStats& streamStats() {
+  return (const StreamStats&)stats;
+}
+
+#endif
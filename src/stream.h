@@ -0,0 +1,77 @@
+/*
+
+ Live frame streaming over the serial port (-DLUMA_STREAM).
+
+ A host (a laptop running tools/stream_frames.py) sends whole frames to
+ USART0 (RX = PB3, TX = PB2) and the pendant shows them in place of its own
+ patterns, so a show can be tried out before it is written as a pattern.
+ Frames go into leds_raw at full scale: master brightness, gamma and the
+ power limiter still apply, as they do to a pattern.
+
+ Host to pendant, one frame:
+
+   0xC5  seq  count  count x (r g b)  crc_lo crc_hi
+
+ seq counts frames (mod 256), count is the number of LEDs that follow (up to
+ GEOMETRY_LED_COUNT; the rest are black) and the CRC is CRC-16/CCITT-FALSE
+ over seq, count and the pixels.  A frame with a bad CRC or count is dropped
+ and the receiver hunts for the next 0xC5, which is how it falls back into
+ step after a lost or corrupted byte.
+
+ Pendant to host, after every frame it shows:
+
+   0xCA  seq
+
+ the seq of the newest frame shown so far.  The host paces itself on these:
+ it sends a frame, and the next one once the credit for it comes back
+ (tools/stream_frames.py can keep more than one in flight), so the stream
+ runs at the pendant's frame rate and frames never queue up behind the one on
+ show.  The time from sending a frame to its credit is the end-to-end
+ latency, to light on the LEDs.  While the stream is stopped the pendant
+ sends a credit every STREAM_IDLE_CREDIT_MS, so a host can start at any time.
+
+ Bytes arrive by interrupt into the back half of a double buffer; a complete
+ frame with a good CRC is handed over whole, and streamFrame() takes it at
+ the start of the next frame, so what is shown never mixes two frames.
+ FastLED.show() blocks interrupts for long enough to lose bytes at
+ STREAM_BAUD, so streamWaitIdle() lets a frame that is arriving finish first;
+ with one frame in flight at a time, the next one only starts after the
+ credit that follows the show.
+
+ When no good frame has arrived for STREAM_TIMEOUT_MS the stream has stopped
+ and the patterns take over again.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#ifndef STREAM_BAUD
+#define STREAM_BAUD 230400
+#endif
+#define STREAM_TIMEOUT_MS      500
+#define STREAM_IDLE_CREDIT_MS  100
+#define STREAM_FRAME_SYNC      0xC5
+#define STREAM_CREDIT_SYNC     0xCA
+
+struct StreamStats {
+  uint32_t frames;        // good frames received
+  uint32_t shown;         // of those, frames that were shown
+  uint16_t crcErrors;     // frames dropped for a bad CRC or count
+  uint16_t lineErrors;    // framing errors and receiver overflows
+  uint16_t lost;          // frames missing from the seq numbers
+  uint16_t overwritten;   // good frames replaced before a frame boundary took them
+  uint32_t latencySumUs;  // last byte received to show(), over the shown frames
+  uint16_t latencyMaxUs;
+};
+
+void streamBegin();
+void streamReceive(uint8_t byte);      // the receive interrupt's work; the native harness calls it too
+void streamLineError();                // the receive interrupt saw a framing error or overflow
+bool streamFrame(CRGB* leds, uint8_t count); // at the start of a frame: false while the stream is stopped
+bool streamActive();                   // a good frame arrived in the last STREAM_TIMEOUT_MS
+void streamWaitIdle();                 // before show()
+void streamShown();                    // after show(): sends the credit
+const StreamStats& streamStats();
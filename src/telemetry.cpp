@@ -0,0 +1,170 @@
+#include "telemetry.h"
+
+#ifdef LUMA_TELEMETRY
+
+#include <stddef.h>
+
+#include "cycles.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "state.h"
+
+#ifndef LUMA_NATIVE
+#include <util/crc16.h>
+#endif
+
+#define CYCLES_PER_US     (F_CPU / 1000000UL)
+#define CALIBRATE_FRAMES  8
+#define FRAMING_BYTES     5 // sync, length (2), CRC (2)
+
+static PENDANT_STATE TelemetryReport report;
+
+// The frame in progress
+static PENDANT_STATE uint16_t frameUs[TELEMETRY_PHASE_COUNT];
+static PENDANT_STATE TelemetryPhase openPhase;
+static PENDANT_STATE uint32_t markCycles;
+static PENDANT_STATE uint8_t framePattern;
+static PENDANT_STATE bool inFrame; // false until the first mark after begin or a discard
+
+// The report on its way out, framing included; position 0 is the sync byte
+static PENDANT_STATE bool sending;
+static PENDANT_STATE uint16_t sendPos;
+static PENDANT_STATE uint16_t sendLength;
+static PENDANT_STATE uint16_t sendCrc;
+
+static inline uint16_t crcUpdate(uint16_t crc, uint8_t byte) {
+#ifdef LUMA_NATIVE
+  crc ^= (uint16_t)byte << 8;
+  for (uint8_t i = 0; i < 8; i++) crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  return crc;
+#else
+  return _crc_xmodem_update(crc, byte);
+#endif
+}
+
+static void resetCounters() {
+  report.frames = 0;
+  for (TelemetryPhaseStats& phase : report.phase) phase = {0xFFFF, 0, 0};
+  for (TelemetryPatternStats& pattern : report.pattern) {
+    memset(&pattern, 0, sizeof(pattern));
+    pattern.minUs = 0xFFFF;
+  }
+}
+
+static void endFrame() {
+  uint32_t busy = 0;
+  for (uint8_t i = 0; i < TELEMETRY_PHASE_COUNT; i++) {
+    TelemetryPhaseStats& phase = report.phase[i];
+    uint16_t us = frameUs[i];
+    if (us < phase.minUs) phase.minUs = us;
+    if (us > phase.maxUs) phase.maxUs = us;
+    phase.totalUs += us;
+    if (i != TELEMETRY_WAIT) busy += us;
+  }
+  if (busy > 0xFFFF) busy = 0xFFFF;
+
+  TelemetryPatternStats& pattern = report.pattern[framePattern];
+  pattern.frames++;
+  if (busy < pattern.minUs) pattern.minUs = busy;
+  if (busy > pattern.maxUs) pattern.maxUs = busy;
+  pattern.renderUs += frameUs[TELEMETRY_OUTER] + frameUs[TELEMETRY_INNER];
+  uint32_t bin = busy * TELEMETRY_BINS / report.slotUs;
+  if (bin >= TELEMETRY_BINS) bin = TELEMETRY_BINS - 1;
+  if (++pattern.bins[bin] == 0xFFFF) {
+    for (uint8_t i = 0; i < TELEMETRY_BINS; i++) pattern.bins[i] >>= 1;
+  }
+  report.frames++;
+}
+
+void telemetryPhase(TelemetryPhase phase) {
+  uint32_t now = cyclesNow();
+  uint32_t us = frameUs[openPhase] + (now - markCycles) / CYCLES_PER_US;
+  frameUs[openPhase] = us > 0xFFFF ? 0xFFFF : us;
+  markCycles = now;
+  openPhase = phase;
+}
+
+void telemetryFrameBegin(uint8_t pattern) {
+  telemetryPhase(TELEMETRY_INPUT);
+  // Nothing is recorded while a report goes out, so it holds still
+  if (inFrame && !sending) endFrame();
+  memset(frameUs, 0, sizeof(frameUs));
+  framePattern = pattern < report.patterns ? pattern : 0;
+  inFrame = true;
+}
+
+void telemetryDiscard() {
+  inFrame = false;
+}
+
+void telemetryBegin(uint8_t patterns, uint8_t fps) {
+  cyclesBegin();
+  Serial.begin(TELEMETRY_BAUD);
+
+  report.version = TELEMETRY_VERSION;
+  report.phases = TELEMETRY_PHASE_COUNT;
+  report.patterns = patterns < TELEMETRY_MAX_PATTERNS ? patterns : TELEMETRY_MAX_PATTERNS;
+  report.bins = TELEMETRY_BINS;
+  report.slotUs = 1000000UL / fps;
+  resetCounters();
+
+  // Time what loop() adds: a frame's marks, and the end of the frame
+  telemetryFrameBegin(0);
+  uint32_t start = cyclesNow();
+  for (uint8_t i = 0; i < CALIBRATE_FRAMES; i++) {
+    for (uint8_t phase = TELEMETRY_OUTER; phase < TELEMETRY_PHASE_COUNT; phase++) telemetryPhase(TelemetryPhase(phase));
+    telemetryFrameBegin(0);
+  }
+  report.overheadCycles = (cyclesNow() - start) / CALIBRATE_FRAMES;
+  resetCounters();
+  telemetryDiscard();
+}
+
+static void startReport() {
+  const FrameStats& frames = schedulerStats();
+  report.overruns = frames.overruns;
+  report.dropped = frames.dropped;
+  report.eepromCommits = settingsStats().commits;
+  report.eepromBytes = settingsStats().bytes;
+  sendLength = offsetof(TelemetryReport, pattern) + report.patterns * sizeof(TelemetryPatternStats);
+  sendPos = 0;
+  sendCrc = 0xFFFF;
+  sending = true;
+}
+
+static uint8_t reportByte(uint16_t pos) {
+  if (pos == 0) return TELEMETRY_REPORT_SYNC;
+  if (pos == 1) return sendLength;
+  if (pos == 2) return sendLength >> 8;
+  pos -= 3;
+  if (pos < sendLength) {
+    uint8_t byte = ((const uint8_t*)&report)[pos];
+    sendCrc = crcUpdate(sendCrc, byte);
+    return byte;
+  }
+  return pos == sendLength ? sendCrc : sendCrc >> 8;
+}
+
+void telemetryPoll() {
+  while (Serial.available()) {
+    int byte = Serial.read();
+    if (sending) continue;
+    if (byte == TELEMETRY_REQUEST) startReport();
+    else if (byte == TELEMETRY_RESET) resetCounters();
+  }
+  if (!sending) return;
+
+  for (uint8_t n = 0; n < TELEMETRY_TX_BYTES && sendPos < sendLength + FRAMING_BYTES; n++) {
+    Serial.write(reportByte(sendPos++));
+  }
+  if (sendPos == sendLength + FRAMING_BYTES) {
+    sending = false;
+    inFrame = false; // it sent the end of the report
+  }
+}
+
+const TelemetryReport& telemetryReport() {
+  return report;
+}
+
+#endif
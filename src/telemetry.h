@@ -0,0 +1,111 @@
+/*
+
+ Runtime telemetry (-DLUMA_TELEMETRY): what loop() costs on a real pendant.
+
+ loop() marks the start of each of its phases (TelemetryPhase) and the time
+ between marks is read off the TCB1 cycle counter (cycles.h), so every cycle
+ of a frame lands in exactly one phase.  When a frame ends, its phase times
+ go into the per-phase min/max/total and its busy time (the frame less the
+ wait for the next slot) into the counters of the pattern on show: frames,
+ min, max, render time and a histogram in eighths of the frame slot, whose
+ top bin is the frames that came close to, or past, their deadline.  Next to
+ that the report carries the scheduler's overruns and dropped frames and the
+ settings store's EEPROM writes.
+
+ Counters are 16-bit where they can be: times are in microseconds, and when a
+ pattern's histogram bin fills, all of its bins are halved, which keeps the
+ shape and loses only the oldest detail.
+
+ A host asks for a report by sending TELEMETRY_REQUEST at TELEMETRY_BAUD on
+ USART0 (RX = PB3, TX = PB2; tools/telemetry_report.py does it and decodes
+ the answer).  The pendant answers with
+
+   0xD5  length_lo length_hi  TelemetryReport (length bytes)  crc_lo crc_hi
+
+ CRC-16/CCITT-FALSE over the report, all fields little-endian.  The report
+ goes out TELEMETRY_TX_BYTES a frame, which the serial buffer takes without
+ blocking, and recording pauses until the last byte has gone, so the report
+ is consistent and the cost of sending it is not in it.  TELEMETRY_RESET
+ clears the counters.
+
+ The instrumentation costs a few hundred cycles a frame: telemetryBegin()
+ times a frame's worth of marks and the report carries it (overheadCycles).
+ Without LUMA_TELEMETRY every call here is an empty inline, so the firmware
+ is built exactly as if they were not there.  It needs USART0, which
+ LUMA_STREAM also uses.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define TELEMETRY_BAUD          115200
+#define TELEMETRY_REQUEST       0xD1
+#define TELEMETRY_RESET         0xD2
+#define TELEMETRY_REPORT_SYNC   0xD5
+#define TELEMETRY_TX_BYTES      32   // report bytes a frame: under half a 129 fps slot at TELEMETRY_BAUD
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_MAX_PATTERNS  10
+#define TELEMETRY_BINS          8    // busy time in eighths of the frame slot
+
+enum TelemetryPhase : uint8_t {
+  TELEMETRY_INPUT,    // beat engine, tempo, buttons, battery
+  TELEMETRY_OUTER,    // outer group render
+  TELEMETRY_INNER,    // inner group render
+  TELEMETRY_COMPOSE,  // compositor, low-battery blink, power limit
+  TELEMETRY_SHOW,     // outputShow()
+  TELEMETRY_SAVE,     // settingsTick(): at most one EEPROM byte
+  TELEMETRY_WAIT,     // schedulerWait(): idle until the next slot
+  TELEMETRY_PHASE_COUNT
+};
+
+struct __attribute__((packed)) TelemetryPhaseStats {
+  uint16_t minUs;
+  uint16_t maxUs;
+  uint32_t totalUs;
+};
+
+struct __attribute__((packed)) TelemetryPatternStats {
+  uint32_t frames;
+  uint16_t minUs;     // busy time: the frame less TELEMETRY_WAIT
+  uint16_t maxUs;
+  uint32_t renderUs;  // TELEMETRY_OUTER + TELEMETRY_INNER, for the mean render cost
+  uint16_t bins[TELEMETRY_BINS];
+};
+
+// What goes over the wire, as it is laid out in memory
+struct __attribute__((packed)) TelemetryReport {
+  uint8_t version;
+  uint8_t phases;          // TELEMETRY_PHASE_COUNT
+  uint8_t patterns;        // entries of pattern[] that follow
+  uint8_t bins;            // TELEMETRY_BINS
+  uint16_t slotUs;         // the frame slot the bins divide
+  uint16_t overheadCycles; // the instrumentation's own cost per frame
+  uint32_t frames;         // frames recorded
+  uint32_t overruns;       // from the scheduler, since boot
+  uint32_t dropped;
+  uint32_t eepromCommits;  // from the settings store, since boot
+  uint32_t eepromBytes;
+  TelemetryPhaseStats phase[TELEMETRY_PHASE_COUNT];
+  TelemetryPatternStats pattern[TELEMETRY_MAX_PATTERNS];
+};
+
+#ifdef LUMA_TELEMETRY
+
+void telemetryBegin(uint8_t patterns, uint8_t fps);
+void telemetryFrameBegin(uint8_t pattern); // first thing in loop(): ends the last frame, opens TELEMETRY_INPUT
+void telemetryPhase(TelemetryPhase phase); // closes the open phase and opens this one
+void telemetryDiscard();                   // drops the frame in progress, e.g. before the off state
+void telemetryPoll();                      // once a frame: requests in, report bytes out
+const TelemetryReport& telemetryReport();
+
+#else
+
+inline void telemetryBegin(uint8_t, uint8_t) {}
+inline void telemetryFrameBegin(uint8_t) {}
+inline void telemetryPhase(TelemetryPhase) {}
+inline void telemetryDiscard() {}
+inline void telemetryPoll() {}
+
+#endif
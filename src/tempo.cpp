@@ -0,0 +1,141 @@
+#include "tempo.h"
+#include "beat.h"
+#include "state.h"
+#include "timebase.h"
+
+#include <FastLED.h>
+
+// Beat lengths in timebase ticks
+#define TEMPO_MIN_PERIOD (TIMEBASE_HZ * 60 / TEMPO_MAX_BPM)
+#define TEMPO_MAX_PERIOD (TIMEBASE_HZ * 60 / TEMPO_MIN_BPM)
+
+static PENDANT_STATE Tempo state;
+static PENDANT_STATE uint32_t period;      // ticks per beat
+static PENDANT_STATE uint32_t reciprocal;  // 2^30 / period, so the phase is a multiply rather than a division
+static PENDANT_STATE uint32_t beatStart;   // tick the current beat started on
+static PENDANT_STATE uint32_t position;    // beats << 16 | beat16
+static PENDANT_STATE uint32_t heardBeats;  // the beat engine's count at the last update
+
+static PENDANT_STATE bool tapping;
+static PENDANT_STATE uint32_t tapMs;       // last tap, or the start of tapping
+static PENDANT_STATE uint8_t taps;         // in the current run
+static PENDANT_STATE uint32_t firstTap;
+static PENDANT_STATE uint32_t lastTap;
+
+// Saturates past 2^20 ms (17 minutes), where ms << 12 would no longer fit
+static uint32_t msToTicks(uint32_t ms) {
+  if (ms > 0xFFFFFUL) ms = 0xFFFFFUL;
+  return (ms << 12) / 125; // x 32768 / 1000
+}
+
+static uint16_t ticksToMs(uint32_t ticks) {
+  return (ticks * 125) >> 12;
+}
+
+static void setPeriod(uint32_t ticks) {
+  period = constrain(ticks, TEMPO_MIN_PERIOD, TEMPO_MAX_PERIOD);
+  reciprocal = (1UL << 30) / period;
+  state.bpm = (TIMEBASE_HZ * 60 + period / 2) / period;
+  state.periodMs = ticksToMs(period);
+}
+
+void tempoBegin() {
+  memset(&state, 0, sizeof(state));
+  setPeriod(TIMEBASE_HZ * 60 / TEMPO_DEFAULT_BPM);
+  beatStart = timebaseNow();
+  heardBeats = beatInfo().beats;
+  tapping = false;
+  taps = 0;
+  tempoUpdate();
+}
+
+void tempoUpdate() {
+  uint32_t now = timebaseNow();
+  uint32_t lastBeats = state.beats;
+  uint32_t since;
+
+  const BeatInfo& heard = beatInfo();
+  if (beatLocked()) {
+    // Count the engine's beats and take its phase, but keep our own bar
+    if (heard.periodMs != state.periodMs) setPeriod(msToTicks(heard.periodMs));
+    state.beats += heard.beats - heardBeats;
+    since = min(msToTicks(heard.sinceBeatMs), period - 1);
+    beatStart = now - since;
+    state.source = TEMPO_HEARD;
+  } else {
+    since = now - beatStart;
+    if (since >= period) {
+      uint32_t passed = since / period; // one, unless the frame loop was stopped (off state)
+      state.beats += passed;
+      beatStart += passed * period;
+      since -= passed * period;
+    }
+  }
+  heardBeats = heard.beats;
+
+  state.ms = millis();
+  state.beat16 = (since * reciprocal) >> 14;
+  state.sinceBeatMs = ticksToMs(since);
+  state.phase = state.beat16 >> 8;
+  uint8_t beatOfBar = state.beats & 3;
+  state.barPhase = (beatOfBar << 6) | (state.phase >> 2);
+  state.sixteenth = (beatOfBar << 2) | (state.beat16 >> 14);
+  state.newBeat = state.beats != lastBeats;
+  state.newBar = (state.beats >> 2) != (lastBeats >> 2);
+  position = (state.beats << 16) | state.beat16;
+
+  if (tapping && state.ms - tapMs >= TEMPO_TAP_TIMEOUT_MS) tapping = false;
+}
+
+const Tempo& tempo() {
+  return state;
+}
+
+void tempoTapStart() {
+  tapping = true;
+  tapMs = millis();
+  taps = 0;
+}
+
+bool tempoTapping() {
+  return tapping;
+}
+
+void tempoTap(uint32_t pressMs) {
+  uint32_t at = timebaseNow() - msToTicks(millis() - pressMs);
+  tapMs = pressMs;
+
+  if (taps) {
+    uint32_t interval = at - lastTap;
+    bool inRange = interval >= TEMPO_MIN_PERIOD && interval <= TEMPO_MAX_PERIOD;
+    uint32_t average = taps > 1 ? (lastTap - firstTap) / (taps - 1) : interval;
+    bool onRun = interval > average - average / 4 && interval < average + average / 4;
+    if (!inRange || !onRun) taps = 0;
+  }
+  if (!taps) firstTap = at;
+  lastTap = at;
+  if (taps < 255) taps++;
+  if (taps < 2) return;
+
+  // The first tap of the run was a downbeat, so this one is beat taps - 1 of its bar
+  setPeriod((lastTap - firstTap) / (taps - 1));
+  beatStart = at;
+  state.beats += (uint8_t)(taps - 1 - state.beats) & 3;
+  state.source = TEMPO_TAPPED;
+}
+
+uint16_t tempoCycle16(TempoCycle cycle) {
+  return cycle >= 0 ? position >> cycle : position << -cycle;
+}
+
+uint8_t tempoCycle8(TempoCycle cycle) {
+  return tempoCycle16(cycle) >> 8;
+}
+
+uint8_t tempoSin8(TempoCycle cycle, uint8_t lowest, uint8_t highest, uint8_t phaseOffset) {
+  return lowest + scale8(sin8(tempoCycle8(cycle) + phaseOffset), highest - lowest);
+}
+
+uint16_t tempoSin16(TempoCycle cycle, uint16_t lowest, uint16_t highest) {
+  return lowest + scale16(sin16(tempoCycle16(cycle)) + 32768, highest - lowest);
+}
@@ -0,0 +1,84 @@
+/*
+
+ Tempo clock: one beat grid for every pattern.
+
+ tempoUpdate() runs once at the start of each frame.  It reads the RTC
+ timebase once, moves the clock on and works out where the frame falls on
+ the grid: beat number, phase through the beat, sixteenth of the bar, and
+ millis() for the patterns' own timers.  Patterns read tempo() and the
+ tempoCycle/tempoSin helpers, which are shifts of that one position, so no
+ pattern calls beat8()/beatsin8() (a millis() read and a 32-bit multiply
+ each) and every effect turns over on the same downbeat.
+
+ The tempo comes from, in order:
+
+   heard    the beat engine (beat.h), while it is locked onto music
+   tapped   tempoTap(), from at least two taps TEMPO_MIN_BPM..TEMPO_MAX_BPM
+            apart; the first tap of a run is the downbeat, and a tap far off
+            the run's average interval starts a new run
+   default  TEMPO_DEFAULT_BPM from power up
+
+ When the lock is lost the clock carries on at the heard tempo and phase.
+
+ Cycles are powers of two of a beat, given as TempoCycle.  At the default
+ 128 BPM a bar is 1.875 s and TEMPO_4_BARS is 7.5 s.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef TEMPO_DEFAULT_BPM
+#define TEMPO_DEFAULT_BPM 128
+#endif
+#define TEMPO_MIN_BPM        60
+#define TEMPO_MAX_BPM        200
+#define TEMPO_TAP_TIMEOUT_MS 2000  // tapping ends this long after the last tap
+
+enum TempoSource : uint8_t {
+  TEMPO_DEFAULT,
+  TEMPO_TAPPED,
+  TEMPO_HEARD
+};
+
+// log2 of the cycle length in beats
+enum TempoCycle : int8_t {
+  TEMPO_SIXTEENTH = -2,
+  TEMPO_EIGHTH = -1,
+  TEMPO_BEAT = 0,
+  TEMPO_HALF_BAR = 1,
+  TEMPO_BAR = 2,
+  TEMPO_2_BARS = 3,
+  TEMPO_4_BARS = 4,
+  TEMPO_8_BARS = 5
+};
+
+struct Tempo {
+  uint32_t ms;          // millis() at the start of the frame
+  uint32_t beats;       // beats since power up; beats % 4 == 0 on a downbeat
+  uint16_t beat16;      // 0-65535 through the current beat
+  uint16_t periodMs;
+  uint16_t sinceBeatMs;
+  uint8_t bpm;
+  uint8_t phase;        // 0-255 through the current beat
+  uint8_t barPhase;     // 0-255 through the bar, 0 on the downbeat
+  uint8_t sixteenth;    // 0-15 through the bar
+  bool newBeat;         // a beat started since the last frame
+  bool newBar;
+  uint8_t source;       // TempoSource
+};
+
+void tempoBegin();
+void tempoUpdate();                 // once per frame, before any pattern renders
+const Tempo& tempo();
+
+void tempoTapStart();               // listen for taps, e.g. after a button gesture
+bool tempoTapping();                // until TEMPO_TAP_TIMEOUT_MS after the last tap
+void tempoTap(uint32_t pressMs);    // millis() when the button went down
+
+uint16_t tempoCycle16(TempoCycle cycle); // 0-65535 through the cycle, 0 on a downbeat
+uint8_t tempoCycle8(TempoCycle cycle);
+// beatsin8()/beatsin16() on the grid: mid-range on the downbeat, rising
+uint8_t tempoSin8(TempoCycle cycle, uint8_t lowest, uint8_t highest, uint8_t phaseOffset = 0);
+uint16_t tempoSin16(TempoCycle cycle, uint16_t lowest, uint16_t highest);
@@ -0,0 +1,77 @@
+#include "timebase.h"
+#include "power.h"
+#include "state.h"
+
+#ifdef LUMA_NATIVE
+
+void timebaseBegin() {}
+
+uint32_t timebaseNow() {
+  return ((uint64_t)nativeMicros() * TIMEBASE_HZ) / 1000000UL;
+}
+
+// Virtual time only moves when told to, so jump straight to the deadline
+void timebaseWaitUntil(uint32_t tick) {
+  if ((int32_t)(tick - timebaseNow()) <= 0) return;
+  nativeSetMicros(((uint64_t)tick * 1000000UL + TIMEBASE_HZ - 1) / TIMEBASE_HZ);
+}
+
+#else
+
+// FastLED's AVR clockless driver adds the time it spends with interrupts off to
+// timer_millis, which megaTinyCore does not export.  This is only a sink so the
+// driver links (see FastLED issue 1754); frame timing comes from the RTC below.
+volatile unsigned long timer_millis = 0;
+
+static PENDANT_STATE volatile uint16_t timebaseWraps = 0;
+
+// Also serves the compare alarm set by timebaseWaitUntil(), which only has to wake the CPU
+ISR(RTC_CNT_vect) {
+  uint8_t flags = RTC.INTFLAGS;
+  RTC.INTFLAGS = flags;
+  if (flags & RTC_OVF_bm) timebaseWraps++;
+}
+
+void timebaseBegin() {
+  while (RTC.STATUS) {}
+  RTC.CLKSEL = RTC_CLKSEL_INT32K_gc;
+  RTC.PER = 0xFFFF;
+  RTC.CNT = 0;
+  RTC.INTFLAGS = RTC_OVF_bm | RTC_CMP_bm;
+  RTC.INTCTRL = RTC_OVF_bm;
+  RTC.CTRLA = RTC_PRESCALER_DIV1_gc | RTC_RTCEN_bm | RTC_RUNSTDBY_bm;
+}
+
+uint32_t timebaseNow() {
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t count = RTC.CNT;
+  uint16_t wraps = timebaseWraps;
+  // A wrap that happened while interrupts were off has not been counted yet
+  if ((RTC.INTFLAGS & RTC_OVF_bm) && count < 0x8000) wraps++;
+  SREG = sreg;
+  return ((uint32_t)wraps << 16) | count;
+}
+
+// Sleeps until the deadline.  CMP only matches the low 16 bits, and other
+// interrupts (the millis tick, buttons) wake the CPU too, so every wake
+// re-checks the full count before going back to sleep.
+void timebaseWaitUntil(uint32_t tick) {
+  if ((int32_t)(tick - timebaseNow()) <= 0) return;
+
+  while (RTC.STATUS & RTC_CMPBUSY_bm) {}
+  RTC.CMP = (uint16_t)tick;
+  RTC.INTFLAGS = RTC_CMP_bm;
+  RTC.INTCTRL = RTC_OVF_bm | RTC_CMP_bm;
+
+  for (;;) {
+    cli();
+    if ((int32_t)(tick - timebaseNow()) <= 0) break;
+    powerIdle();
+  }
+  sei();
+
+  RTC.INTCTRL = RTC_OVF_bm;
+}
+
+#endif
@@ -0,0 +1,20 @@
+/*
+
+ Frame timebase on the RTC.
+
+ The RTC counts the internal 32.768 kHz oscillator in hardware, so it keeps
+ exact time while FastLED.show() has interrupts disabled (unlike millis(),
+ which relies on a tick interrupt).  Its overflow interrupt extends the count
+ to 32 bits; a wrap only happens every 2 s, so it is never missed.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define TIMEBASE_HZ 32768UL
+
+void timebaseBegin();
+uint32_t timebaseNow();                 // ticks of 1/TIMEBASE_HZ s
+void timebaseWaitUntil(uint32_t tick);  // sleeps until timebaseNow() has reached tick
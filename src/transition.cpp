@@ -0,0 +1,104 @@
+#include "transition.h"
+#include "compositor.h"
+#include "state.h"
+
+// Fade progress per ms in 1/65536ths, so the per-frame mix needs no division
+#define TRANSITION_RATE (65536UL / TRANSITION_MS)
+
+struct Transition {
+  PatternSlot slots[2];
+  uint8_t current;    // slot on show; the other one is outgoing while fading
+  bool fading;
+  uint16_t elapsedMs;
+};
+
+static PENDANT_STATE Transition transitions[GROUP_COUNT];
+
+static void forEachSegment(PatternGroup group, void (*action)(SegmentId)) {
+  if (group == GROUP_OUTER) {
+    action(SEGMENT_OUTER);
+  } else {
+    action(SEGMENT_INNER_FRONT);
+    action(SEGMENT_INNER_BACK);
+  }
+}
+
+static void tweenGroup(PatternGroup group, fract8 amountOfCanvas) {
+  if (group == GROUP_OUTER) {
+    compositorTween(SEGMENT_OUTER, amountOfCanvas);
+  } else {
+    compositorTween(SEGMENT_INNER_FRONT, amountOfCanvas);
+    compositorTween(SEGMENT_INNER_BACK, amountOfCanvas);
+  }
+}
+
+// The pattern on show: a keyframe when one is due (every frame during a fade), else the last one held
+static void renderCurrent(PatternGroup group, PatternSlot& slot, bool fading, const FrameContext& frame) {
+  if (!fading && !patternDue(slot, frame)) {
+    patternSkip(slot, frame);
+    forEachSegment(group, compositorHold);
+    if (slot.tween == PATTERN_INTERPOLATE) tweenGroup(group, patternProgress(slot));
+    return;
+  }
+  // A new pattern may ask to interpolate once it has drawn; it blends in from what was there before
+  if (slot.tween == PATTERN_INTERPOLATE || slot.start) forEachSegment(group, compositorKeyframe);
+  patternRender(slot, frame);
+  if (slot.tween == PATTERN_INTERPOLATE && !fading) tweenGroup(group, 0);
+}
+
+void transitionStart(PatternGroup group, PatternFn incoming) {
+  Transition& t = transitions[group];
+  if (t.slots[t.current].pattern == incoming) return;
+  if (!t.slots[t.current].pattern) {
+    transitionCut(group, incoming);
+    return;
+  }
+  forEachSegment(group, compositorCaptureOutgoing);
+  t.current ^= 1;
+  patternActivate(t.slots[t.current], incoming);
+  t.fading = true;
+  t.elapsedMs = 0;
+}
+
+void transitionCut(PatternGroup group, PatternFn incoming) {
+  Transition& t = transitions[group];
+  t.fading = false;
+  if (t.slots[t.current].pattern != incoming) patternActivate(t.slots[t.current], incoming);
+}
+
+bool transitionActive(PatternGroup group) {
+  return transitions[group].fading;
+}
+
+PatternFn transitionShowing(PatternGroup group) {
+  const Transition& t = transitions[group];
+  return t.slots[t.current].pattern;
+}
+
+void transitionRender(PatternGroup group, const FrameContext& frame) {
+  Transition& t = transitions[group];
+
+  if (t.fading) {
+    t.elapsedMs += frame.dt;
+    if (t.elapsedMs >= TRANSITION_MS) {
+      t.fading = false;
+      t.slots[t.current ^ 1].pattern = nullptr;
+    } else {
+      forEachSegment(group, compositorSwapOutgoing);
+      compositorSetLayer(LAYER_OUTGOING);
+      patternRender(t.slots[t.current ^ 1], frame);
+      compositorSetLayer(LAYER_CURRENT);
+      forEachSegment(group, compositorSwapOutgoing);
+
+      fract8 amount = ((uint32_t)t.elapsedMs * TRANSITION_RATE) >> 8;
+      if (group == GROUP_OUTER) {
+        compositorMix(SEGMENT_OUTER, amount);
+      } else {
+        compositorMix(SEGMENT_INNER_FRONT, amount);
+        compositorMix(SEGMENT_INNER_BACK, amount);
+      }
+    }
+  }
+
+  if (t.slots[t.current].pattern) renderCurrent(group, t.slots[t.current], t.fading, frame);
+}
@@ -0,0 +1,49 @@
+/*
+
+ Crossfades between patterns.
+
+ When the pattern of a group (the outer ring, or the inner front and back
+ together) changes, the outgoing pattern is not cut off: for TRANSITION_MS
+ it keeps rendering into its own canvas (see compositor.h) next to the
+ incoming one, and the compositor blends the two.  The incoming pattern starts
+ from black, as it did with the old hard cut.
+
+ Each group has two pattern slots (pattern.h): the one on show, and the
+ outgoing one during a fade.  A transition swaps them, so the outgoing
+ pattern keeps its state and the incoming one starts from a zeroed arena.
+
+ Only the group that changed pays for a second render, and a "change" to the
+ same function (several pairings share an inner pattern) is not a transition
+ at all.  Starting a new transition mid-fade makes whatever is on the canvas
+ now the outgoing picture, drawn on by the pattern that was coming in.
+ Fades advance by the frames' dt, so they replay like the patterns do.
+
+ transitionRender() is also where keyframed patterns (pattern.h) are held
+ between keyframes.  During a fade both patterns render every frame; the
+ outgoing canvas is the pattern's last keyframe, which an interpolating
+ pattern shows a little later, so a switch mid-blend can jump by up to one
+ keyframe.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "pattern.h"
+
+#define TRANSITION_MS 800
+
+enum PatternGroup : uint8_t {
+  GROUP_OUTER,
+  GROUP_INNER,
+  GROUP_COUNT
+};
+
+// Fades from what the group shows to incoming, which starts with fresh state
+void transitionStart(PatternGroup group, PatternFn incoming);
+void transitionCut(PatternGroup group, PatternFn incoming); // no fade, e.g. at power up; nullptr empties the group
+bool transitionActive(PatternGroup group);
+PatternFn transitionShowing(PatternGroup group);
+// Renders a group's current pattern, plus the outgoing one while a transition runs
+void transitionRender(PatternGroup group, const FrameContext& frame);
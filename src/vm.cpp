@@ -0,0 +1,408 @@
+#include "vm.h"
+#include "compositor.h"
+#include "geometry.h"
+#include "palettes.h"
+#include "state.h"
+#include "tempo.h"
+
+#include <EEPROM.h>
+
+#define VM_NO_PROGRAM 0xFF
+#define VM_VERIFY_MAX 64 // longest program verify() takes, flash or EEPROM
+
+struct VmSegment {
+  uint8_t first;
+  uint8_t len;
+  uint8_t step; // ANGLE per LED on the inner segments; the ring's comes from geometry.h
+};
+
+static const VmSegment segments[SEGMENT_COUNT] = {
+  {OUTER_FIRST, OUTER_LEN, 0},
+  {INNER_FRONT_FIRST, INNER_FRONT_LEN, 256 / INNER_FRONT_LEN},
+  {INNER_BACK_FIRST, INNER_BACK_LEN, 256 / INNER_BACK_LEN},
+};
+static_assert(256 % INNER_FRONT_LEN == 0 && 256 % INNER_BACK_LEN == 0,
+              "an inner segment's ANGLE steps evenly; give it a table like ringAngle() otherwise");
+
+enum VmOperand : uint8_t {
+  OPERAND_NONE,
+  OPERAND_BYTE,
+  OPERAND_CYCLE,
+  OPERAND_REGISTER,
+  OPERAND_SEGMENT,
+  OPERAND_PALETTE,
+  OPERAND_OFFSET
+};
+
+struct VmOpInfo {
+  uint8_t operand; // VmOperand
+  uint8_t pops;
+  uint8_t pushes;
+};
+
+static const VmOpInfo opInfo[VM_OP_COUNT] PROGMEM = {
+  {OPERAND_NONE, 0, 0},     // END
+  {OPERAND_BYTE, 0, 1},     // PUSH
+  {OPERAND_NONE, 1, 2},     // DUP
+  {OPERAND_NONE, 1, 0},     // DROP
+  {OPERAND_NONE, 2, 2},     // SWAP
+  {OPERAND_NONE, 2, 1},     // ADD
+  {OPERAND_NONE, 2, 1},     // SUB
+  {OPERAND_NONE, 2, 1},     // QADD
+  {OPERAND_NONE, 2, 1},     // QSUB
+  {OPERAND_NONE, 2, 1},     // MUL
+  {OPERAND_NONE, 2, 1},     // SCALE
+  {OPERAND_NONE, 2, 1},     // MAX
+  {OPERAND_NONE, 2, 1},     // MIN
+  {OPERAND_NONE, 1, 1},     // SIN
+  {OPERAND_NONE, 1, 1},     // EASE
+  {OPERAND_NONE, 0, 1},     // RAND
+  {OPERAND_NONE, 0, 1},     // DT
+  {OPERAND_CYCLE, 0, 1},    // CYCLE
+  {OPERAND_CYCLE, 3, 1},    // TSIN
+  {OPERAND_REGISTER, 0, 1}, // LOAD
+  {OPERAND_REGISTER, 1, 0}, // STORE
+  {OPERAND_SEGMENT, 0, 0},  // EACH
+  {OPERAND_NONE, 0, 0},     // NEXT
+  {OPERAND_SEGMENT, 1, 0},  // AT
+  {OPERAND_NONE, 0, 1},     // I
+  {OPERAND_NONE, 0, 1},     // ANGLE
+  {OPERAND_NONE, 3, 0},     // RGB
+  {OPERAND_PALETTE, 2, 0},  // PAL
+  {OPERAND_NONE, 1, 0},     // DIM
+  {OPERAND_SEGMENT, 1, 0},  // FADE
+  {OPERAND_SEGMENT, 1, 0},  // SCALESEG
+  {OPERAND_OFFSET, 1, 0},   // JZ
+  {OPERAND_OFFSET, 0, 0},   // JMP
+};
+
+// --- Built-in programs ---
+
+// berlinMode(): dualSinePulsePattern(200, 0, 0)
+static const uint8_t programBerlin[] PROGMEM = {
+  VM_CYCLE, TEMPO_2_BARS, VM_STORE, 0,                    // r0 = master phase
+  VM_EACH, SEGMENT_OUTER,
+    VM_ANGLE, VM_LOAD, 0, VM_ADD, VM_DUP, VM_SIN,         // led angle + phase, first wave
+    VM_SWAP, VM_PUSH, 128, VM_ADD, VM_SIN, VM_MAX,        // the opposing wave; the brighter one
+    VM_DUP, VM_SCALE, VM_DUP, VM_SCALE, VM_EASE,          // contrast, twice, and easing
+    VM_PUSH, 200, VM_PUSH, 0, VM_PUSH, 0, VM_RGB, VM_DIM,
+  VM_NEXT,
+  VM_PUSH, 100, VM_SCALESEG, SEGMENT_OUTER,               // DUAL_SINE_SCALING
+  VM_END
+};
+
+// bpm()
+static const uint8_t programBpm[] PROGMEM = {
+  VM_PUSH, 64, VM_PUSH, 255, VM_PUSH, 64, VM_TSIN, TEMPO_BAR,
+  VM_PUSH, 1, VM_SUB, VM_STORE, 0,                        // r0 = beat - 1
+  VM_EACH, SEGMENT_OUTER,
+    VM_ANGLE, VM_LOAD, 0, VM_I, VM_PUSH, 10, VM_MUL, VM_ADD, // colour by angle, brightness beat - 1 + i * 10
+    VM_PAL, PALETTE_RAINBOW,
+  VM_NEXT,
+  VM_PUSH, 150, VM_SCALESEG, SEGMENT_OUTER,
+  VM_END
+};
+
+static const uint8_t programComet[] PROGMEM = {
+  VM_PUSH, 12, VM_FADE, SEGMENT_OUTER,                    // the tail
+  VM_CYCLE, TEMPO_BAR, VM_PUSH, OUTER_LEN, VM_SCALE, VM_AT, SEGMENT_OUTER, // once round a bar
+  VM_CYCLE, TEMPO_4_BARS, VM_PUSH, 255, VM_PAL, PALETTE_RAINBOW,
+  VM_PUSH, 150, VM_SCALESEG, SEGMENT_OUTER,
+  VM_END
+};
+
+struct VmCode {
+  const uint8_t* code;
+  uint8_t len;
+};
+
+static const VmCode flashPrograms[VM_FLASH_PROGRAMS] = {
+  {programBerlin, sizeof(programBerlin)},
+  {programBpm, sizeof(programBpm)},
+  {programComet, sizeof(programComet)},
+};
+
+static_assert(sizeof(programBerlin) <= VM_VERIFY_MAX && sizeof(programBpm) <= VM_VERIFY_MAX &&
+              sizeof(programComet) <= VM_VERIFY_MAX, "built-in program too long for verify()");
+
+static PENDANT_STATE CRGB* leds;
+static PENDANT_STATE uint8_t eepromCode[VM_MAX_CODE]; // the EEPROM program, copied in when it is checked
+
+struct VmState {
+  uint8_t program;          // what runs: the one asked for, or the fallback
+  uint8_t reg[VM_REGISTERS];
+};
+
+// Flash programs are read with LPM, the EEPROM one from its copy in SRAM
+static inline uint8_t fetch(const uint8_t* code, bool inFlash, uint8_t pc) {
+  return inFlash ? pgm_read_byte(code + pc) : code[pc];
+}
+
+static bool verify(const uint8_t* code, uint8_t len, bool inFlash) {
+  if (len == 0 || len > VM_VERIFY_MAX) return false;
+  uint8_t joins[VM_VERIFY_MAX]; // stack depth expected where a jump lands, 0xFF for none
+  memset(joins, 0xFF, len);
+
+  uint8_t depth = 0;
+  bool reachable = true;
+  bool inLoop = false;
+  uint8_t loopDepth = 0;
+  uint8_t farthest = 0;         // furthest jump target so far
+
+  for (uint8_t pc = 0; pc < len;) {
+    uint8_t at = pc;
+    if (joins[at] != 0xFF) {
+      if (reachable && joins[at] != depth) return false;
+      depth = joins[at];
+      joins[at] = 0xFF;
+      reachable = true;
+    }
+    if (!reachable) return false; // nothing jumps here
+
+    uint8_t op = fetch(code, inFlash, pc++);
+    if (op >= VM_OP_COUNT) return false;
+    VmOpInfo info;
+    memcpy_P(&info, &opInfo[op], sizeof(info));
+
+    uint8_t arg = 0;
+    if (info.operand != OPERAND_NONE) {
+      if (pc >= len) return false;
+      arg = fetch(code, inFlash, pc++);
+      int8_t cycle = arg;
+      if (info.operand == OPERAND_CYCLE && (cycle < TEMPO_SIXTEENTH || cycle > TEMPO_8_BARS)) return false;
+      if (info.operand == OPERAND_REGISTER && arg >= VM_REGISTERS) return false;
+      if (info.operand == OPERAND_SEGMENT && arg >= SEGMENT_COUNT) return false;
+      if (info.operand == OPERAND_PALETTE && arg >= PALETTE_COUNT) return false;
+    }
+
+    if (depth < info.pops) return false;
+    depth += info.pushes - info.pops;
+    if (depth > VM_STACK_DEPTH) return false;
+
+    switch (op) {
+      case VM_END:
+        reachable = false;
+        break;
+      case VM_JZ:
+      case VM_JMP: {
+        uint16_t target = pc + arg;
+        if (target >= len) return false;
+        if (joins[target] != 0xFF && joins[target] != depth) return false;
+        joins[target] = depth;
+        farthest = max(farthest, (uint8_t)target);
+        if (op == VM_JMP) reachable = false;
+        break;
+      }
+      case VM_EACH:
+        if (inLoop || farthest > at) return false; // no nesting, no jumping into the body
+        inLoop = true;
+        loopDepth = depth;
+        break;
+      case VM_NEXT:
+        if (!inLoop || depth != loopDepth || farthest > at) return false; // nor out of it
+        inLoop = false;
+        break;
+    }
+  }
+
+  if (reachable || inLoop) return false; // would run off the end
+  for (uint8_t i = 0; i < len; i++) {
+    if (joins[i] != 0xFF) return false; // a jump into the middle of an instruction
+  }
+  return true;
+}
+
+// CRC-16/CCITT-FALSE, as the settings log
+static uint16_t crc16(const uint8_t* data, uint8_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= (uint16_t)*data++ << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+bool vmEepromValid() {
+  uint8_t len = EEPROM.read(VM_EEPROM_START);
+  if (len == 0 || len > VM_MAX_CODE) return false;
+  for (uint8_t i = 0; i < len; i++) eepromCode[i] = EEPROM.read(VM_EEPROM_START + 1 + i);
+  uint16_t crc = EEPROM.read(VM_EEPROM_START + 1 + len) | (EEPROM.read(VM_EEPROM_START + 2 + len) << 8);
+  return crc == crc16(eepromCode, len) && verify(eepromCode, len, false);
+}
+
+static uint8_t resolve(uint8_t program) {
+  if (program == VM_PROGRAM_EEPROM) {
+    if (vmEepromValid()) return program;
+  } else if (program < VM_FLASH_PROGRAMS && verify(flashPrograms[program].code, flashPrograms[program].len, true)) {
+    return program;
+  }
+  if (verify(programComet, sizeof(programComet), true)) return VM_PROGRAM_COMET;
+  return VM_NO_PROGRAM;
+}
+
+void vmBegin(CRGB* strip) {
+  leds = strip;
+}
+
+void vmRun(uint8_t program, const FrameContext& frame) {
+  VmState& state = patternState<VmState>(frame);
+  if (frame.start) state.program = resolve(program);
+  if (state.program == VM_NO_PROGRAM) return;
+
+  const bool inFlash = state.program != VM_PROGRAM_EEPROM;
+  const uint8_t* code = inFlash ? flashPrograms[state.program].code : eepromCode;
+
+  uint8_t stack[VM_STACK_DEPTH];
+  uint8_t* sp = stack;          // one past the top
+  uint8_t pc = 0;
+  uint8_t body = 0;             // first instruction of the EACH body
+  uint8_t segment = SEGMENT_OUTER;
+  uint8_t index = 0;
+  CRGB* led = leds + segments[SEGMENT_OUTER].first;
+  uint8_t paletteId = PALETTE_COUNT;
+  const CRGBPalette16* palette = nullptr;
+
+  for (;;) {
+    uint8_t op = fetch(code, inFlash, pc++);
+    switch (op) {
+      case VM_END:
+        return;
+      case VM_PUSH:
+        *sp++ = fetch(code, inFlash, pc++);
+        break;
+      case VM_DUP:
+        *sp = sp[-1];
+        sp++;
+        break;
+      case VM_DROP:
+        sp--;
+        break;
+      case VM_SWAP: {
+        uint8_t top = sp[-1];
+        sp[-1] = sp[-2];
+        sp[-2] = top;
+        break;
+      }
+      case VM_ADD:
+        sp--;
+        sp[-1] += *sp;
+        break;
+      case VM_SUB:
+        sp--;
+        sp[-1] -= *sp;
+        break;
+      case VM_QADD:
+        sp--;
+        sp[-1] = qadd8(sp[-1], *sp);
+        break;
+      case VM_QSUB:
+        sp--;
+        sp[-1] = qsub8(sp[-1], *sp);
+        break;
+      case VM_MUL:
+        sp--;
+        sp[-1] *= *sp;
+        break;
+      case VM_SCALE:
+        sp--;
+        sp[-1] = scale8(sp[-1], *sp);
+        break;
+      case VM_MAX:
+        sp--;
+        sp[-1] = max(sp[-1], *sp);
+        break;
+      case VM_MIN:
+        sp--;
+        sp[-1] = min(sp[-1], *sp);
+        break;
+      case VM_SIN:
+        sp[-1] = sin8(sp[-1]);
+        break;
+      case VM_EASE:
+        sp[-1] = ease8InOutCubic(sp[-1]);
+        break;
+      case VM_RAND:
+        *sp++ = random8();
+        break;
+      case VM_DT:
+        *sp++ = min(frame.dt, (uint16_t)255);
+        break;
+      case VM_CYCLE:
+        *sp++ = tempoCycle8((TempoCycle)(int8_t)fetch(code, inFlash, pc++));
+        break;
+      case VM_TSIN: {
+        TempoCycle cycle = (TempoCycle)(int8_t)fetch(code, inFlash, pc++);
+        sp -= 3;
+        *sp = tempoSin8(cycle, sp[0], sp[1], sp[2]);
+        sp++;
+        break;
+      }
+      case VM_LOAD:
+        *sp++ = state.reg[fetch(code, inFlash, pc++)];
+        break;
+      case VM_STORE:
+        state.reg[fetch(code, inFlash, pc++)] = *--sp;
+        break;
+      case VM_EACH:
+        segment = fetch(code, inFlash, pc++);
+        index = 0;
+        led = leds + segments[segment].first;
+        body = pc;
+        break;
+      case VM_NEXT:
+        if (++index < segments[segment].len) {
+          led++;
+          pc = body;
+        }
+        break;
+      case VM_AT:
+        segment = fetch(code, inFlash, pc++);
+        index = *--sp % segments[segment].len;
+        led = leds + segments[segment].first + index;
+        break;
+      case VM_I:
+        *sp++ = index;
+        break;
+      case VM_ANGLE:
+        *sp++ = segment == SEGMENT_OUTER ? ringAngle(index) : index * segments[segment].step;
+        break;
+      case VM_RGB:
+        sp -= 3;
+        *led = CRGB(sp[0], sp[1], sp[2]);
+        break;
+      case VM_PAL: {
+        uint8_t id = fetch(code, inFlash, pc++);
+        if (id != paletteId) {
+          palette = &paletteGet((PaletteId)id);
+          paletteId = id;
+        }
+        sp -= 2;
+        *led = ColorFromPalette(*palette, sp[0], sp[1], LINEARBLEND);
+        break;
+      }
+      case VM_DIM:
+        led->nscale8(*--sp);
+        break;
+      case VM_FADE: {
+        const VmSegment& s = segments[fetch(code, inFlash, pc++)];
+        fadeToBlackBy(leds + s.first, s.len, *--sp);
+        break;
+      }
+      case VM_SCALESEG: {
+        SegmentId s = (SegmentId)fetch(code, inFlash, pc++);
+        compositorScale(s, *--sp);
+        break;
+      }
+      case VM_JZ: {
+        uint8_t offset = fetch(code, inFlash, pc++);
+        if (!*--sp) pc += offset;
+        break;
+      }
+      case VM_JMP:
+        pc += fetch(code, inFlash, pc) + 1;
+        break;
+    }
+  }
+}
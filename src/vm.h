@@ -0,0 +1,108 @@
+/*
+
+ Pattern bytecode: small stack programs that run as patterns.
+
+ A program is a few dozen bytes of opcodes over a stack of bytes, built from
+ the same primitives the C++ patterns use (sin8, scale8, tempoSin8, palette
+ lookups, fades, segment scaling).  It runs through vmPattern<N>, which is an
+ ordinary PatternFn, so a program takes a place in outerPatternList or
+ innerPatternList like any other pattern.  Programs come from flash (the
+ VmProgram list below) or from the top of the EEPROM, which can be written
+ over UPDI without rebuilding the firmware:
+
+   python3 tools/vm_asm.py comet.vm --hex comet.hex
+   avrdude ... -Ueeprom:w:comet.hex:i
+
+ The EEPROM image at VM_EEPROM_START is
+
+   length  code[length]  crc_lo crc_hi
+
+ with the same CRC-16/CCITT-FALSE as the settings log, over the code.  A blank
+ or damaged image runs VM_PROGRAM_COMET instead.
+
+ Operands follow their opcode as one byte; below, "operand: before -- after"
+ is what an opcode takes and leaves on the stack.  Binary operators take the
+ top of the stack as their second argument ("a b SUB" is a - b) and all arithmetic
+ wraps at 8 bits, as uint8_t does in C, except QADD/QSUB.  Every LED write
+ goes to the current LED: EACH seg ... NEXT runs its body once per LED of
+ the segment with that LED current (I is its index, ANGLE its position round
+ the segment, 256 a turn, from ringAngle() on the ring as the native patterns
+ take it), and AT seg makes one LED current.  LOAD/STORE
+ reach VM_REGISTERS bytes that last from frame to frame, zeroed when the
+ pattern is activated.  JZ and JMP jump forward only; the only way back is
+ NEXT, and EACH loops do not nest.
+
+ A program is checked once, when its pattern is activated: opcodes and
+ operands in range, jumps inside the program and inside any loop they start
+ in, the stack the same depth wherever paths meet and never deeper than
+ VM_STACK_DEPTH, and END at the end.  So the interpreter itself checks
+ nothing and a bad EEPROM image cannot crash the pendant.
+
+*/
+
+#pragma once
+
+#include <FastLED.h>
+
+#include "pattern.h"
+
+#define VM_STACK_DEPTH  8
+#define VM_REGISTERS    (PATTERN_STATE_BYTES - 1)
+#define VM_EEPROM_START 192 // after the settings log (settings.h)
+#define VM_EEPROM_BYTES 64
+#define VM_MAX_CODE     (VM_EEPROM_BYTES - 3)
+
+// Order is the encoding: tools/vm_asm.py reads it from here
+enum VmOp : uint8_t {
+  VM_END,       //                          stop for this frame
+  VM_PUSH,      // n:       -- n
+  VM_DUP,       //        a -- a a
+  VM_DROP,      //        a --
+  VM_SWAP,      //      a b -- b a
+  VM_ADD,       //      a b -- a+b
+  VM_SUB,       //      a b -- a-b
+  VM_QADD,      //      a b -- qadd8(a, b)
+  VM_QSUB,      //      a b -- qsub8(a, b)
+  VM_MUL,       //      a b -- a*b
+  VM_SCALE,     //      a b -- scale8(a, b)
+  VM_MAX,       //      a b -- max(a, b)
+  VM_MIN,       //      a b -- min(a, b)
+  VM_SIN,       //        a -- sin8(a)
+  VM_EASE,      //        a -- ease8InOutCubic(a)
+  VM_RAND,      //          -- random8()
+  VM_DT,        //          -- ms since the last frame, at most 255
+  VM_CYCLE,     // cycle:   -- tempoCycle8(cycle)
+  VM_TSIN,      // cycle: lo hi offset -- tempoSin8(cycle, lo, hi, offset)
+  VM_LOAD,      // reg:     -- value
+  VM_STORE,     // reg: value --
+  VM_EACH,      // seg:                     loop over the segment's LEDs
+  VM_NEXT,      //                          end of the EACH body
+  VM_AT,        // seg:   i --              current LED: i of the segment (mod its length)
+  VM_I,         //          -- index of the current LED in its segment
+  VM_ANGLE,     //          -- its position round the segment, 0-255
+  VM_RGB,       //    r g b --              set the current LED
+  VM_PAL,       // palette: index bri --    set it from a palette (PaletteId), blended
+  VM_DIM,       //        a --              nscale8 the current LED
+  VM_FADE,      // seg:   a --              fadeToBlackBy the whole segment
+  VM_SCALESEG,  // seg:   a --              compositorScale()
+  VM_JZ,        // off:   a --              skip off bytes if a is 0
+  VM_JMP,       // off:                     skip off bytes
+  VM_OP_COUNT
+};
+
+enum VmProgram : uint8_t {
+  VM_PROGRAM_BERLIN,  // berlinMode() in bytecode, for the benchmarks
+  VM_PROGRAM_BPM,     // bpm() in bytecode, likewise
+  VM_PROGRAM_COMET,   // a comet round the ring once a bar; what a blank EEPROM shows
+  VM_FLASH_PROGRAMS,
+  VM_PROGRAM_EEPROM = VM_FLASH_PROGRAMS
+};
+
+void vmBegin(CRGB* leds);    // the strip the programs draw into (leds_raw)
+void vmRun(uint8_t program, const FrameContext& frame);
+bool vmEepromValid();        // the EEPROM image is there and passes the checks
+
+template <uint8_t PROGRAM>
+void vmPattern(const FrameContext& frame) {
+  vmRun(PROGRAM, frame);
+}
@@ -0,0 +1,4 @@
+#include "wavetable.h"
+
+// constexpr forces the constructor to run in the compiler, so this is plain data in flash
+constexpr Wavetables wavetables PROGMEM = Wavetables();
@@ -0,0 +1,62 @@
+/*
+
+ Shaped waveforms, computed at compile time into 256-byte flash tables.
+
+ Some patterns shape a phase through a chain of lib8tion calls per LED per
+ frame: the dual-sine pulse of berlinMode, cyanMode and magentaMode is two
+ sin8s, a max, two scale8s and an ease8InOutCubic for each of the 16 outer
+ LEDs.  Each waveform here is that chain as a function of one phase byte,
+ evaluated for all 256 phases by the compiler, so the pattern pays one LPM.
+ The constexpr lib8tion in math8.h matches FastLED exactly, so the patterns
+ draw the same frames as they did computing the waves (the bench "wave" rows
+ check this and time both).
+
+ To add a waveform, add a WaveId and its formula in waveShape(); each costs
+ 256 bytes of flash.
+
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "math8.h"
+
+enum WaveId : uint8_t {
+  WAVE_DUAL_PULSE, // max(sin8(p), sin8(p + 128)), contrast boosted twice, cubic eased
+  WAVE_TRI_CUBIC,  // ease8InOutCubic(triwave8(p)): rises and falls once, the crossfade envelope
+  WAVE_COUNT
+};
+
+constexpr uint8_t waveShape(WaveId wave, uint8_t phase) {
+  switch (wave) {
+    case WAVE_DUAL_PULSE: {
+      uint8_t a = constSin8(phase);
+      uint8_t b = constSin8((uint8_t)(phase + 128));
+      uint8_t raw = a > b ? a : b;
+      uint8_t contrast = constScale8(raw, raw);
+      contrast = constScale8(contrast, contrast);
+      return constEase8InOutCubic(contrast);
+    }
+    case WAVE_TRI_CUBIC:
+      return constEase8InOutCubic(constTriwave8(phase));
+    default:
+      return 0;
+  }
+}
+
+struct Wavetables {
+  uint8_t wave[WAVE_COUNT][256];
+
+  constexpr Wavetables() : wave() {
+    for (uint8_t w = 0; w < WAVE_COUNT; w++) {
+      for (uint16_t p = 0; p < 256; p++) {
+        wave[w][p] = waveShape((WaveId)w, p);
+      }
+    }
+  }
+};
+
+extern const Wavetables wavetables PROGMEM;
+
+inline uint8_t wave8(WaveId wave, uint8_t phase) { return pgm_read_byte(&wavetables.wave[wave][phase]); }
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Compare two [env:bench] outputs (captured serial logs) pair by pair.
+
+    python3 tools/bench_compare.py before.txt after.txt
+
+Prints average and worst-case frame cycles for each pattern pair, the change
+between runs, and the share of the frame budget used by the worst frame.
+"""
+
+import sys
+
+
+def load(path):
+    budget = None
+    rows = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("# luma bench"):
+                for field in line.split()[3:]:
+                    key, _, value = field.partition("=")
+                    if key == "budget":
+                        budget = int(value)
+            elif line and line[0].isdigit():
+                cols = line.split("\t")
+                outer_avg, inner_avg, show_avg = int(cols[3]), int(cols[5]), int(cols[7])
+                rows[int(cols[0])] = {
+                    "label": "%s/%s" % (cols[1], cols[2]),
+                    "avg": outer_avg + inner_avg + show_avg,
+                    "max": int(cols[9]),
+                    "over": int(cols[10]),
+                }
+    return budget, rows
+
+
+def pct(new, old):
+    return "%+6.1f%%" % (100.0 * (new - old) / old) if old else "    n/a"
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    budget, before = load(sys.argv[1])
+    _, after = load(sys.argv[2])
+
+    print("%-5s %-7s %10s %10s %8s %10s %10s %8s %7s %s" % (
+        "pair", "o/i", "avg_old", "avg_new", "avg_d", "max_old", "max_new", "max_d", "budget", ""))
+    for pair in sorted(set(before) | set(after)):
+        old, new = before.get(pair), after.get(pair)
+        if not old or not new:
+            print("%-5d only in %s" % (pair, sys.argv[1] if old else sys.argv[2]))
+            continue
+        used = "%6.1f%%" % (100.0 * new["max"] / budget) if budget else "    n/a"
+        print("%-5d %-7s %10d %10d %8s %10d %10d %8s %7s %s" % (
+            pair, new["label"], old["avg"], new["avg"], pct(new["avg"], old["avg"]),
+            old["max"], new["max"], pct(new["max"], old["max"]), used, "OVER" if new["over"] else ""))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,43 @@
+# PlatformIO post-build script: lists any soft-float routines linked into the
+# firmware image, with their size, so float math creeping back into a pattern
+# shows up in the build log.  The ATtiny1616 has no FPU; every float add,
+# multiply or exp() is a library call costing flash and hundreds of cycles.
+#
+#   extra_scripts = post:tools/check_float.py
+
+import re
+import subprocess
+
+Import("env")
+
+FLOAT_SYMBOL = re.compile(r"^(__(add|sub|mul|div|cmp|eq|ne|lt|le|gt|ge|unord)sf[23]|__fix(uns)?sf[sd]i"
+                          r"|__float(un)?[sd]isf|__fp_\w+|exp|log|pow|sqrt|sin|cos|f?round|floor|ceil)$")
+
+
+def report_float(source, target, env):
+    elf = str(target[0])
+    nm = env.subst("$CC").replace("gcc", "nm")
+    try:
+        out = subprocess.check_output([nm, "--size-sort", "-S", elf], universal_newlines=True)
+    except (OSError, subprocess.CalledProcessError) as err:
+        print("check_float: cannot run %s: %s" % (nm, err))
+        return
+
+    total = 0
+    found = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 4 and parts[2] in "tTwW" and FLOAT_SYMBOL.match(parts[3]):
+            size = int(parts[1], 16)
+            total += size
+            found.append((parts[3], size))
+
+    if not found:
+        print("check_float: no soft-float routines linked")
+        return
+    print("check_float: WARNING %d soft-float routines linked (%d bytes of flash):" % (len(found), total))
+    for name, size in found:
+        print("  %-24s %5d" % (name, size))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report_float)
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Frame cost against LED count: how large a ring the ATtiny1616 can drive.
+
+    python3 tools/led_sweep.py [--counts 16,32,64,128,192,240] [--fps 129,60,30]
+                               [--frames 1290] [--bench LOG]...
+
+Every count is built as the BOARD_RING profile (src/boards.h) with that many
+LEDs on the outer ring.  A frame costs the render of the pair on show, the
+compositor and power limiter, and show(), which clocks 30 us per LED out with
+interrupts off (power.h); a rate holds while the worst pair fits its slot.
+
+Two sources for the render side:
+
+  * Without --bench, each count is built and run in the native harness, as
+    [env:native] builds it.  Desktop nanoseconds are not AVR cycles, so that
+    gives the shape of the curve; the show time is the pendant's.
+  * With one --bench LOG from a pendant ([env:bench]), the native sweep is
+    scaled pair by pair to that log's cycles at its LED count.
+  * With --bench logs at two or more counts, the pendant's own numbers are
+    used as they are.  Build them with
+      PLATFORMIO_BUILD_FLAGS="-DLUMA_BOARD=BOARD_RING -DBOARD_RING_LEDS=64" \\
+          pio run -e bench -t upload && pio device monitor -e bench > bench_64.txt
+
+Every count it builds also runs the harness's --vm check, so the bytecode
+builtins (src/vm.h) are held to their native patterns on rings whose length
+does not divide 256; a mismatch stops the sweep.
+
+Either way it prints the cost per count and, for each --fps, the largest ring
+whose worst frame fits (interpolated between the counts measured).
+"""
+
+import argparse
+import concurrent.futures
+import glob
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+INNER_LEDS = 4  # BOARD_RING keeps the pendant's inner pairs
+F_CPU = 16000000
+RAM_PER_LED = 15  # boards.h
+RAM_BYTES = 2048  # the ATtiny1616's SRAM, for everything
+
+
+def power_define(name):
+    text = open(os.path.join(ROOT, "src", "power.h")).read()
+    return int(re.search(r"#define %s\s+(\d+)" % name, text).group(1))
+
+
+SHOW_US_PER_LED = power_define("POWER_SHOW_US_PER_LED")
+SHOW_US_LATCH = power_define("POWER_SHOW_US_LATCH")
+
+
+def show_us(leds):
+    return leds * SHOW_US_PER_LED + SHOW_US_LATCH
+
+
+def load_bench(path):
+    """{pair: (avg cycles, max cycles) for the render, compositor and limiter}, and the LED count."""
+    leds = None
+    pairs = {}
+    for line in open(path):
+        line = line.strip()
+        if line.startswith("# luma bench"):
+            fields = dict(f.partition("=")[::2] for f in line.split()[3:])
+            leds = int(fields["leds"]) if "leds" in fields else None
+        elif line and line[0].isdigit():
+            c = [int(v) if v.isdigit() else v for v in line.split("\t")]
+            # outer, inner, limiter and compositor; show() is modelled from the count
+            avg = c[3] + c[5] + c[11] + c[15]
+            worst = c[4] + c[6] + c[12] + c[16]
+            pairs[c[0]] = (avg, worst)
+    if leds is None:
+        sys.exit("%s: no leds= in its header, so it is from before board profiles" % path)
+    return leds, pairs
+
+
+def build(outer, workdir):
+    exe = os.path.join(workdir, "ring_%d" % outer)
+    sources = glob.glob(os.path.join(ROOT, "src", "*.cpp")) + glob.glob(os.path.join(ROOT, "lib", "NativeHost", "src", "*.cpp"))
+    # The flags of [env:native] in platformio.ini
+    subprocess.run(["g++", "-std=gnu++17", "-O2", "-DLUMA_NATIVE", "-DLUMA_BOARD=BOARD_RING",
+                    "-DBOARD_RING_LEDS=%d" % outer, "-I" + os.path.join(ROOT, "lib", "NativeHost", "src"),
+                    "-I" + os.path.join(ROOT, "src")] + sources + ["-o", exe, "-Wl,--export-dynamic", "-ldl", "-pthread"],
+                   check=True)
+    return exe
+
+
+def run(exe, frames):
+    """{pair: mean desktop ns of its outer and inner renders}; the max is too noisy to scale by."""
+    out = subprocess.run([exe, "--frames", str(frames)], check=True, capture_output=True, text=True).stdout
+    pairs = {}
+    for m in re.finditer(r"^\s*(\d+) \S+\s+(\d+)\s+\d+ \|\s*\d+ \S+\s+(\d+)\s+\d+ \|", out, re.M):
+        pair, outer_mean, inner_mean = map(int, m.groups())
+        pairs[pair] = outer_mean + inner_mean
+    return pairs
+
+
+def check_vm(exe, outer):
+    """Exits if the bytecode builtins do not draw what their native patterns do on this ring."""
+    result = subprocess.run([exe, "--vm", "--frames", "200"], capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit("%d LEDs on the ring: bytecode and native patterns differ\n%s" % (outer, result.stdout))
+
+
+def largest(points, budget_us):
+    """LED count where the frame reaches budget_us, interpolated; None if the first count does not fit."""
+    if points[0][1] > budget_us:
+        return None
+    for (n0, t0), (n1, t1) in zip(points, points[1:]):
+        if t1 > budget_us:
+            return int(n0 + (n1 - n0) * (budget_us - t0) / (t1 - t0))
+    return points[-1][0]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--counts", default="16,32,64,96,128,160,192,224,251",
+                        help="outer ring LED counts (the inner four come on top, up to 255 in all)")
+    parser.add_argument("--fps", default="129,60,30")
+    parser.add_argument("--frames", type=int, default=1290, help="frames per pair in the native harness")
+    parser.add_argument("--bench", action="append", default=[], metavar="LOG")
+    args = parser.parse_args()
+    rates = [int(f) for f in args.fps.split(",")]
+
+    logs = [load_bench(path) for path in args.bench]
+    measured = {leds: pairs for leds, pairs in logs}
+
+    rows = []  # (total LEDs, render avg us, render worst us, desktop ns or None)
+    if len(measured) >= 2:
+        print("render: pendant bench logs at %s LEDs" % ", ".join(str(n) for n in sorted(measured)))
+        for leds in sorted(measured):
+            pairs = measured[leds]
+            avg = max(a for a, _ in pairs.values()) * 1e6 / F_CPU
+            worst = max(w for _, w in pairs.values()) * 1e6 / F_CPU
+            rows.append((leds, avg, worst, None))
+    else:
+        counts = [int(c) for c in args.counts.split(",")]
+        built = set(counts)
+        if logs:
+            base_leds, base = logs[0]
+            built.add(base_leds - INNER_LEDS)  # the pendant's count, to scale from
+        # Built side by side, but run one at a time so they do not skew each other's timing
+        with tempfile.TemporaryDirectory() as workdir:
+            with concurrent.futures.ThreadPoolExecutor() as pool:
+                exes = dict(zip(built, pool.map(lambda n: build(n, workdir), built)))
+            for n in sorted(built):
+                check_vm(exes[n], n)
+            runs = {n: run(exes[n], args.frames) for n in sorted(built)}
+        if logs:
+            reference = runs[base_leds - INNER_LEDS]
+            print("render: native sweep, scaled pair by pair to the pendant's cycles at %d LEDs" % base_leds)
+        else:
+            print("render: native sweep in desktop ns (the shape only; give --bench LOG for AVR time)")
+        for outer in counts:
+            pairs = runs[outer]
+            leds = outer + INNER_LEDS
+            desktop = max(pairs.values())
+            if logs:
+                growth = {p: pairs[p] / max(reference[p], 1) for p in pairs if p in base}
+                avg = max(base[p][0] * g for p, g in growth.items()) * 1e6 / F_CPU
+                worst = max(base[p][1] * g for p, g in growth.items()) * 1e6 / F_CPU
+                rows.append((leds, avg, worst, desktop))
+            else:
+                rows.append((leds, None, None, desktop))
+
+    print("\n%5s %9s %9s %9s %9s %9s %7s" % ("leds", "desk_ns", "render", "worst", "show", "frame", "max_fps"))
+    points = []
+    for leds, avg, worst, desktop in rows:
+        show = show_us(leds)
+        frame = show + (worst or 0)
+        points.append((leds, frame))
+        ram = leds * RAM_PER_LED
+        print("%5d %9s %9s %9s %7d us %6d us %7.0f  %d B of LED buffers%s" % (
+            leds, "-" if desktop is None else desktop, "-" if avg is None else "%.0f us" % avg,
+            "-" if worst is None else "%.0f us" % worst, show, frame, 1e6 / frame, ram,
+            ", more than the part's %d B of RAM" % RAM_BYTES if ram > RAM_BYTES else ""))
+
+    print()
+    for fps in rates:
+        budget = 1e6 / fps
+        n = largest(points, budget)
+        what = "show() alone" if rows[0][2] is None else "the worst frame"
+        if n is None:
+            print("%3d fps (%.0f us): %s does not fit even at %d LEDs" % (fps, budget, what, points[0][0]))
+        elif n == points[-1][0]:
+            print("%3d fps (%.0f us): %s fits at every count tried, up to %d LEDs" % (fps, budget, what, n))
+        else:
+            print("%3d fps (%.0f us): %s fits up to about %d LEDs" % (fps, budget, what, n))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
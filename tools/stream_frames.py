@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""Stream frames to a pendant running a LUMA_STREAM build (src/stream.h).
+
+    python3 tools/stream_frames.py PORT [--seconds 10] [--show rainbow]
+                                        [--baud 230400] [--window 1] [--corrupt N]
+
+PORT is the pendant's serial port, or the pseudo-terminal the native harness
+prints with --stream:
+
+    .pio/build/native/program --stream --frames 2580
+    python3 tools/stream_frames.py /dev/pts/5 --seconds 10
+
+Frames are sent as the pendant's credits come back, at most --window frames
+ahead of the last one shown, so they go at the pendant's frame rate.  The
+latency is from writing a frame to the credit that says it was shown; a pty
+has no baud rate, so there it leaves out the time on the wire (printed at the
+start for --baud).  --corrupt N flips a byte in every Nth frame, which the
+pendant must drop and recover from.  When the script stops, the pendant goes
+back to its own patterns STREAM_TIMEOUT_MS later.
+"""
+
+import argparse
+import colorsys
+import os
+import select
+import termios
+import time
+
+LEDS = 20
+FRAME_SYNC = 0xC5
+CREDIT_SYNC = 0xCA
+FRAME_TIMEOUT_S = 0.1  # a frame not shown by then was dropped (bad CRC, lost bytes)
+
+BAUDS = {9600: termios.B9600, 57600: termios.B57600, 115200: termios.B115200, 230400: termios.B230400}
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as _crc_xmodem_update() from 0xFFFF."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def frame(seq, pixels):
+    body = bytes([seq, len(pixels)]) + b"".join(bytes(p) for p in pixels)
+    crc = crc16(body)
+    return bytes([FRAME_SYNC]) + body + bytes([crc & 0xFF, crc >> 8])
+
+
+def rainbow(t):
+    return [
+        tuple(int(255 * c) for c in colorsys.hsv_to_rgb((i / LEDS + t * 0.25) % 1.0, 1.0, 1.0))
+        for i in range(LEDS)
+    ]
+
+
+def chase(t):
+    head = int(t * 40) % LEDS
+    return [(255, 255, 255) if i == head else (0, 0, 32) for i in range(LEDS)]
+
+
+SHOWS = {"rainbow": rainbow, "chase": chase}
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                               # iflag
+    attrs[1] = 0                               # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                               # lflag: no echo, no line editing
+    attrs[4] = attrs[5] = BAUDS[baud]
+    attrs[6][termios.VMIN] = 0
+    attrs[6][termios.VTIME] = 0
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+def percentile(values, p):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("port")
+    parser.add_argument("--seconds", type=float, default=10)
+    parser.add_argument("--show", choices=sorted(SHOWS), default="rainbow")
+    parser.add_argument("--baud", type=int, choices=sorted(BAUDS), default=230400)
+    parser.add_argument("--window", type=int, default=1, help="frames in flight beyond the last one shown")
+    parser.add_argument("--corrupt", type=int, default=0, metavar="N", help="corrupt every Nth frame")
+    args = parser.parse_args()
+
+    fd = open_port(args.port, args.baud)
+    show = SHOWS[args.show]
+    wire_ms = len(frame(0, show(0))) * 10 * 1000 / args.baud
+    print("%d byte frames, %.2f ms each on the wire at %d baud; waiting for the pendant" %
+          (len(frame(0, show(0))), wire_ms, args.baud))
+
+    pending = bytearray()
+    in_flight = {}  # seq -> time sent
+    next_seq = None
+    sent = corrupted = timeouts = 0
+    latencies = []
+    start = report = None
+    report_sent = 0
+    report_latencies = []
+
+    deadline = time.monotonic() + args.seconds + 5  # time to find the pendant
+    while time.monotonic() < deadline:
+        now = time.monotonic()
+        if start is not None and now - start >= args.seconds:
+            break
+
+        if next_seq is not None and len(in_flight) < args.window:
+            data = bytearray(frame(next_seq, show(now - start)))
+            sent += 1
+            if args.corrupt and sent % args.corrupt == 0:
+                data[5] ^= 0x55
+                corrupted += 1
+            os.write(fd, data)
+            in_flight[next_seq] = time.monotonic()
+            next_seq = (next_seq + 1) & 0xFF
+
+        readable, _, _ = select.select([fd], [], [], 0.01 if in_flight or next_seq is None else 0)
+        if readable:
+            pending += os.read(fd, 256)
+        arrived = time.monotonic()
+        while len(pending) >= 2:
+            if pending[0] != CREDIT_SYNC:
+                del pending[0]
+                continue
+            shown = pending[1]
+            del pending[:2]
+            if next_seq is None:
+                # Carry on from the pendant's count, so its old credits cannot ack our frames
+                next_seq = (shown + 1) & 0xFF
+                start = report = arrived
+                print("pendant found; streaming %s for %g s" % (args.show, args.seconds))
+                continue
+            for seq in list(in_flight):
+                if (shown - seq) & 0xFF < 128:
+                    if seq == shown:
+                        latencies.append((arrived - in_flight[seq]) * 1000)
+                        report_latencies.append(latencies[-1])
+                    del in_flight[seq]
+
+        for seq, at in list(in_flight.items()):
+            if arrived - at > FRAME_TIMEOUT_S:
+                timeouts += 1
+                del in_flight[seq]
+
+        if report is not None and arrived - report >= 1:
+            if report_latencies:
+                print("%5.1f s  %5.1f fps  latency %5.2f ms avg %5.2f ms max" %
+                      (arrived - start, (sent - report_sent) / (arrived - report),
+                       sum(report_latencies) / len(report_latencies), max(report_latencies)))
+            report = arrived
+            report_sent = sent
+            report_latencies = []
+
+    os.close(fd)
+    if start is None:
+        print("no credit from the pendant: is it a LUMA_STREAM build, on this port?")
+        return 1
+    elapsed = time.monotonic() - start
+    print("%d frames in %.1f s (%.1f fps), %d shown, %d corrupted on purpose, %d timed out" %
+          (sent, elapsed, sent / elapsed, len(latencies), corrupted, timeouts))
+    if latencies:
+        print("send to shown: %.2f ms avg, %.2f ms median, %.2f ms 99th percentile, %.2f ms max" %
+              (sum(latencies) / len(latencies), percentile(latencies, 0.5), percentile(latencies, 0.99),
+               max(latencies)))
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
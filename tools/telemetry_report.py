@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Fetch and decode a telemetry report from a LUMA_TELEMETRY build (src/telemetry.h).
+
+    python3 tools/telemetry_report.py PORT [--baud 115200] [--reset] [--save FILE]
+    python3 tools/telemetry_report.py FILE
+
+PORT is the pendant's serial port: the script sends TELEMETRY_REQUEST and
+decodes the answer, then with --reset clears the pendant's counters so the
+next report starts afresh.  --save keeps the raw report.  A FILE is a report
+saved before, or written by the native harness:
+
+    .pio/build/native/program --telemetry report.bin --frames 12900
+    python3 tools/telemetry_report.py report.bin
+
+Phase and pattern names, and the request bytes, are read from the firmware
+sources, so they always match the build.
+"""
+
+import argparse
+import os
+import re
+import select
+import stat
+import struct
+import sys
+import termios
+import time
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+BAUDS = {57600: termios.B57600, 115200: termios.B115200, 230400: termios.B230400}
+TIMEOUT_S = 2  # the report goes out 32 bytes a frame: well under a second
+
+
+def source(name):
+    return open(os.path.join(SRC, name)).read()
+
+
+def define(name):
+    return int(re.search(r"#define %s\s+(\w+)" % name, source("telemetry.h")).group(1), 0)
+
+
+def phase_names():
+    body = re.search(r"enum TelemetryPhase\b[^{]*\{(.*?)\};", source("telemetry.h"), re.S).group(1)
+    names = re.findall(r"^\s*TELEMETRY_(\w+)", body, re.M)
+    return [n.lower() for n in names if n != "PHASE_COUNT"]
+
+
+def pattern_names():
+    body = re.search(r"PatternList outerPatternList = \{(.*?)\};", source("main.cpp"), re.S).group(1)
+    names = [re.sub(r"//.*", "", line).strip().rstrip(",").strip() for line in body.splitlines()]
+    return [n.replace("AUTO_CYCLE", "auto-cycle") for n in names if n]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as _crc_xmodem_update() from 0xFFFF."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def unframe(data):
+    """The report in a byte stream, or None if there is no whole one with a good CRC."""
+    sync = define("TELEMETRY_REPORT_SYNC")
+    for start in range(len(data)):
+        if data[start] != sync or start + 3 > len(data):
+            continue
+        length = data[start + 1] | data[start + 2] << 8
+        end = start + 3 + length
+        if end + 2 > len(data):
+            continue
+        body = data[start + 3:end]
+        if crc16(body) == data[end] | data[end + 1] << 8:
+            return bytes(body)
+    return None
+
+
+def fetch(port, baud, reset):
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = attrs[1] = attrs[3] = 0
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[4] = attrs[5] = BAUDS[baud]
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+
+    os.write(fd, bytes([define("TELEMETRY_REQUEST")]))
+    data = bytearray()
+    deadline = time.monotonic() + TIMEOUT_S
+    report = None
+    while report is None and time.monotonic() < deadline:
+        if select.select([fd], [], [], 0.05)[0]:
+            data += os.read(fd, 512)
+            report = unframe(data)
+    if report is not None and reset:
+        os.write(fd, bytes([define("TELEMETRY_RESET")]))
+    os.close(fd)
+    return report, bytes(data)
+
+
+def decode(report):
+    header = struct.Struct("<BBBBHHIIIII")
+    (version, phases, patterns, bins, slot_us, overhead, frames, overruns, dropped, commits,
+     eeprom_bytes) = header.unpack_from(report)
+    if version != define("TELEMETRY_VERSION"):
+        sys.exit("report version %d; this script reads %d" % (version, define("TELEMETRY_VERSION")))
+    print("%d frames recorded, %d us slots, instrumentation %d cycles a frame" % (frames, slot_us, overhead))
+    print("since boot: %d overruns, %d frames dropped, %d settings commits, %d EEPROM bytes written" %
+          (overruns, dropped, commits, eeprom_bytes))
+
+    names = phase_names()
+    at = header.size
+    print("\n%-8s %7s %8s %7s" % ("phase", "min_us", "mean_us", "max_us"))
+    for i in range(phases):
+        low, high, total = struct.unpack_from("<HHI", report, at)
+        at += 8
+        mean = total / frames if frames else 0
+        print("%-8s %7d %8.1f %7d" % (names[i] if i < len(names) else i, low if frames else 0, mean, high))
+
+    listed = pattern_names()
+    entry = struct.Struct("<IHHI%dH" % bins)
+    print("\nbusy time (the frame less the wait) in eighths of the slot; the last bin is close to or past it")
+    print("%2s %-28s %7s %6s %6s %9s  %s" % ("#", "pattern", "frames", "min", "max", "render_us",
+                                           " ".join("%5s" % ("<%d/%d" % (b + 1, bins) if b < bins - 1 else "rest")
+                                                    for b in range(bins))))
+    for i in range(patterns):
+        fields = entry.unpack_from(report, at)
+        at += entry.size
+        count, low, high, render = fields[:4]
+        if not count:
+            continue
+        print("%2d %-28s %7d %6d %6d %9.1f  %s" % (i, listed[i] if i < len(listed) else "?", count, low, high,
+                                                  render / count, " ".join("%5d" % n for n in fields[4:])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source")
+    parser.add_argument("--baud", type=int, choices=sorted(BAUDS), default=define("TELEMETRY_BAUD"))
+    parser.add_argument("--reset", action="store_true", help="clear the counters after the report")
+    parser.add_argument("--save", metavar="FILE", help="keep the raw report")
+    args = parser.parse_args()
+
+    if stat.S_ISREG(os.stat(args.source).st_mode):
+        raw = open(args.source, "rb").read()
+        report = unframe(raw)
+    else:
+        report, raw = fetch(args.source, args.baud, args.reset)
+    if report is None:
+        print("no report with a good CRC: is it a LUMA_TELEMETRY build, on this port?")
+        return 1
+    if args.save:
+        open(args.save, "wb").write(raw)
+    decode(report)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
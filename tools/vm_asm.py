@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Assemble a pattern program for the bytecode interpreter (src/vm.h).
+
+    python3 tools/vm_asm.py PROGRAM.vm [--bin IMAGE.bin] [--hex IMAGE.hex] [--c]
+
+One instruction per line, an opcode from VmOp without the VM_ prefix and its
+operand if it takes one; ";" starts a comment and "name:" labels a line for
+JZ/JMP.  Operands are numbers (decimal or 0x hex), or names for the enums in
+the firmware: cycles as in TempoCycle (bar, 2_bars, sixteenth), segments as
+in SegmentId (outer, inner_front) and palettes as in PaletteId (rainbow).
+Registers are 0 to VM_REGISTERS - 1, optionally written r0.
+
+    --bin  the EEPROM image (length, code, CRC), for the native harness:
+           .pio/build/native/program --program IMAGE.bin --outer 9 --dump out/
+    --hex  the same image as Intel HEX at VM_EEPROM_START, for avrdude:
+           avrdude ... -Ueeprom:w:IMAGE.hex:i
+    --c    the code as a C initialiser, to add it to vm.cpp as a built-in
+
+Opcodes and names are read from the firmware headers, so they always match
+the build.  The pendant checks the program again before it runs it.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+SRC = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src")
+
+
+def enum(header, name, prefix):
+    """Name -> value for an enum in a firmware header, implicit values counted."""
+    text = open(os.path.join(SRC, header)).read()
+    body = re.search(r"enum %s\b[^{]*\{(.*?)\};" % name, text, re.S).group(1)
+    values = {}
+    value = -1
+    for line in body.splitlines():
+        m = re.match(r"\s*(\w+)\s*(?:=\s*(-?\w+))?\s*,?", line)
+        if not m or not m.group(1):
+            continue
+        if m.group(2) is not None:
+            value = int(m.group(2), 0) if re.match(r"-?\d", m.group(2)) else values[m.group(2)]
+        else:
+            value += 1
+        values[m.group(1)[len(prefix):].lower() if m.group(1).startswith(prefix) else m.group(1).lower()] = value
+    return values
+
+
+def define(header, name):
+    text = open(os.path.join(SRC, header)).read()
+    return re.search(r"#define %s\s+(.+?)\s*(//.*)?$" % name, text, re.M).group(1)
+
+
+OPS = enum("vm.h", "VmOp", "VM_")
+OPS.pop("op_count")
+OPERANDS = {
+    "push": "byte", "cycle": "cycle", "tsin": "cycle", "load": "register", "store": "register",
+    "each": "segment", "at": "segment", "fade": "segment", "scaleseg": "segment",
+    "pal": "palette", "jz": "label", "jmp": "label",
+}
+NAMES = {
+    "cycle": enum("tempo.h", "TempoCycle", "TEMPO_"),
+    "segment": enum("compositor.h", "SegmentId", "SEGMENT_"),
+    "palette": enum("palettes.h", "PaletteId", "PALETTE_"),
+}
+EEPROM_START = int(define("vm.h", "VM_EEPROM_START").split()[0])
+MAX_CODE = int(define("vm.h", "VM_EEPROM_BYTES").split()[0]) - 3
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as the settings log and vm.cpp."""
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+        crc &= 0xFFFF
+    return crc
+
+
+def operand(kind, text, where):
+    text = text.lower()
+    if kind in NAMES and text in NAMES[kind]:
+        return NAMES[kind][text] & 0xFF
+    if kind == "register" and text.startswith("r"):
+        text = text[1:]
+    try:
+        value = int(text, 0)
+    except ValueError:
+        sys.exit("%s: bad %s operand %r" % (where, kind, text))
+    if not -128 <= value <= 255:
+        sys.exit("%s: %s out of range" % (where, text))
+    return value & 0xFF
+
+
+def assemble(path):
+    lines = []  # (where, op, operand text)
+    labels = {}
+    pc = 0
+    for number, line in enumerate(open(path), 1):
+        where = "%s:%d" % (path, number)
+        line = line.split(";")[0].strip()
+        m = re.match(r"(\w+):\s*(.*)", line)
+        if m:
+            labels[m.group(1)] = pc
+            line = m.group(2)
+        if not line:
+            continue
+        words = line.split()
+        op = words[0].lower()
+        if op not in OPS:
+            sys.exit("%s: unknown opcode %r" % (where, words[0]))
+        kind = OPERANDS.get(op)
+        if (kind is None) != (len(words) == 1) or len(words) > 2:
+            sys.exit("%s: %s takes %s" % (where, op, "an operand" if kind else "no operand"))
+        lines.append((where, op, words[1] if kind else None))
+        pc += 2 if kind else 1
+
+    code = []
+    for where, op, text in lines:
+        code.append(OPS[op])
+        kind = OPERANDS.get(op)
+        if kind == "label":
+            if text not in labels:
+                sys.exit("%s: no label %r" % (where, text))
+            offset = labels[text] - (len(code) + 1)
+            if offset < 0:
+                sys.exit("%s: jumps only go forward; loop with EACH ... NEXT" % where)
+            code.append(offset)
+        elif kind:
+            code.append(operand(kind, text, where))
+    if not code or code[-1] != OPS["end"]:
+        sys.exit("%s: a program ends with END" % path)
+    return code
+
+
+def intel_hex(data, address):
+    records = []
+    for at in range(0, len(data), 16):
+        chunk = data[at:at + 16]
+        record = [len(chunk), (address + at) >> 8, (address + at) & 0xFF, 0] + list(chunk)
+        records.append(":" + "".join("%02X" % b for b in record) + "%02X" % (-sum(record) & 0xFF))
+    records.append(":00000001FF")
+    return "\n".join(records) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("program")
+    parser.add_argument("--bin")
+    parser.add_argument("--hex")
+    parser.add_argument("--c", action="store_true")
+    args = parser.parse_args()
+
+    code = assemble(args.program)
+    if len(code) > MAX_CODE:
+        sys.exit("%d bytes; the EEPROM holds %d" % (len(code), MAX_CODE))
+    crc = crc16(code)
+    image = bytes([len(code)] + code + [crc & 0xFF, crc >> 8])
+    print("%s: %d bytes of code, %d of %d EEPROM bytes" % (args.program, len(code), len(image), MAX_CODE + 3))
+
+    if args.bin:
+        open(args.bin, "wb").write(image)
+    if args.hex:
+        open(args.hex, "w").write(intel_hex(image, EEPROM_START))
+    if args.c:
+        names = {v: "VM_" + k.upper() for k, v in OPS.items()}
+        out, i = [], 0
+        while i < len(code):
+            op = names[code[i]]
+            kind = OPERANDS.get(op[3:].lower())
+            out.append("%s, %d," % (op, code[i + 1]) if kind else op + ",")
+            i += 2 if kind else 1
+        print("\n".join("  " + line for line in out))
+
+
+if __name__ == "__main__":
+    main()